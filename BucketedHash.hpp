@@ -0,0 +1,194 @@
+#ifndef BUCKETED_HASH_HPP
+#define BUCKETED_HASH_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+template <class K>
+/**
+ * @brief The hash function used by KVList and BucketedHashMap, std::hash<K>
+ * by default. A specialization declaring is_transparent accepts every key
+ * type it has an operator() for, which enables lookups without building a K.
+ *
+ * @author Jonathan Ung
+ */
+struct BucketedHash {
+    size_t operator()(const K &key) const {
+        return std::hash<K>()(key);
+    }
+};
+
+template <>
+/**
+ * @brief Transparent hash for std::string keys. std::string_view, C strings
+ * and std::string all hash to the same value as the equal std::string.
+ */
+struct BucketedHash<std::string> {
+    typedef void is_transparent;
+    size_t operator()(std::string_view key) const {
+        return std::hash<std::string_view>()(key);
+    }
+};
+
+template <class H, class = void>
+/**
+ * @brief True when the hash H declares is_transparent.
+ */
+struct IsTransparentHash : std::false_type {};
+
+template <class H>
+struct IsTransparentHash<H, std::void_t<typename H::is_transparent>> : std::true_type {};
+
+template <class K, class Q>
+/**
+ * @brief Hashes a lookup key for a map keyed by K. Transparent hashes take it
+ * as is, other hashes get it converted to K first.
+ *
+ * @param key
+ * @return size_t
+ */
+size_t hashKey(const Q &key) {
+    if constexpr (IsTransparentHash<BucketedHash<K>>::value) {
+        return BucketedHash<K>()(key);
+    } else {
+        return BucketedHash<K>()(static_cast<const K &>(key));
+    }
+}
+
+/**
+ * @brief Rotates x left by r bits, 0 < r < 64.
+ *
+ * @param x
+ * @param r
+ * @return uint64_t
+ */
+inline uint64_t rotateLeft(uint64_t x, unsigned int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+/**
+ * @brief One SipRound of SipHash.
+ */
+inline void sipRound(uint64_t &v0, uint64_t &v1, uint64_t &v2, uint64_t &v3) {
+    v0 += v1;
+    v1 = rotateLeft(v1, 13);
+    v1 ^= v0;
+    v0 = rotateLeft(v0, 32);
+    v2 += v3;
+    v3 = rotateLeft(v3, 16);
+    v3 ^= v2;
+    v0 += v3;
+    v3 = rotateLeft(v3, 21);
+    v3 ^= v0;
+    v2 += v1;
+    v1 = rotateLeft(v1, 17);
+    v1 ^= v2;
+    v2 = rotateLeft(v2, 32);
+}
+
+/**
+ * @brief SipHash-1-3 of len bytes under the 128 bit key (k0, k1), a keyed
+ * hash whose collisions cannot be found without the key. Words are read in
+ * host byte order, so results differ between byte orders.
+ *
+ * @param data
+ * @param len
+ * @param k0
+ * @param k1
+ * @return uint64_t
+ */
+inline uint64_t sipHash13(const char *data, size_t len, uint64_t k0, uint64_t k1) {
+    uint64_t v0 = k0 ^ 0x736F6D6570736575ULL;
+    uint64_t v1 = k1 ^ 0x646F72616E646F6DULL;
+    uint64_t v2 = k0 ^ 0x6C7967656E657261ULL;
+    uint64_t v3 = k1 ^ 0x7465646279746573ULL;
+    size_t end = len - len % 8;
+    for (size_t i = 0; i < end; i += 8) {
+        uint64_t m;
+        std::memcpy(&m, data + i, 8);
+        v3 ^= m;
+        sipRound(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+    uint64_t last = (uint64_t)len << 56;
+    for (size_t i = end; i < len; i++) {
+        last |= (uint64_t)(unsigned char)data[i] << (8 * (i - end));
+    }
+    v3 ^= last;
+    sipRound(v0, v1, v2, v3);
+    v0 ^= last;
+    v2 ^= 0xFF;
+    sipRound(v0, v1, v2, v3);
+    sipRound(v0, v1, v2, v3);
+    sipRound(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+/**
+ * @brief Mixes a hash with a seed: the folded 128 bit product of the hash
+ * and the seed, each xored with a constant. Without the seed, which
+ * hashes end up in the same bucket cannot be predicted; equal hashes of
+ * course still mix to equal values.
+ *
+ * @param hash
+ * @param seed
+ * @return uint64_t
+ */
+inline uint64_t seedMix(uint64_t hash, uint64_t seed) {
+    uint64_t a = hash ^ seed ^ 0xA0761D6478BD642FULL;
+    uint64_t b = seed ^ 0xE7037ED1A0B428DBULL;
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 product = (unsigned __int128)a * b;
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+#else
+    a = (a ^ (a >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    a = (a ^ (a >> 27)) * b;
+    return a ^ (a >> 31);
+#endif
+}
+
+/**
+ * @brief Returns a new hash seed. The first call draws from
+ * std::random_device and the clock, later calls step a process wide counter
+ * through the splitmix64 finalizer, so seeds are cheap, distinct per map and
+ * different on every run.
+ *
+ * @return uint64_t
+ */
+inline uint64_t randomHashSeed() {
+    static std::atomic<uint64_t> state = std::atomic<uint64_t>(
+        ((uint64_t)std::random_device()() << 32) ^ (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count());
+    uint64_t x = state.fetch_add(0x9E3779B97F4A7C15ULL, std::memory_order_relaxed);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+template <class K, class Q>
+/**
+ * @brief Hashes a lookup key for a map keyed by K under a seed. std::string
+ * keys go through SipHash-1-3 keyed by the seed, every other key through
+ * BucketedHash<K> and then seedMix, so colliding keys cannot be chosen
+ * without knowing the seed (short of keys whose BucketedHash<K> is equal).
+ *
+ * @param key
+ * @param seed
+ * @return size_t
+ */
+size_t hashKey(const Q &key, uint64_t seed) {
+    if constexpr (std::is_same<K, std::string>::value) {
+        std::string_view view = std::string_view(key);
+        return (size_t)sipHash13(view.data(), view.size(), seed, seed ^ 0x9E3779B97F4A7C15ULL);
+    } else {
+        return (size_t)seedMix(hashKey<K>(key), seed);
+    }
+}
+
+#endif
@@ -2,13 +2,46 @@
 #define BUCKETED_HASH_MAP_HPP
 
 #include <iostream>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <fstream>
 #include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
 #include "KVList.hpp"
+#include "BucketedHashMapIterator.hpp"
+#include "BucketedHashMapStats.hpp"
+#include "BucketedHashMapSnapshot.hpp"
+#include "FrozenBucketedHashMap.hpp"
+#include "CapacityPolicy.hpp"
+#include "ValueIndex.hpp"
 
-template <class K, class V>
+template <class K, class V, class Traits = BucketedHashMapTraits>
 /**
  * @brief A hash map class which uses buckets, in the form of KVLists to 
- * deal with hashing collision.
+ * deal with hashing collision. Nodes are drawn from a NodePool owned by the
+ * map, which can itself take its slabs from a caller supplied NodeArena.
+ * With a Traits::ReorderPolicy other than NoReorder every lookup, const ones
+ * included, may reorder the chain it hits: iteration order then changes with
+ * lookups and concurrent const lookups are no longer safe.
+ * The same holds once setIncrementalReHash() is on: while a reHash is in
+ * progress every lookup and iteration, const ones included, migrates old
+ * buckets into the new table, so const calls from several threads race
+ * unless finishReHash() has run or the threads hold a lock.
+ * Hashes are mixed with a random seed drawn per map, and chains growing past
+ * a few nodes are indexed by a ChainTree, so keys chosen to collide can
+ * neither be predicted nor turn operations into linear scans.
+ * With Traits::indexValues every write also updates a ValueIndex, so values
+ * can then only be changed through the map (insert, insertOrAssign, the
+ * resolvers of merge and intersect): get(), find(), operator[], the batch
+ * lookups, the insert results and the iterators all expose const values.
+ * With Traits::filterBuckets lookups first test a 32 bit fingerprint each
+ * bucket keeps of its hashes, kept up to date by every write, so most misses
+ * cost the bucket read alone.
  * 
  * @author Jonathan Ung
  */
@@ -17,97 +50,285 @@ class BucketedHashMap {
         size_t size;
         size_t capacity;
         double loadFactorThreshold;
-        std::vector<KVList<K, V>> table;
+        std::unique_ptr<NodePool<K, V>> pool;
+        mutable std::vector<KVList<K, V>> table;
+        mutable std::vector<KVList<K, V>> oldTable;
+        mutable size_t migrateIndex;
+        size_t migrationBudget;
+        unsigned int reHashThreads;
+        double growthFactor;
+        double shrinkThreshold;
+        size_t reHashes;
+        uint64_t reHashNanos;
+        uint64_t seed;
+        typename std::conditional<Traits::indexValues, ValueIndex<K, V>, NoValueIndex>::type valueIndex;
+        static const size_t kParallelReHashMin = 1 << 16;
+        unsigned int indexOf(size_t) const;
+        unsigned int oldIndexOf(size_t) const;
+        void startReHash(size_t);
+        void resize(size_t);
+        size_t grownCapacity() const;
+        size_t fittedCapacity(size_t, double) const;
+        void migrateBucket(size_t) const;
+        void migrate(size_t) const;
+        void releaseNodes();
+        void swap(BucketedHashMap<K,V,Traits> &);
+        template <class Q>
+        size_t hashOf(const Q &) const;
+        template <class Q>
+        static MapNode<K,V>* findInBucket(KVList<K, V> &, const Q &, size_t);
+        static void linkNode(KVList<K, V> &, MapNode<K, V> *);
+        static void fingerprintLinked(KVList<K, V> &, size_t);
+        static void fingerprintUnlinked(KVList<K, V> &);
+        template <class Q>
+        MapNode<K,V>* findNode(const Q &) const;
+        template <class Q>
+        MapNode<K,V>* findNode(const Q &, size_t) const;
+        void prepareInsert(size_t);
+        std::vector<KVList<K, V>> newTable(size_t) const;
+        static const size_t kBatchChunk = 64;
+        static const size_t kPrefetchDistance = 8;
+        static void prefetch(const void *);
+        template <class Q, class F>
+        void lookupMany(const Q *, size_t, F) const;
+        template <class F>
+        static void parallelFor(unsigned int, size_t, F);
+        void parallelReHash(unsigned int, size_t);
+        std::chrono::steady_clock::time_point reHashClock() const;
+        void recordReHash(std::chrono::steady_clock::time_point);
+        unsigned int setThreads(unsigned int) const;
+        const MapNode<K,V>* findIn(const BucketedHashMap &, const MapNode<K, V> *) const;
+        template <bool Keep, class F>
+        void filterBy(const BucketedHashMap &, F, unsigned int);
+        void refit();
+        template <class F>
+        void resolveInto(MapNode<K, V> *, const V &, F &);
+        void reindexValues();
+        template <class KK, class VV>
+        std::pair<MapNode<K,V>*, bool> assignInBucket(KVList<K, V> &, size_t, KK &&, VV &&);
 
     public:
-        unsigned int getVectorIndex(const K) const;
+        typedef typename std::conditional<Traits::indexValues, const V, V>::type exposed_value;
+        typedef BucketedHashMapIterator<K, V, true> const_iterator;
+        typedef typename std::conditional<Traits::indexValues, const_iterator, BucketedHashMapIterator<K, V, false>>::type iterator;
+        unsigned int getVectorIndex(const K &) const;
         BucketedHashMap();
         BucketedHashMap(int);
         BucketedHashMap(double);
         BucketedHashMap(int, double);
-        ~BucketedHashMap(){}
+        BucketedHashMap(int, double, NodeArena *);
+        template <class It, class = typename std::enable_if<!std::is_arithmetic<It>::value>::type>
+        BucketedHashMap(It, It, unsigned int = 1);
+        BucketedHashMap(const BucketedHashMap &);
+        BucketedHashMap(BucketedHashMap &&);
+        ~BucketedHashMap();
+        BucketedHashMap<K,V,Traits>& operator=(const BucketedHashMap<K,V,Traits>&);
+        BucketedHashMap<K,V,Traits>& operator=(BucketedHashMap<K,V,Traits>&&);
         void clear();
-        bool containsKey(const K) const;
+        void reserve(size_t);
+        void shrinkToFit();
+        template <class It>
+        void assign(It, It, unsigned int = 1);
+        void merge(const BucketedHashMap &, unsigned int = 1);
+        template <class F, class = typename std::enable_if<!std::is_arithmetic<F>::value>::type>
+        void merge(const BucketedHashMap &, F, unsigned int = 1);
+        void subtract(const BucketedHashMap &, unsigned int = 1);
+        void intersect(const BucketedHashMap &, unsigned int = 1);
+        template <class F, class = typename std::enable_if<!std::is_arithmetic<F>::value>::type>
+        void intersect(const BucketedHashMap &, F, unsigned int = 1);
+        bool containsKey(const K &) const;
+        template <class Q>
+        bool contains(const Q &) const;
+        template <class Q>
+        bool containsHashed(const Q &, size_t) const;
         bool containsValue(const V) const;
-        V& get(const K) const;
-        V& operator[](const K) const;
+        std::vector<K> keysForValue(const V &) const;
+        template <class Q>
+        exposed_value* find(const Q &) const;
+        template <class Q>
+        exposed_value* findHashed(const Q &, size_t) const;
+        exposed_value& get(const K &) const;
+        template <class Q>
+        exposed_value& get(const Q &) const;
+        exposed_value& operator[](const K &) const;
+        template <class Q>
+        size_t getMany(const Q *, size_t, exposed_value **) const;
+        template <class Q>
+        size_t containsMany(const Q *, size_t, bool *) const;
         bool isEmpty() const;
-        void insert(const K, const V);
-        V remove(const K);
+        void insert(const K &, const V &);
+        template <class... Args>
+        std::pair<exposed_value*, bool> emplace(Args &&...);
+        template <class KK, class... Args>
+        std::pair<exposed_value*, bool> tryEmplace(KK &&, Args &&...);
+        template <class KK, class... Args>
+        std::pair<exposed_value*, bool> tryEmplaceHashed(size_t, KK &&, Args &&...);
+        template <class KK, class VV>
+        std::pair<exposed_value*, bool> insertOrAssign(KK &&, VV &&);
+        template <class KK, class VV>
+        std::pair<exposed_value*, bool> insertOrAssignHashed(size_t, KK &&, VV &&);
+        template <class KK, class VV>
+        size_t insertMany(const std::pair<KK, VV> *, size_t);
+        V remove(const K &);
+        V removeHashed(const K &, size_t);
         int getSize() const;
+        iterator begin();
+        iterator end();
+        const_iterator begin() const;
+        const_iterator end() const;
+        const_iterator cbegin() const;
+        const_iterator cend() const;
         std::vector<MapNode<K,V>> getEntries() const;
         std::vector<K> getKeys() const;
         std::vector<V> getValues() const;
         void show() const;
-        template <class T, class U>
-        friend std::ostream &operator<<(std::ostream &, const BucketedHashMap<T,U> &);
+        template <class T, class U, class R>
+        friend std::ostream &operator<<(std::ostream &, const BucketedHashMap<T,U,R> &);
         void showStructure() const;
+        BucketedHashMapStats stats() const;
+        void saveSnapshot(const std::string &) const;
+        FrozenBucketedHashMap<K, V> freeze() const;
         void reHash();
+        void setIncrementalReHash(size_t);
+        void setReHashThreads(unsigned int);
+        void setGrowthFactor(double);
+        void setShrinkThreshold(double);
+        bool isReHashing() const;
+        void finishReHash();
+        uint64_t getSeed() const;
+        void setSeed(uint64_t);
 };
 
-template <class K, class V>
+template <class K, class V, class Traits>
 /**
- * @brief Get the unsigned int vector index via hashing
+ * @brief Get the unsigned int vector index via hashing, as chosen by Traits::CapacityPolicy
  * 
  * @param key 
  * @param bHM 
  * @return unsigned int 
  */
-unsigned int BucketedHashMap<K,V>::getVectorIndex(const K key) const{
-    return (std::hash<K>()(key)%this->capacity);
+unsigned int BucketedHashMap<K,V,Traits>::getVectorIndex(const K &key) const{
+    return Traits::CapacityPolicy::indexOf(this->hashOf(key), this->capacity);
 }
 
-template <class K, class V>
+template <class K, class V, class Traits>
+/**
+ * @brief Get the unsigned int vector index of an already computed hash
+ * 
+ * @param hash 
+ * @return unsigned int 
+ */
+unsigned int BucketedHashMap<K,V,Traits>::indexOf(size_t hash) const{
+    return Traits::CapacityPolicy::indexOf(hash, this->capacity);
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Get the unsigned int vector index of a hash in the table being
+ * migrated away from during an incremental reHash
+ * 
+ * @param hash 
+ * @return unsigned int 
+ */
+unsigned int BucketedHashMap<K,V,Traits>::oldIndexOf(size_t hash) const{
+    return Traits::CapacityPolicy::indexOf(hash, this->oldTable.size());
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Returns a table of empty buckets drawing from the map's pool. The
+ * buckets are moved in one by one so K and V never need to be copyable.
+ * 
+ * @param buckets 
+ * @return std::vector<KVList<K, V>> 
+ */
+std::vector<KVList<K, V>> BucketedHashMap<K,V,Traits>::newTable(size_t buckets) const {
+    std::vector<KVList<K, V>> res = std::vector<KVList<K, V>>();
+    res.reserve(buckets);
+    for (size_t i = 0; i < buckets; i++) {
+        res.emplace_back(this->pool.get());
+    }
+    return res;
+}
+
+template <class K, class V, class Traits>
 /**
  * @brief Construct a new Bucketed Hash Map< K, V>:: Bucketed Hash Map object
  * 
  */
-BucketedHashMap<K,V>::BucketedHashMap() {
+BucketedHashMap<K,V,Traits>::BucketedHashMap() {
     this->size = 0;
-    this->table = std::vector<KVList<K,V>>(10, KVList<K,V>());
+    this->pool = std::unique_ptr<NodePool<K,V>>(new NodePool<K,V>());
+    this->table = this->newTable(Traits::CapacityPolicy::roundCapacity(10));
     this->loadFactorThreshold = 1;
     this->capacity = this->table.size();
+    this->migrateIndex = 0;
+    this->migrationBudget = 0;
+    this->reHashThreads = 1;
+    this->growthFactor = 2.0;
+    this->shrinkThreshold = 0.0;
+    this->reHashes = 0;
+    this->reHashNanos = 0;
+    this->seed = randomHashSeed();
 }
 
-template <class K, class V>
+template <class K, class V, class Traits>
 /**
  * @brief Construct a new Bucketed Hash Map< K, V>:: Bucketed Hash Map object
  * 
  * @param cap 
  */
-BucketedHashMap<K,V>::BucketedHashMap(int cap) {
+BucketedHashMap<K,V,Traits>::BucketedHashMap(int cap) {
     if (cap < 1) {
         throw std::invalid_argument("Capacity must be larger than 0!");
     }
     this->size = 0;
-    this->table = std::vector<KVList<K,V>>(cap, KVList<K,V>());
+    this->pool = std::unique_ptr<NodePool<K,V>>(new NodePool<K,V>());
+    this->table = this->newTable(Traits::CapacityPolicy::roundCapacity(cap));
     this->loadFactorThreshold = 1;
     this->capacity = this->table.size();
+    this->migrateIndex = 0;
+    this->migrationBudget = 0;
+    this->reHashThreads = 1;
+    this->growthFactor = 2.0;
+    this->shrinkThreshold = 0.0;
+    this->reHashes = 0;
+    this->reHashNanos = 0;
+    this->seed = randomHashSeed();
 }
 
-template <class K, class V>
+template <class K, class V, class Traits>
 /**
  * @brief Construct a new Bucketed Hash Map< K, V>:: Bucketed Hash Map object
  * 
  * @param cap 
  */
-BucketedHashMap<K,V>::BucketedHashMap(double lFT) {
+BucketedHashMap<K,V,Traits>::BucketedHashMap(double lFT) {
     if (lFT < 0.1 || lFT > 1.0) {
         throw std::invalid_argument("Load factor cannot be greater than 1.0 and cannot be less than 0.1!");
     }
     this->size = 0;
-    this->table = std::vector<KVList<K,V>>(10, KVList<K,V>());
+    this->pool = std::unique_ptr<NodePool<K,V>>(new NodePool<K,V>());
+    this->table = this->newTable(Traits::CapacityPolicy::roundCapacity(10));
     this->loadFactorThreshold = lFT;
     this->capacity = this->table.size();
+    this->migrateIndex = 0;
+    this->migrationBudget = 0;
+    this->reHashThreads = 1;
+    this->growthFactor = 2.0;
+    this->shrinkThreshold = 0.0;
+    this->reHashes = 0;
+    this->reHashNanos = 0;
+    this->seed = randomHashSeed();
 }
 
-template <class K, class V>
+template <class K, class V, class Traits>
 /**
  * @brief Construct a new Bucketed Hash Map< K, V>:: Bucketed Hash Map object
  * 
  * @param cap 
  */
-BucketedHashMap<K,V>::BucketedHashMap(int cap, double lFT) {
+BucketedHashMap<K,V,Traits>::BucketedHashMap(int cap, double lFT) {
     if (lFT < 0.1 || lFT > 1.0) {
         throw std::invalid_argument("Load factor cannot be greater than 1.0 and cannot be less than 0.1!");
     }
@@ -115,243 +336,1983 @@ BucketedHashMap<K,V>::BucketedHashMap(int cap, double lFT) {
         throw std::invalid_argument("Capacity must be larger than 0!");
     }
     this->size = 0;
-    this->table = std::vector<KVList<K,V>>(cap, KVList<K,V>());
+    this->pool = std::unique_ptr<NodePool<K,V>>(new NodePool<K,V>());
+    this->table = this->newTable(Traits::CapacityPolicy::roundCapacity(cap));
     this->loadFactorThreshold = lFT;
     this->capacity = this->table.size();
+    this->migrateIndex = 0;
+    this->migrationBudget = 0;
+    this->reHashThreads = 1;
+    this->growthFactor = 2.0;
+    this->shrinkThreshold = 0.0;
+    this->reHashes = 0;
+    this->reHashNanos = 0;
+    this->seed = randomHashSeed();
 }
 
-template <class K, class V>
+template <class K, class V, class Traits>
 /**
- * @brief clears the hash map vector
+ * @brief Construct a new Bucketed Hash Map< K, V>:: Bucketed Hash Map object
+ * whose node slabs are taken from the given arena. The map must be destroyed
+ * before the arena is released.
  * 
+ * @param cap 
+ * @param lFT 
+ * @param arena 
  */
-void BucketedHashMap<K,V>::clear() {
-    for (int i = 0; i < this->capacity; i++) {
-        this->table[i].clear();
+BucketedHashMap<K,V,Traits>::BucketedHashMap(int cap, double lFT, NodeArena *arena) : BucketedHashMap(cap, lFT) {
+    this->pool = std::unique_ptr<NodePool<K,V>>(new NodePool<K,V>(arena));
+    this->table = this->newTable(this->capacity);
+}
+
+template <class K, class V, class Traits>
+template <class It, class>
+/**
+ * @brief Construct a new Bucketed Hash Map< K, V>:: Bucketed Hash Map object
+ * from a range of key-value pairs in one bulk build, see assign().
+ * 
+ * @param first 
+ * @param last 
+ * @param threads 
+ */
+BucketedHashMap<K,V,Traits>::BucketedHashMap(It first, It last, unsigned int threads) : BucketedHashMap() {
+    this->assign(first, last, threads);
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Copy constructor for a BucketedHashMap object. The copy has its own
+ * pool, with the same capacity and every entry of other.
+ * 
+ * @param other 
+ */
+BucketedHashMap<K,V,Traits>::BucketedHashMap(const BucketedHashMap &other) : BucketedHashMap((int)other.capacity, other.loadFactorThreshold) {
+    this->migrationBudget = other.migrationBudget;
+    this->reHashThreads = other.reHashThreads;
+    this->growthFactor = other.growthFactor;
+    this->shrinkThreshold = other.shrinkThreshold;
+    this->seed = other.seed;
+    for (size_t i = 0; i < other.table.size(); i++) {
+        for (MapNode<K, V> *tmp = other.table[i].begin(); tmp; tmp = tmp->next) {
+            MapNode<K, V> *n = this->pool->create(tmp->hash, tmp->key, tmp->value);
+            linkNode(this->table[this->indexOf(tmp->hash)], n);
+            this->valueIndex.add(n);
+        }
+    }
+    for (size_t i = other.migrateIndex; i < other.oldTable.size(); i++) {
+        for (MapNode<K, V> *tmp = other.oldTable[i].begin(); tmp; tmp = tmp->next) {
+            MapNode<K, V> *n = this->pool->create(tmp->hash, tmp->key, tmp->value);
+            linkNode(this->table[this->indexOf(tmp->hash)], n);
+            this->valueIndex.add(n);
+        }
     }
+    this->size = other.size;
 }
 
-template <class K, class V>
+template <class K, class V, class Traits>
 /**
- * @brief Returns whether or not the hashmap contains the passed in key
+ * @brief Move constructor for a BucketedHashMap object. other is left as an empty single bucket map.
  * 
- * @param key 
- * @return true 
- * @return false 
+ * @param other 
  */
-bool BucketedHashMap<K,V>::containsKey(const K key) const {
-    return this->table[this->getVectorIndex(key)].has(key);
+BucketedHashMap<K,V,Traits>::BucketedHashMap(BucketedHashMap &&other) : BucketedHashMap(1) {
+    this->swap(other);
 }
 
-template <class K, class V>
+template <class K, class V, class Traits>
 /**
- * @brief Returns whether or not the hashmap contains the passed in value
+ * @brief Destructor for a BucketedHashMap object.
+ */
+BucketedHashMap<K,V,Traits>::~BucketedHashMap() {
+    this->releaseNodes();
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Copies a map using an overloaded assignment operator.
  * 
- * @param value 
- * @return true 
- * @return false 
+ * @param other 
+ * @return BucketedHashMap<K,V,Traits>& 
  */
-bool BucketedHashMap<K,V>::containsValue(const V value) const {
-    for (int i = 0; i < this->capacity; i++) {
-        if (this->table[i].hasValue(value)) {
-            return true;
+BucketedHashMap<K,V,Traits>& BucketedHashMap<K,V,Traits>::operator=(const BucketedHashMap<K,V,Traits>& other) {
+    if (this != &other) {
+        BucketedHashMap<K,V,Traits> tmp = BucketedHashMap<K,V,Traits>(other);
+        this->swap(tmp);
+    }
+    return *this;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Moves a map using an overloaded assignment operator.
+ * 
+ * @param other 
+ * @return BucketedHashMap<K,V,Traits>& 
+ */
+BucketedHashMap<K,V,Traits>& BucketedHashMap<K,V,Traits>::operator=(BucketedHashMap<K,V,Traits>&& other) {
+    if (this != &other) {
+        this->swap(other);
+    }
+    return *this;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Exchanges the contents of two maps. Pools travel with their nodes.
+ * 
+ * @param other 
+ */
+void BucketedHashMap<K,V,Traits>::swap(BucketedHashMap<K,V,Traits> &other) {
+    std::swap(this->size, other.size);
+    std::swap(this->capacity, other.capacity);
+    std::swap(this->loadFactorThreshold, other.loadFactorThreshold);
+    std::swap(this->pool, other.pool);
+    std::swap(this->table, other.table);
+    std::swap(this->oldTable, other.oldTable);
+    std::swap(this->migrateIndex, other.migrateIndex);
+    std::swap(this->migrationBudget, other.migrationBudget);
+    std::swap(this->reHashThreads, other.reHashThreads);
+    std::swap(this->growthFactor, other.growthFactor);
+    std::swap(this->shrinkThreshold, other.shrinkThreshold);
+    std::swap(this->reHashes, other.reHashes);
+    std::swap(this->reHashNanos, other.reHashNanos);
+    std::swap(this->seed, other.seed);
+    std::swap(this->valueIndex, other.valueIndex);
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Empties every bucket of both tables. Nodes of trivially destructible
+ * types are not visited one by one since their slabs are dropped as a whole
+ * by the pool.
+ * 
+ */
+void BucketedHashMap<K,V,Traits>::releaseNodes() {
+    bool trivial = std::is_trivially_destructible<K>::value && std::is_trivially_destructible<V>::value;
+    for (size_t i = 0; i < this->table.size(); i++) {
+        if (trivial) {
+            this->table[i].release();
+        } else {
+            this->table[i].clear();
+        }
+    }
+    for (size_t i = 0; i < this->oldTable.size(); i++) {
+        if (trivial) {
+            this->oldTable[i].release();
+        } else {
+            this->oldTable[i].clear();
         }
     }
-    return false;
 }
 
-template <class K, class V>
+template <class K, class V, class Traits>
 /**
- * @brief Returns the reference to the value paired to the given key
+ * @brief clears the hash map vector and releases every node slab at once
  * 
- * @param key 
- * @return V& 
  */
-V& BucketedHashMap<K,V>::get(const K key) const {
-    return this->table[this->getVectorIndex(key)].get(key);
+void BucketedHashMap<K,V,Traits>::clear() {
+    this->releaseNodes();
+    this->pool->reset();
+    this->oldTable = std::vector<KVList<K, V>>();
+    this->migrateIndex = 0;
+    this->size = 0;
+    this->valueIndex.clear();
 }
 
-template <class K, class V>
+template <class K, class V, class Traits>
+template <class F>
 /**
- * @brief Returns the reference to the value paired to the given key
+ * @brief Splits [0, n) into threads contiguous ranges and runs fn(t, begin, end)
+ * for range t on its own thread, the first on the calling one. The first
+ * exception thrown by a worker is rethrown once they have all finished.
  * 
- * @param key 
- * @return V& 
+ * @param threads 
+ * @param n 
+ * @param fn 
  */
-V& BucketedHashMap<K,V>::operator[](const K key) const {
-    return this->get(key);
+void BucketedHashMap<K,V,Traits>::parallelFor(unsigned int threads, size_t n, F fn) {
+    std::vector<std::thread> workers = std::vector<std::thread>();
+    std::vector<std::exception_ptr> errors = std::vector<std::exception_ptr>(threads);
+    for (unsigned int t = 0; t < threads; t++) {
+        size_t begin = n * t / threads;
+        size_t end = n * (t + 1) / threads;
+        std::function<void()> work = [&fn, &errors, t, begin, end]() {
+            try {
+                fn(t, begin, end);
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        };
+        if (t + 1 < threads) {
+            workers.push_back(std::thread(work));
+        } else {
+            work();
+        }
+    }
+    for (size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+    for (unsigned int t = 0; t < threads; t++) {
+        if (errors[t]) {
+            std::rethrow_exception(errors[t]);
+        }
+    }
 }
 
-template <class K, class V>
+template <class K, class V, class Traits>
+template <class It>
 /**
- * @brief Returns whether or not the map is empty.
+ * @brief Replaces the contents of the map with the key-value pairs of a
+ * random access range, as if each were inserted in order, so a later pair
+ * overwrites an earlier one with the same key. The table is sized once for
+ * the whole range and every node is carved from one bulk pool slab. With
+ * several threads the keys are hashed in parallel and split by destination
+ * bucket range, so each worker builds the chains of its own buckets without
+ * any lock.
  * 
- * @return true 
- * @return false 
+ * @param first 
+ * @param last 
+ * @param threads the number of threads to build with, including the calling one
  */
-bool BucketedHashMap<K,V>::isEmpty() const {
-    return this->size == 0;
+void BucketedHashMap<K,V,Traits>::assign(It first, It last, unsigned int threads) {
+    this->clear();
+    size_t count = (size_t)std::distance(first, last);
+    if (threads < 1) {
+        threads = 1;
+    }
+    if (threads > count / 1024 + 1) {
+        threads = (unsigned int)(count / 1024 + 1);
+    }
+    size_t wanted = (size_t)std::ceil((double)count / this->loadFactorThreshold);
+    this->capacity = Traits::CapacityPolicy::roundCapacity(wanted > this->capacity ? wanted : this->capacity);
+    this->table = this->newTable(this->capacity);
+    char *slots = static_cast<char *>(this->pool->allocateBulk(count));
+    std::vector<size_t> hashes = std::vector<size_t>(count);
+    std::vector<std::vector<size_t>> parts = std::vector<std::vector<size_t>>(threads > 1 ? threads * threads : 0);
+    std::vector<size_t> inserted = std::vector<size_t>(threads);
+    parallelFor(threads, count, [&](unsigned int t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            hashes[i] = this->hashOf(first[i].first);
+            if (threads > 1) {
+                parts[t * threads + (size_t)this->indexOf(hashes[i]) * threads / this->capacity].push_back(i);
+            }
+        }
+    });
+    auto link = [&](size_t i, size_t p) {
+        KVList<K, V> &bucket = this->table[this->indexOf(hashes[i])];
+        MapNode<K, V> *tmp = bucket.find(first[i].first, hashes[i]);
+        if (tmp) {
+            tmp->value = first[i].second;
+        } else {
+            linkNode(bucket, new (slots + i * sizeof(MapNode<K, V>)) MapNode<K, V>(hashes[i], first[i].first, first[i].second));
+            inserted[p]++;
+        }
+    };
+    try {
+        if (threads == 1) {
+            for (size_t i = 0; i < count; i++) {
+                if (i + kPrefetchDistance < count) {
+                    prefetch(&this->table[this->indexOf(hashes[i + kPrefetchDistance])]);
+                }
+                link(i, 0);
+            }
+        } else {
+            parallelFor(threads, threads, [&](unsigned int, size_t begin, size_t end) {
+                for (size_t p = begin; p < end; p++) {
+                    for (size_t t = 0; t < threads; t++) {
+                        std::vector<size_t> &part = parts[t * threads + p];
+                        for (size_t j = 0; j < part.size(); j++) {
+                            if (j + kPrefetchDistance < part.size()) {
+                                prefetch(&this->table[this->indexOf(hashes[part[j + kPrefetchDistance]])]);
+                            }
+                            link(part[j], p);
+                        }
+                    }
+                }
+            });
+        }
+    } catch (...) {
+        this->clear();
+        throw;
+    }
+    for (unsigned int p = 0; p < threads; p++) {
+        this->size += inserted[p];
+        this->pool->adopt(inserted[p]);
+    }
+    this->reindexValues();
 }
 
-template <class K, class V>
+template <class K, class V, class Traits>
 /**
- * @brief inserts a key-value pair into the map
+ * @brief Returns how many threads to split the buckets of the map across:
+ * the number asked for, but at least one and no more than one per 1024
+ * buckets. Always one with Traits::indexValues, whose index takes no lock.
+ * 
+ * @param threads 
+ * @return unsigned int 
+ */
+unsigned int BucketedHashMap<K,V,Traits>::setThreads(unsigned int threads) const {
+    if (threads < 1 || Traits::indexValues) {
+        threads = 1;
+    }
+    if (threads > this->capacity / 1024 + 1) {
+        threads = (unsigned int)(this->capacity / 1024 + 1);
+    }
+    return threads;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Returns the node of another map holding the key of a node of this
+ * one, or nullptr. The cached hash is reused when both maps share a seed.
+ * Never reorders the other map, so it is safe to call from several threads.
+ * 
+ * @param other a map whose incremental reHash is finished
+ * @param node 
+ * @return const MapNode<K,V>* 
+ */
+const MapNode<K,V>* BucketedHashMap<K,V,Traits>::findIn(const BucketedHashMap &other, const MapNode<K, V> *node) const {
+    size_t hash = other.seed == this->seed ? node->hash : other.hashOf(node->key);
+    const KVList<K, V> &bucket = other.table[other.indexOf(hash)];
+    if (Traits::filterBuckets && !bucket.mayContain(hash)) {
+        return nullptr;
+    }
+    return bucket.find(node->key, hash);
+}
+
+template <class K, class V, class Traits>
+template <class F>
+/**
+ * @brief Sets the value of a node to resolve(mine, theirs), keeping the
+ * value index in step, or does nothing if resolve is nullptr.
+ * 
+ * @param node 
+ * @param theirs 
+ * @param resolve 
+ */
+void BucketedHashMap<K,V,Traits>::resolveInto(MapNode<K, V> *node, const V &theirs, F &resolve) {
+    if constexpr (!std::is_same<F, std::nullptr_t>::value) {
+        this->valueIndex.remove(node);
+        try {
+            node->value = resolve(node->value, theirs);
+        } catch (...) {
+            this->valueIndex.add(node);
+            throw;
+        }
+        this->valueIndex.add(node);
+    }
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Rebuilds the value index from every node, after a bulk build.
+ * 
+ */
+void BucketedHashMap<K,V,Traits>::reindexValues() {
+    if constexpr (Traits::indexValues) {
+        this->valueIndex.clear();
+        for (size_t i = 0; i < this->table.size(); i++) {
+            for (const MapNode<K, V> *tmp = this->table[i].begin(); tmp; tmp = tmp->next) {
+                this->valueIndex.add(tmp);
+            }
+        }
+        for (size_t i = this->migrateIndex; i < this->oldTable.size(); i++) {
+            for (const MapNode<K, V> *tmp = this->oldTable[i].begin(); tmp; tmp = tmp->next) {
+                this->valueIndex.add(tmp);
+            }
+        }
+    }
+}
+
+template <class K, class V, class Traits>
+template <class KK, class VV>
+/**
+ * @brief Inserts a key-value pair into a bucket or assigns the value to the
+ * existing key, see KVList::insertOrAssign(). With Traits::indexValues an
+ * assigned node is taken out of the value index before its value changes.
  * 
+ * @param bucket 
+ * @param hash 
  * @param key 
  * @param value 
+ * @return std::pair<MapNode<K,V>*, bool> the node of the key and whether it was added
  */
-void BucketedHashMap<K,V>::insert(const K key, const V value) {
-    if (((double)this->size/(double)this->capacity) >= this->loadFactorThreshold) {
-        this->reHash();
+std::pair<MapNode<K,V>*, bool> BucketedHashMap<K,V,Traits>::assignInBucket(KVList<K, V> &bucket, size_t hash, KK &&key, VV &&value) {
+    if constexpr (Traits::indexValues) {
+        MapNode<K, V> *tmp = bucket.find(key, hash);
+        if (tmp) {
+            this->valueIndex.remove(tmp);
+            try {
+                tmp->value = std::forward<VV>(value);
+            } catch (...) {
+                this->valueIndex.add(tmp);
+                throw;
+            }
+            this->valueIndex.add(tmp);
+            return std::pair<MapNode<K,V>*, bool>(tmp, false);
+        }
+        std::pair<MapNode<K,V>*, bool> res = bucket.tryEmplace(hash, std::forward<KK>(key), std::forward<VV>(value));
+        this->valueIndex.add(res.first);
+        fingerprintLinked(bucket, hash);
+        return res;
+    } else {
+        std::pair<MapNode<K,V>*, bool> res = bucket.insertOrAssign(hash, std::forward<KK>(key), std::forward<VV>(value));
+        fingerprintLinked(bucket, hash);
+        return res;
     }
-    this->size += this->table[this->getVectorIndex(key)].update(key, value);
 }
 
-template <class K, class V>
+template <class K, class V, class Traits>
 /**
- * @brief removes the given key and value node from the map
+ * @brief Resizes the table after a bulk change, as insert() and remove()
+ * would have one entry at a time: grown when over loadFactorThreshold,
+ * shrunk when under the shrink threshold.
  * 
- * @param key 
- * @return V 
  */
-V BucketedHashMap<K,V>::remove(const K key) {
-    this->size--;
-    return this->table[this->getVectorIndex(key)].remove(key);
+void BucketedHashMap<K,V,Traits>::refit() {
+    if ((double)this->size / (double)this->capacity >= this->loadFactorThreshold) {
+        this->reserve(this->size);
+    } else if ((double)this->size / (double)this->capacity < this->shrinkThreshold) {
+        size_t buckets = this->fittedCapacity(this->size, (this->shrinkThreshold + this->loadFactorThreshold) / 2);
+        if (buckets < this->capacity) {
+            this->resize(buckets);
+        }
+    }
 }
 
-template <class K, class V>
+template <class K, class V, class Traits>
 /**
- * @brief returns the size of the map
+ * @brief Adds every entry of other whose key is missing from this map,
+ * keeping the values of this map for the keys in both.
+ * See merge(const BucketedHashMap &, F, unsigned int).
  * 
- * @return int 
+ * @param other 
+ * @param threads 
  */
-int BucketedHashMap<K,V>::getSize() const {
-    return this->size;
+void BucketedHashMap<K,V,Traits>::merge(const BucketedHashMap &other, unsigned int threads) {
+    this->merge(other, nullptr, threads);
 }
 
-template <class K, class V>
+template <class K, class V, class Traits>
+template <class F, class>
 /**
- * @brief returns all entries in the map in a vector
+ * @brief Adds every entry of other to this map. For a key in both maps the
+ * value becomes resolve(mine, theirs), or stays as it is if resolve is
+ * nullptr. Each thread looks up the keys of its own range of buckets of
+ * other, then the missing entries are copied into one bulk pool slab and
+ * linked without a lock, each bucket of this map by a single thread.
+ * When both maps share a seed and a capacity (a copy, or a map given the
+ * seed of the other with setSeed() and the same capacity), bucket i of
+ * other can only hold keys of bucket i of this map, so the cached hashes
+ * are reused, the thread that looked a key up also links it and the table
+ * is grown afterwards if needed. Otherwise the keys are hashed with the
+ * seed of this map, the table is grown once for all missing entries, and
+ * those are split by destination bucket range before linking.
+ * If a copy or resolve throws, the entries merged so far are kept.
  * 
- * @return std::vector<MapNode<K,V>> 
+ * @param other 
+ * @param resolve V(const V &mine, const V &theirs), called concurrently when threads > 1
+ * @param threads the number of threads to merge with, including the calling one
  */
-std::vector<MapNode<K,V>> BucketedHashMap<K,V>::getEntries() const {
-    std::vector<K> keys = this->getKeys();
-    std::vector<V> values = this->getValues();
-    std::vector<MapNode<K,V>> res = std::vector<MapNode<K,V>>();
-    for (int i = 0; i < this->size; i++) {
-        res.push_back(MapNode<K,V>(keys[i], values[i]));
+void BucketedHashMap<K,V,Traits>::merge(const BucketedHashMap &other, F resolve, unsigned int threads) {
+    this->finishReHash();
+    other.migrate(other.oldTable.size());
+    bool aligned = other.seed == this->seed && other.capacity == this->capacity;
+    threads = this->setThreads(threads);
+    std::vector<std::vector<std::pair<size_t, const MapNode<K, V> *>>> missing = std::vector<std::vector<std::pair<size_t, const MapNode<K, V> *>>>(threads);
+    parallelFor(threads, other.capacity, [&](unsigned int t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            if (i + kPrefetchDistance < end) {
+                if (aligned) {
+                    prefetch(this->table[i + kPrefetchDistance].begin());
+                }
+                prefetch(other.table[i + kPrefetchDistance].begin());
+            }
+            for (const MapNode<K, V> *tmp = other.table[i].begin(); tmp; tmp = tmp->next) {
+                size_t hash = other.seed == this->seed ? tmp->hash : this->hashOf(tmp->key);
+                MapNode<K, V> *mine = this->table[this->indexOf(hash)].find(tmp->key, hash);
+                if (!mine) {
+                    missing[t].push_back(std::pair<size_t, const MapNode<K, V> *>(hash, tmp));
+                } else {
+                    this->resolveInto(mine, tmp->value, resolve);
+                }
+            }
+        }
+    });
+    std::vector<size_t> firstSlot = std::vector<size_t>(threads + 1, 0);
+    for (unsigned int t = 0; t < threads; t++) {
+        firstSlot[t + 1] = firstSlot[t] + missing[t].size();
+    }
+    if (firstSlot[threads] == 0) {
+        return;
+    }
+    std::vector<std::vector<size_t>> parts = std::vector<std::vector<size_t>>(aligned ? 0 : threads * threads);
+    if (!aligned) {
+        this->reserve(this->size + firstSlot[threads]);
+        this->finishReHash();
+        parallelFor(threads, threads, [&](unsigned int, size_t begin, size_t end) {
+            for (size_t t = begin; t < end; t++) {
+                for (size_t j = 0; j < missing[t].size(); j++) {
+                    parts[t * threads + (size_t)this->indexOf(missing[t][j].first) * threads / this->capacity].push_back(j);
+                }
+            }
+        });
+    }
+    char *slots = static_cast<char *>(this->pool->allocateBulk(firstSlot[threads]));
+    std::vector<size_t> inserted = std::vector<size_t>(threads);
+    auto link = [&](size_t t, size_t j, size_t p) {
+        const std::pair<size_t, const MapNode<K, V> *> &entry = missing[t][j];
+        void *slot = slots + (firstSlot[t] + j) * sizeof(MapNode<K, V>);
+        MapNode<K, V> *n = new (slot) MapNode<K, V>(entry.first, entry.second->key, entry.second->value);
+        linkNode(this->table[this->indexOf(entry.first)], n);
+        this->valueIndex.add(n);
+        inserted[p]++;
+    };
+    std::exception_ptr error = nullptr;
+    try {
+        parallelFor(threads, threads, [&](unsigned int, size_t begin, size_t end) {
+            for (size_t p = begin; p < end; p++) {
+                if (aligned) {
+                    for (size_t j = 0; j < missing[p].size(); j++) {
+                        link(p, j, p);
+                    }
+                    continue;
+                }
+                for (size_t t = 0; t < threads; t++) {
+                    std::vector<size_t> &part = parts[t * threads + p];
+                    for (size_t j = 0; j < part.size(); j++) {
+                        link(t, part[j], p);
+                    }
+                }
+            }
+        });
+    } catch (...) {
+        error = std::current_exception();
+    }
+    for (unsigned int t = 0; t < threads; t++) {
+        this->size += inserted[t];
+        this->pool->adopt(inserted[t]);
+    }
+    this->refit();
+    if (error) {
+        std::rethrow_exception(error);
     }
-    return res;
 }
 
-template <class K, class V>
+template <class K, class V, class Traits>
+template <bool Keep, class F>
 /**
- * @brief returns all keys in the map in a vector
+ * @brief Keeps the entries whose key is (Keep) or is not (!Keep) in other
+ * and unlinks the rest, bucket by bucket: each thread relinks the chains of
+ * its own bucket range, looking keys up in other with findIn(), and the
+ * unlinked nodes are destroyed on the calling thread once all are done.
+ * When both maps share a seed and a capacity, a bucket whose counterpart in
+ * other is empty is kept or dropped whole without a lookup.
  * 
- * @return std::vector<K> 
+ * @param other a map other than this one
+ * @param resolve see intersect(), unused unless Keep
+ * @param threads 
  */
-std::vector<K> BucketedHashMap<K,V>::getKeys() const{
-    std::vector<K> res = std::vector<K>();
-    for (int i = 0; i < this->capacity; i++) {
-        std::vector<K> tmpV = this->table[i].getKeys();
-        for (int j = 0; j < tmpV.size(); j++)
-        {
-            res.push_back(tmpV[j]);
+void BucketedHashMap<K,V,Traits>::filterBy(const BucketedHashMap &other, F resolve, unsigned int threads) {
+    this->finishReHash();
+    other.migrate(other.oldTable.size());
+    bool aligned = other.seed == this->seed && other.capacity == this->capacity;
+    threads = this->setThreads(threads);
+    std::vector<std::vector<MapNode<K, V> *>> dropped = std::vector<std::vector<MapNode<K, V> *>>(threads);
+    std::exception_ptr error = nullptr;
+    try {
+        parallelFor(threads, this->capacity, [&](unsigned int t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                if (this->table[i].isEmpty() || (aligned && other.table[i].isEmpty() && !Keep)) {
+                    continue;
+                }
+                MapNode<K, V> *tmp = this->table[i].release();
+                try {
+                    while (tmp) {
+                        const MapNode<K, V> *theirs = aligned && other.table[i].isEmpty() ? nullptr : this->findIn(other, tmp);
+                        MapNode<K, V> *next = tmp->next;
+                        if ((theirs != nullptr) == Keep) {
+                            if constexpr (Keep) {
+                                this->resolveInto(tmp, theirs->value, resolve);
+                            }
+                            linkNode(this->table[i], tmp);
+                        } else {
+                            dropped[t].push_back(tmp);
+                        }
+                        tmp = next;
+                    }
+                } catch (...) {
+                    while (tmp) {
+                        MapNode<K, V> *next = tmp->next;
+                        linkNode(this->table[i], tmp);
+                        tmp = next;
+                    }
+                    throw;
+                }
+            }
+        });
+    } catch (...) {
+        error = std::current_exception();
+    }
+    for (unsigned int t = 0; t < threads; t++) {
+        for (size_t j = 0; j < dropped[t].size(); j++) {
+            this->valueIndex.remove(dropped[t][j]);
+            this->pool->destroy(dropped[t][j]);
         }
+        this->size -= dropped[t].size();
     }
-    return res;
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    this->refit();
 }
 
-template <class K, class V>
+template <class K, class V, class Traits>
 /**
- * @brief returns all values in the map in a vector
+ * @brief Removes every key that is also in other. When both maps share a
+ * seed and a capacity, each thread unlinks the keys of the buckets of other
+ * in its range from the matching buckets of this map with the cached hashes,
+ * touching no other node. Otherwise this map is filtered bucket by bucket
+ * like intersect(), looking its keys up in other. Either way there is no
+ * reHash, and the unlinked nodes are destroyed on the calling thread.
  * 
- * @return std::vector<V> 
+ * @param other 
+ * @param threads the number of threads to work with, including the calling one
  */
-std::vector<V> BucketedHashMap<K,V>::getValues() const{
-    std::vector<V> res = std::vector<V>();
-    for (int i = 0; i < this->capacity; i++) {
-        std::vector<V> tmpV = this->table[i].getValues();
-        for (int j = 0; j < tmpV.size(); j++)
-        {
-            res.push_back(tmpV[j]);
+void BucketedHashMap<K,V,Traits>::subtract(const BucketedHashMap &other, unsigned int threads) {
+    if (&other == this) {
+        this->clear();
+        return;
+    }
+    this->finishReHash();
+    other.migrate(other.oldTable.size());
+    if (other.seed != this->seed || other.capacity != this->capacity) {
+        this->template filterBy<false>(other, nullptr, threads);
+        return;
+    }
+    threads = this->setThreads(threads);
+    std::vector<std::vector<MapNode<K, V> *>> dropped = std::vector<std::vector<MapNode<K, V> *>>(threads);
+    std::exception_ptr error = nullptr;
+    try {
+        parallelFor(threads, this->capacity, [&](unsigned int t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                if (i + kPrefetchDistance < end) {
+                    prefetch(this->table[i + kPrefetchDistance].begin());
+                    prefetch(other.table[i + kPrefetchDistance].begin());
+                }
+                for (const MapNode<K, V> *tmp = other.table[i].begin(); tmp && !this->table[i].isEmpty(); tmp = tmp->next) {
+                    MapNode<K, V> *mine = this->table[i].unlink(tmp->key, tmp->hash);
+                    if (mine) {
+                        fingerprintUnlinked(this->table[i]);
+                        dropped[t].push_back(mine);
+                    }
+                }
+            }
+        });
+    } catch (...) {
+        error = std::current_exception();
+    }
+    for (unsigned int t = 0; t < threads; t++) {
+        for (size_t j = 0; j < dropped[t].size(); j++) {
+            this->valueIndex.remove(dropped[t][j]);
+            this->pool->destroy(dropped[t][j]);
         }
+        this->size -= dropped[t].size();
     }
-    return res;
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    this->refit();
 }
 
-template <class K, class V>
+template <class K, class V, class Traits>
 /**
- * @brief prints the map
+ * @brief Removes every key that is not also in other, keeping the values of
+ * this map. See intersect(const BucketedHashMap &, F, unsigned int).
  * 
+ * @param other 
+ * @param threads 
  */
-void BucketedHashMap<K,V>::show() const{
-    std::vector<MapNode<K,V>> entries = this->getEntries();
-    std::cout << "Bucketed Hash Map Entries: [ " << std::endl;
-    for (int i = 0; i < this->size; i++)
-    {
-        std::cout << "    " << "{K: " << entries[i].key << ", V: " << entries[i].value << "}";
-        if (i < this->size-1) {
-            std::cout << ",";
+void BucketedHashMap<K,V,Traits>::intersect(const BucketedHashMap &other, unsigned int threads) {
+    this->intersect(other, nullptr, threads);
+}
+
+template <class K, class V, class Traits>
+template <class F, class>
+/**
+ * @brief Removes every key that is not also in other, and sets the value of
+ * every key left to resolve(mine, theirs) unless resolve is nullptr. Works
+ * bucket by bucket in parallel like subtract(). If resolve throws, every
+ * bucket already filtered stays filtered.
+ * 
+ * @param other 
+ * @param resolve V(const V &mine, const V &theirs), called concurrently when threads > 1
+ * @param threads the number of threads to work with, including the calling one
+ */
+void BucketedHashMap<K,V,Traits>::intersect(const BucketedHashMap &other, F resolve, unsigned int threads) {
+    if (&other == this) {
+        this->finishReHash();
+        for (size_t i = 0; i < this->table.size(); i++) {
+            for (MapNode<K, V> *tmp = this->table[i].begin(); tmp; tmp = tmp->next) {
+                this->resolveInto(tmp, tmp->value, resolve);
+            }
         }
-        std::cout << std::endl;
+        return;
     }
-    std::cout << "]" << std::endl;
+    this->template filterBy<true>(other, resolve, threads);
 }
 
-template <class K, class V>
+template <class K, class V, class Traits>
+template <class Q>
 /**
- * @brief returns an ostream representation of the map
+ * @brief Hashes a key under the seed of the map, see hashKey().
  * 
- * @param o 
- * @param bHM 
- * @return std::ostream& 
+ * @param key 
+ * @return size_t 
  */
-std::ostream& operator<<(std::ostream& o, BucketedHashMap<K,V> & bHM) {
-    std::vector<MapNode<K,V>> entries = bHM.getEntries();
-    o << "Bucketed Hash Map Entries: [ " << std::endl;
-    for (int i = 0; i < bHM.getSize(); i++)
-    {
-        o << "    " << "{K: " << entries[i].key << ", V: " << entries[i].value << "}";
-        if (i < bHM.getSize()-1) {
-            o << ",";
+size_t BucketedHashMap<K,V,Traits>::hashOf(const Q &key) const {
+    return hashKey<K>(key, this->seed);
+}
+
+template <class K, class V, class Traits>
+template <class Q>
+/**
+ * @brief Returns the node holding the given key in one bucket, or nullptr.
+ * Unless Traits::ReorderPolicy is NoReorder the node found is moved towards
+ * the head of its chain, which is why the buckets are mutable: a const
+ * lookup reorders a chain but never changes the entries of the map.
+ * With Traits::filterBuckets a hash missing from the fingerprint of the
+ * bucket returns before the chain is touched.
+ * 
+ * @param bucket 
+ * @param key 
+ * @param hash 
+ * @return MapNode<K,V>* 
+ */
+MapNode<K,V>* BucketedHashMap<K,V,Traits>::findInBucket(KVList<K, V> &bucket, const Q &key, size_t hash) {
+    if (Traits::filterBuckets && !bucket.mayContain(hash)) {
+        return nullptr;
+    }
+    if constexpr (Traits::ReorderPolicy::enabled) {
+        return bucket.template findAndPromote<typename Traits::ReorderPolicy>(key, hash);
+    } else {
+        return bucket.find(key, hash);
+    }
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Links a node whose key is not in the bucket yet into it, setting
+ * its fingerprint bit with Traits::filterBuckets.
+ * 
+ * @param bucket 
+ * @param node 
+ */
+void BucketedHashMap<K,V,Traits>::linkNode(KVList<K, V> &bucket, MapNode<K, V> *node) {
+    bucket.push(node);
+    fingerprintLinked(bucket, node->hash);
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Sets the fingerprint bit of a hash just inserted into a bucket.
+ * Only with Traits::filterBuckets, so other maps never touch fingerprints.
+ * 
+ * @param bucket 
+ * @param hash 
+ */
+void BucketedHashMap<K,V,Traits>::fingerprintLinked(KVList<K, V> &bucket, size_t hash) {
+    if constexpr (Traits::filterBuckets) {
+        bucket.addFingerprint(hash);
+    }
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Rebuilds the fingerprint of a bucket a node was just unlinked
+ * from. Only with Traits::filterBuckets.
+ * 
+ * @param bucket 
+ */
+void BucketedHashMap<K,V,Traits>::fingerprintUnlinked(KVList<K, V> &bucket) {
+    if constexpr (Traits::filterBuckets) {
+        bucket.refingerprint();
+    }
+}
+
+template <class K, class V, class Traits>
+template <class Q>
+/**
+ * @brief Returns the node holding the given key, or nullptr, looking in
+ * oldTable as well while a reHash is in progress. The key can be any type
+ * BucketedHash<K> and K's operator== accept, e.g. a std::string_view for
+ * std::string keys, so lookups build no temporary K.
+ * 
+ * @param key 
+ * @return MapNode<K,V>* 
+ */
+MapNode<K,V>* BucketedHashMap<K,V,Traits>::findNode(const Q &key) const {
+    return this->findNode(key, this->hashOf(key));
+}
+
+template <class K, class V, class Traits>
+template <class Q>
+/**
+ * @brief Returns the node holding the given key, whose hash under the seed
+ * of the map is already known, or nullptr.
+ * 
+ * @param key 
+ * @param hash hashKey<K>(key, getSeed())
+ * @return MapNode<K,V>* 
+ */
+MapNode<K,V>* BucketedHashMap<K,V,Traits>::findNode(const Q &key, size_t hash) const {
+    this->migrate(this->migrationBudget);
+    if (this->isReHashing()) {
+        MapNode<K, V> *old = findInBucket(this->oldTable[this->oldIndexOf(hash)], key, hash);
+        if (old) {
+            return old;
         }
-        o << std::endl;
     }
-    o << "]" << std::endl;
-    return o;
+    return findInBucket(this->table[this->indexOf(hash)], key, hash);
 }
 
-template <class K, class V>
+template <class K, class V, class Traits>
 /**
- * @brief prints the list + structure
+ * @brief Returns whether or not the hashmap contains the passed in key
  * 
+ * @param key 
+ * @return true 
+ * @return false 
  */
-void BucketedHashMap<K,V>::showStructure() const{
-    std::cout << "Bucketed Hash Map Structure: < " << std::endl;
+bool BucketedHashMap<K,V,Traits>::containsKey(const K &key) const {
+    return this->findNode(key) != nullptr;
+}
+
+template <class K, class V, class Traits>
+template <class Q>
+/**
+ * @brief Returns whether or not the hashmap contains a key equal to the passed
+ * in one, which does not need to be a K
+ * 
+ * @param key 
+ * @return true 
+ * @return false 
+ */
+bool BucketedHashMap<K,V,Traits>::contains(const Q &key) const {
+    return this->findNode(key) != nullptr;
+}
+
+template <class K, class V, class Traits>
+template <class Q>
+/**
+ * @brief contains() for a caller that already hashed the key under the seed
+ * of the map, e.g. to pick the map among several sharing that seed.
+ * 
+ * @param key 
+ * @param hash hashKey<K>(key, getSeed())
+ * @return true 
+ * @return false 
+ */
+bool BucketedHashMap<K,V,Traits>::containsHashed(const Q &key, size_t hash) const {
+    return this->findNode(key, hash) != nullptr;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Returns whether or not the hashmap contains the passed in value.
+ * A hash lookup with Traits::indexValues, otherwise a walk over every node.
+ * 
+ * @param value 
+ * @return true 
+ * @return false 
+ */
+bool BucketedHashMap<K,V,Traits>::containsValue(const V value) const {
+    if constexpr (Traits::indexValues) {
+        return this->valueIndex.contains(value);
+    }
     for (int i = 0; i < this->capacity; i++) {
-        std::cout << "    Bucket at index " << i << ": ";
-        this->table[i].show();
-        std::cout << std::endl;
+        if (this->table[i].hasValue(value)) {
+            return true;
+        }
     }
-    std::cout << ">" << std::endl;
+    for (size_t i = this->migrateIndex; i < this->oldTable.size(); i++) {
+        if (this->oldTable[i].hasValue(value)) {
+            return true;
+        }
+    }
+    return false;
 }
 
-template <class K, class V>
+template <class K, class V, class Traits>
 /**
- * @brief rehashes ahd resizes the hashmap
+ * @brief Returns the keys of every entry holding the passed in value, in no
+ * particular order. A hash lookup with Traits::indexValues, otherwise a walk
+ * over every node.
  * 
- */
-void BucketedHashMap<K,V>::reHash() {
-    std::vector<MapNode<K,V>> entries = this->getEntries();
-    this->capacity = this->capacity * 2;
-    this->table = std::vector<KVList<K, V>>(this->capacity, KVList<K,V>());
-    this->size = 0;
-    for (int i = 0; i < entries.size(); i++)
-    {
-        this->insert(entries[i].key, entries[i].value);
+ * @param value 
+ * @return std::vector<K> 
+ */
+std::vector<K> BucketedHashMap<K,V,Traits>::keysForValue(const V &value) const {
+    if constexpr (Traits::indexValues) {
+        return this->valueIndex.keysFor(value);
+    } else {
+        std::vector<K> res = std::vector<K>();
+        for (const_iterator it = this->begin(); it != this->end(); ++it) {
+            if (it->value == value) {
+                res.push_back(it->key);
+            }
+        }
+        return res;
+    }
+}
+
+template <class K, class V, class Traits>
+template <class Q>
+/**
+ * @brief Returns a pointer to the value paired to a key equal to the passed
+ * in one, which does not need to be a K
+ * 
+ * @param key 
+ * @return exposed_value* the value, or nullptr if the key is not found
+ */
+typename BucketedHashMap<K,V,Traits>::exposed_value* BucketedHashMap<K,V,Traits>::find(const Q &key) const {
+    MapNode<K, V> *tmp = this->findNode(key);
+    return tmp ? &tmp->value : nullptr;
+}
+
+template <class K, class V, class Traits>
+template <class Q>
+/**
+ * @brief find() for a caller that already hashed the key under the seed of
+ * the map, see containsHashed().
+ * 
+ * @param key 
+ * @param hash hashKey<K>(key, getSeed())
+ * @return exposed_value* the value, or nullptr if the key is not found
+ */
+typename BucketedHashMap<K,V,Traits>::exposed_value* BucketedHashMap<K,V,Traits>::findHashed(const Q &key, size_t hash) const {
+    MapNode<K, V> *tmp = this->findNode(key, hash);
+    return tmp ? &tmp->value : nullptr;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Returns the reference to the value paired to the given key
+ * 
+ * @param key 
+ * @return exposed_value& 
+ * @throws std::invalid_argument if the key is not found.
+ */
+typename BucketedHashMap<K,V,Traits>::exposed_value& BucketedHashMap<K,V,Traits>::get(const K &key) const {
+    MapNode<K, V> *tmp = this->findNode(key);
+    if (!tmp) {
+        throw std::invalid_argument("Key not found");
+    }
+    return tmp->value;
+}
+
+template <class K, class V, class Traits>
+template <class Q>
+/**
+ * @brief Returns the reference to the value paired to a key equal to the
+ * passed in one, which does not need to be a K
+ * 
+ * @param key 
+ * @return exposed_value& 
+ * @throws std::invalid_argument if the key is not found.
+ */
+typename BucketedHashMap<K,V,Traits>::exposed_value& BucketedHashMap<K,V,Traits>::get(const Q &key) const {
+    MapNode<K, V> *tmp = this->findNode(key);
+    if (!tmp) {
+        throw std::invalid_argument("Key not found");
+    }
+    return tmp->value;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Returns the reference to the value paired to the given key
+ * 
+ * @param key 
+ * @return exposed_value& 
+ */
+typename BucketedHashMap<K,V,Traits>::exposed_value& BucketedHashMap<K,V,Traits>::operator[](const K &key) const {
+    return this->get(key);
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Hints the CPU to start loading the cache line at address. Prefetching
+ * never faults, so address may be nullptr.
+ * 
+ * @param address 
+ */
+void BucketedHashMap<K,V,Traits>::prefetch(const void *address) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address);
+#else
+    (void)address;
+#endif
+}
+
+template <class K, class V, class Traits>
+template <class Q, class F>
+/**
+ * @brief Looks up count keys and calls visit(i, node) for each, with node
+ * nullptr on a miss. Keys are handled kBatchChunk at a time: all of them are
+ * hashed first while their buckets are prefetched, then each bucket's first
+ * node is prefetched kPrefetchDistance keys before it is searched, so the
+ * cache misses of different keys overlap instead of following one another.
+ * The reHash work of count single lookups is done up front.
+ * 
+ * @param keys 
+ * @param count 
+ * @param visit 
+ */
+void BucketedHashMap<K,V,Traits>::lookupMany(const Q *keys, size_t count, F visit) const {
+    this->migrate(this->migrationBudget * count);
+    size_t hashes[kBatchChunk];
+    size_t buckets[kBatchChunk];
+    for (size_t base = 0; base < count; base += kBatchChunk) {
+        size_t n = count - base < kBatchChunk ? count - base : kBatchChunk;
+        for (size_t i = 0; i < n; i++) {
+            hashes[i] = this->hashOf(keys[base + i]);
+            buckets[i] = this->indexOf(hashes[i]);
+            prefetch(&this->table[buckets[i]]);
+        }
+        for (size_t i = 0; i < n && i < kPrefetchDistance; i++) {
+            prefetch(this->table[buckets[i]].begin());
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (i + kPrefetchDistance < n) {
+                prefetch(this->table[buckets[i + kPrefetchDistance]].begin());
+            }
+            MapNode<K, V> *node = nullptr;
+            if (this->isReHashing()) {
+                node = findInBucket(this->oldTable[this->oldIndexOf(hashes[i])], keys[base + i], hashes[i]);
+            }
+            if (!node) {
+                node = findInBucket(this->table[buckets[i]], keys[base + i], hashes[i]);
+            }
+            visit(base + i, node);
+        }
+    }
+}
+
+template <class K, class V, class Traits>
+template <class Q>
+/**
+ * @brief Looks up count keys at once, overlapping their cache misses, and
+ * stores a pointer to the value of keys[i] in out[i], or nullptr if the key
+ * is not found.
+ * 
+ * @param keys 
+ * @param count 
+ * @param out room for count pointers
+ * @return size_t the number of keys found
+ */
+size_t BucketedHashMap<K,V,Traits>::getMany(const Q *keys, size_t count, exposed_value **out) const {
+    size_t found = 0;
+    this->lookupMany(keys, count, [&](size_t i, MapNode<K, V> *node) {
+        out[i] = node ? &node->value : nullptr;
+        found += node != nullptr;
+    });
+    return found;
+}
+
+template <class K, class V, class Traits>
+template <class Q>
+/**
+ * @brief Looks up count keys at once, overlapping their cache misses, and
+ * stores whether keys[i] is in the map in out[i].
+ * 
+ * @param keys 
+ * @param count 
+ * @param out room for count bools
+ * @return size_t the number of keys found
+ */
+size_t BucketedHashMap<K,V,Traits>::containsMany(const Q *keys, size_t count, bool *out) const {
+    size_t found = 0;
+    this->lookupMany(keys, count, [&](size_t i, MapNode<K, V> *node) {
+        out[i] = node != nullptr;
+        found += node != nullptr;
+    });
+    return found;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Returns whether or not the map is empty.
+ * 
+ * @return true 
+ * @return false 
+ */
+bool BucketedHashMap<K,V,Traits>::isEmpty() const {
+    return this->size == 0;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Grows the table when the load factor threshold is reached and, while
+ * a reHash is in progress, migrates the old bucket of the hash and the
+ * per-operation budget, so a new node only ever goes into the new table.
+ * 
+ * @param hash 
+ */
+void BucketedHashMap<K,V,Traits>::prepareInsert(size_t hash) {
+    if (((double)this->size/(double)this->capacity) >= this->loadFactorThreshold) {
+        if (this->migrationBudget == 0) {
+            this->reHash();
+        } else {
+            std::chrono::steady_clock::time_point start = this->reHashClock();
+            this->finishReHash();
+            this->startReHash(this->grownCapacity());
+            this->recordReHash(start);
+        }
+    }
+    if (this->isReHashing()) {
+        this->migrateBucket(this->oldIndexOf(hash));
+        this->migrate(this->migrationBudget);
+    }
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief inserts a key-value pair into the map
+ * 
+ * @param key 
+ * @param value 
+ */
+void BucketedHashMap<K,V,Traits>::insert(const K &key, const V &value) {
+    this->insertOrAssign(key, value);
+}
+
+template <class K, class V, class Traits>
+template <class... Args>
+/**
+ * @brief Constructs a node in place from the arguments, the first building
+ * the key and the rest the value, and links it unless its key is already
+ * present, in which case the node is destroyed and the map left unchanged.
+ * The node is destroyed as well if hashing its key, growing the table or
+ * comparing keys throws.
+ * 
+ * @param args 
+ * @return std::pair<exposed_value*, bool> the value of the key and whether it was inserted
+ */
+std::pair<typename BucketedHashMap<K,V,Traits>::exposed_value*, bool> BucketedHashMap<K,V,Traits>::emplace(Args &&...args) {
+    MapNode<K, V> *n = this->pool->create(std::piecewise_construct, 0, std::forward<Args>(args)...);
+    MapNode<K, V> *tmp;
+    try {
+        n->hash = this->hashOf(n->key);
+        this->prepareInsert(n->hash);
+        tmp = this->table[this->indexOf(n->hash)].find(n->key, n->hash);
+    } catch (...) {
+        this->pool->destroy(n);
+        throw;
+    }
+    KVList<K, V> &bucket = this->table[this->indexOf(n->hash)];
+    if (tmp) {
+        this->pool->destroy(n);
+        return std::pair<exposed_value*, bool>(&tmp->value, false);
+    }
+    linkNode(bucket, n);
+    this->valueIndex.add(n);
+    this->size++;
+    return std::pair<exposed_value*, bool>(&n->value, true);
+}
+
+template <class K, class V, class Traits>
+template <class KK, class... Args>
+/**
+ * @brief Inserts the key with a value constructed in place from the arguments
+ * if the key is not present yet. If it is, nothing is constructed or moved
+ * from and the existing value is left untouched.
+ * 
+ * @param key 
+ * @param args the arguments of the value's constructor
+ * @return std::pair<exposed_value*, bool> the value of the key and whether it was inserted
+ */
+std::pair<typename BucketedHashMap<K,V,Traits>::exposed_value*, bool> BucketedHashMap<K,V,Traits>::tryEmplace(KK &&key, Args &&...args) {
+    size_t hash = this->hashOf(key);
+    return this->tryEmplaceHashed(hash, std::forward<KK>(key), std::forward<Args>(args)...);
+}
+
+template <class K, class V, class Traits>
+template <class KK, class... Args>
+/**
+ * @brief tryEmplace() for a caller that already hashed the key under the
+ * seed of the map, see containsHashed().
+ * 
+ * @param hash hashKey<K>(key, getSeed())
+ * @param key 
+ * @param args the arguments of the value's constructor
+ * @return std::pair<exposed_value*, bool> the value of the key and whether it was inserted
+ */
+std::pair<typename BucketedHashMap<K,V,Traits>::exposed_value*, bool> BucketedHashMap<K,V,Traits>::tryEmplaceHashed(size_t hash, KK &&key, Args &&...args) {
+    this->prepareInsert(hash);
+    std::pair<MapNode<K,V>*, bool> res = this->table[this->indexOf(hash)].tryEmplace(hash, std::forward<KK>(key), std::forward<Args>(args)...);
+    if (res.second) {
+        this->valueIndex.add(res.first);
+        fingerprintLinked(this->table[this->indexOf(hash)], hash);
+    }
+    this->size += res.second;
+    return std::pair<exposed_value*, bool>(&res.first->value, res.second);
+}
+
+template <class K, class V, class Traits>
+template <class KK, class VV>
+/**
+ * @brief Inserts the key-value pair, or assigns the value to the existing key.
+ * Rvalue keys and values are moved into the map rather than copied.
+ * 
+ * @param key 
+ * @param value 
+ * @return std::pair<exposed_value*, bool> the value of the key and whether it was inserted
+ */
+std::pair<typename BucketedHashMap<K,V,Traits>::exposed_value*, bool> BucketedHashMap<K,V,Traits>::insertOrAssign(KK &&key, VV &&value) {
+    size_t hash = this->hashOf(key);
+    return this->insertOrAssignHashed(hash, std::forward<KK>(key), std::forward<VV>(value));
+}
+
+template <class K, class V, class Traits>
+template <class KK, class VV>
+/**
+ * @brief insertOrAssign() for a caller that already hashed the key under
+ * the seed of the map, see containsHashed().
+ * 
+ * @param hash hashKey<K>(key, getSeed())
+ * @param key 
+ * @param value 
+ * @return std::pair<exposed_value*, bool> the value of the key and whether it was inserted
+ */
+std::pair<typename BucketedHashMap<K,V,Traits>::exposed_value*, bool> BucketedHashMap<K,V,Traits>::insertOrAssignHashed(size_t hash, KK &&key, VV &&value) {
+    this->prepareInsert(hash);
+    std::pair<MapNode<K,V>*, bool> res = this->assignInBucket(this->table[this->indexOf(hash)], hash, std::forward<KK>(key), std::forward<VV>(value));
+    this->size += res.second;
+    return std::pair<exposed_value*, bool>(&res.first->value, res.second);
+}
+
+template <class K, class V, class Traits>
+template <class KK, class VV>
+/**
+ * @brief Inserts or assigns count key-value pairs, in order. Like lookups in
+ * getMany, the keys of a chunk are hashed first and their buckets and first
+ * nodes prefetched ahead of the insert, so the misses overlap. A reHash in
+ * the middle of the batch only costs the prefetches issued before it.
+ * 
+ * @param entries 
+ * @param count 
+ * @return size_t the number of keys that were not present yet
+ */
+size_t BucketedHashMap<K,V,Traits>::insertMany(const std::pair<KK, VV> *entries, size_t count) {
+    size_t inserted = 0;
+    size_t hashes[kBatchChunk];
+    for (size_t base = 0; base < count; base += kBatchChunk) {
+        size_t n = count - base < kBatchChunk ? count - base : kBatchChunk;
+        for (size_t i = 0; i < n; i++) {
+            hashes[i] = this->hashOf(entries[base + i].first);
+            prefetch(&this->table[this->indexOf(hashes[i])]);
+        }
+        for (size_t i = 0; i < n && i < kPrefetchDistance; i++) {
+            prefetch(this->table[this->indexOf(hashes[i])].begin());
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (i + kPrefetchDistance < n) {
+                prefetch(this->table[this->indexOf(hashes[i + kPrefetchDistance])].begin());
+            }
+            this->prepareInsert(hashes[i]);
+            std::pair<MapNode<K,V>*, bool> res = this->assignInBucket(this->table[this->indexOf(hashes[i])], hashes[i], entries[base + i].first, entries[base + i].second);
+            this->size += res.second;
+            inserted += res.second;
+        }
+    }
+    return inserted;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief removes the given key and value node from the map
+ * 
+ * @param key 
+ * @return V 
+ */
+V BucketedHashMap<K,V,Traits>::remove(const K &key) {
+    return this->removeHashed(key, this->hashOf(key));
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief remove() for a caller that already hashed the key under the seed of
+ * the map, see containsHashed().
+ * 
+ * @param key 
+ * @param hash hashKey<K>(key, getSeed())
+ * @return V 
+ * @throws std::invalid_argument if the key is not found.
+ */
+V BucketedHashMap<K,V,Traits>::removeHashed(const K &key, size_t hash) {
+    if (this->isReHashing()) {
+        this->migrateBucket(this->oldIndexOf(hash));
+        this->migrate(this->migrationBudget);
+    }
+    MapNode<K, V> *n = this->table[this->indexOf(hash)].unlink(key, hash);
+    if (!n) {
+        throw std::invalid_argument("No key found.");
+    }
+    fingerprintUnlinked(this->table[this->indexOf(hash)]);
+    this->valueIndex.remove(n);
+    V res = std::move(n->value);
+    this->pool->destroy(n);
+    this->size--;
+    if ((double)this->size / (double)this->capacity < this->shrinkThreshold) {
+        size_t buckets = this->fittedCapacity(this->size, (this->shrinkThreshold + this->loadFactorThreshold) / 2);
+        if (buckets < this->capacity) {
+            this->resize(buckets);
+        }
+    }
+    return res;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief returns the size of the map
+ * 
+ * @return int 
+ */
+int BucketedHashMap<K,V,Traits>::getSize() const {
+    return this->size;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief returns all entries in the map in a vector
+ * 
+ * @return std::vector<MapNode<K,V>> 
+ */
+std::vector<MapNode<K,V>> BucketedHashMap<K,V,Traits>::getEntries() const {
+    std::vector<MapNode<K,V>> res = std::vector<MapNode<K,V>>();
+    res.reserve(this->size);
+    for (const_iterator it = this->begin(); it != this->end(); ++it) {
+        res.push_back(MapNode<K,V>(it->key, it->value));
+    }
+    return res;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief returns all keys in the map in a vector
+ * 
+ * @return std::vector<K> 
+ */
+std::vector<K> BucketedHashMap<K,V,Traits>::getKeys() const{
+    std::vector<K> res = std::vector<K>();
+    res.reserve(this->size);
+    for (const_iterator it = this->begin(); it != this->end(); ++it) {
+        res.push_back(it->key);
+    }
+    return res;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief returns all values in the map in a vector
+ * 
+ * @return std::vector<V> 
+ */
+std::vector<V> BucketedHashMap<K,V,Traits>::getValues() const{
+    std::vector<V> res = std::vector<V>();
+    res.reserve(this->size);
+    for (const_iterator it = this->begin(); it != this->end(); ++it) {
+        res.push_back(it->value);
+    }
+    return res;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief returns an iterator to the first entry. A full traversal costs O(n)
+ * anyway, so an incremental reHash still in progress is finished first and
+ * the iterator only has to walk one table.
+ * 
+ * @return iterator 
+ */
+typename BucketedHashMap<K,V,Traits>::iterator BucketedHashMap<K,V,Traits>::begin() {
+    this->migrate(this->oldTable.size());
+    return iterator(&this->table, 0);
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief returns the past-the-end iterator
+ * 
+ * @return iterator 
+ */
+typename BucketedHashMap<K,V,Traits>::iterator BucketedHashMap<K,V,Traits>::end() {
+    return iterator();
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief returns a const iterator to the first entry, see begin()
+ * 
+ * @return const_iterator 
+ */
+typename BucketedHashMap<K,V,Traits>::const_iterator BucketedHashMap<K,V,Traits>::begin() const {
+    this->migrate(this->oldTable.size());
+    return const_iterator(&this->table, 0);
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief returns the past-the-end const iterator
+ * 
+ * @return const_iterator 
+ */
+typename BucketedHashMap<K,V,Traits>::const_iterator BucketedHashMap<K,V,Traits>::end() const {
+    return const_iterator();
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief returns a const iterator to the first entry, see begin()
+ * 
+ * @return const_iterator 
+ */
+typename BucketedHashMap<K,V,Traits>::const_iterator BucketedHashMap<K,V,Traits>::cbegin() const {
+    return this->begin();
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief returns the past-the-end const iterator
+ * 
+ * @return const_iterator 
+ */
+typename BucketedHashMap<K,V,Traits>::const_iterator BucketedHashMap<K,V,Traits>::cend() const {
+    return this->end();
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief prints the map
+ * 
+ */
+void BucketedHashMap<K,V,Traits>::show() const{
+    std::cout << *this;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief returns an ostream representation of the map
+ * 
+ * @param o 
+ * @param bHM 
+ * @return std::ostream& 
+ */
+std::ostream& operator<<(std::ostream& o, const BucketedHashMap<K,V,Traits> & bHM) {
+    o << "Bucketed Hash Map Entries: [ " << std::endl;
+    int i = 0;
+    for (typename BucketedHashMap<K,V,Traits>::const_iterator it = bHM.begin(); it != bHM.end(); ++it) {
+        o << "    " << "{K: " << it->key << ", V: " << it->value << "}";
+        if (++i < bHM.getSize()) {
+            o << ",";
+        }
+        o << std::endl;
+    }
+    o << "]" << std::endl;
+    return o;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief prints the list + structure
+ * 
+ */
+void BucketedHashMap<K,V,Traits>::showStructure() const{
+    std::cout << "Bucketed Hash Map Structure: < " << std::endl;
+    for (int i = 0; i < this->capacity; i++) {
+        std::cout << "    Bucket at index " << i << ": ";
+        this->table[i].show();
+        std::cout << std::endl;
+    }
+    for (size_t i = this->migrateIndex; i < this->oldTable.size(); i++) {
+        std::cout << "    Old bucket at index " << i << ": ";
+        this->oldTable[i].show();
+        std::cout << std::endl;
+    }
+    std::cout << ">" << std::endl;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Returns the structure of the map: its chain-length histogram, load,
+ * memory use and lifetime counters. Walks every bucket once, so it costs
+ * O(buckets) and prints nothing.
+ * 
+ * @return BucketedHashMapStats 
+ */
+BucketedHashMapStats BucketedHashMap<K,V,Traits>::stats() const {
+    BucketedHashMapStats res = BucketedHashMapStats();
+    res.buckets = this->table.size() + this->oldTable.size() - this->migrateIndex;
+    res.size = this->size;
+    res.loadFactor = (double)this->size / (double)res.buckets;
+    res.emptyBuckets = 0;
+    res.maxChainLength = 0;
+    res.treeifiedBuckets = 0;
+    res.chainLengths = std::vector<size_t>(1, 0);
+    for (int pass = 0; pass < 2; pass++) {
+        const std::vector<KVList<K, V>> &t = pass == 0 ? this->table : this->oldTable;
+        for (size_t i = pass == 0 ? 0 : this->migrateIndex; i < t.size(); i++) {
+            size_t length = (size_t)t[i].getSize();
+            if (length >= res.chainLengths.size()) {
+                res.chainLengths.resize(length + 1, 0);
+            }
+            res.chainLengths[length]++;
+            if (length > res.maxChainLength) {
+                res.maxChainLength = length;
+            }
+            if (t[i].isTreeified()) {
+                res.treeifiedBuckets++;
+            }
+        }
+    }
+    res.emptyBuckets = res.chainLengths[0];
+    res.tableBytes = (this->table.capacity() + this->oldTable.capacity()) * sizeof(KVList<K, V>);
+    res.nodeBytes = this->pool->getSlabBytes();
+    res.reHashes = this->reHashes;
+    res.reHashNanos = this->reHashNanos;
+    res.nodesAllocated = this->pool->getCreated();
+    res.nodesFreed = this->pool->getDestroyed();
+    return res;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Writes every entry to a snapshot file (see SnapshotHeader) that a
+ * MappedBucketedHashMap serves lookups from without rebuilding the map. The
+ * entries are laid out in their own power of two table at a load of at most
+ * 1, whatever the capacity and policy of this map, and streamed out bucket by
+ * bucket, so besides the file only two pointers per entry are allocated.
+ * K and V must be trivially copyable or std::string.
+ * 
+ * @param path 
+ * @throws std::invalid_argument if the file cannot be written.
+ */
+void BucketedHashMap<K,V,Traits>::saveSnapshot(const std::string &path) const {
+    std::vector<const MapNode<K, V> *> nodes = std::vector<const MapNode<K, V> *>();
+    nodes.reserve(this->size);
+    for (int pass = 0; pass < 2; pass++) {
+        const std::vector<KVList<K, V>> &t = pass == 0 ? this->table : this->oldTable;
+        for (size_t i = pass == 0 ? 0 : this->migrateIndex; i < t.size(); i++) {
+            for (const MapNode<K, V> *tmp = t[i].begin(); tmp; tmp = tmp->next) {
+                nodes.push_back(tmp);
+            }
+        }
+    }
+    size_t buckets = PowerOfTwoCapacity::roundCapacity(nodes.empty() ? 1 : nodes.size());
+    std::vector<uint64_t> offsets = std::vector<uint64_t>(buckets + 1, 0);
+    std::vector<size_t> starts = std::vector<size_t>(buckets + 1, 0);
+    for (size_t i = 0; i < nodes.size(); i++) {
+        size_t b = PowerOfTwoCapacity::indexOf(nodes[i]->hash, buckets);
+        offsets[b + 1] += 8 + SnapshotCodec<K>::bytes(nodes[i]->key) + SnapshotCodec<V>::bytes(nodes[i]->value);
+        starts[b + 1]++;
+    }
+    for (size_t b = 0; b < buckets; b++) {
+        offsets[b + 1] += offsets[b];
+        starts[b + 1] += starts[b];
+    }
+    std::vector<const MapNode<K, V> *> ordered = std::vector<const MapNode<K, V> *>(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        ordered[starts[PowerOfTwoCapacity::indexOf(nodes[i]->hash, buckets)]++] = nodes[i];
+    }
+    nodes = std::vector<const MapNode<K, V> *>();
+    SnapshotHeader header = SnapshotHeader();
+    std::memcpy(header.magic, kSnapshotMagic, 8);
+    header.version = kSnapshotVersion;
+    header.keyKind = SnapshotCodec<K>::kind;
+    header.keySize = SnapshotCodec<K>::width;
+    header.valueKind = SnapshotCodec<V>::kind;
+    header.valueSize = SnapshotCodec<V>::width;
+    header.seed = this->seed;
+    header.buckets = buckets;
+    header.entries = ordered.size();
+    header.bodyBytes = (buckets + 1) * 8 + offsets[buckets];
+    std::ofstream out = std::ofstream(path, std::ios::binary | std::ios::trunc);
+    out.write((const char *)&header, sizeof(header));
+    SnapshotChecksum checksum = SnapshotChecksum();
+    checksum.add((const char *)offsets.data(), (buckets + 1) * 8);
+    out.write((const char *)offsets.data(), (buckets + 1) * 8);
+    std::vector<char> buffer = std::vector<char>(1 << 20);
+    size_t used = 0;
+    for (size_t i = 0; i < ordered.size() && out; i++) {
+        size_t keyBytes = SnapshotCodec<K>::bytes(ordered[i]->key);
+        size_t bytes = 8 + keyBytes + SnapshotCodec<V>::bytes(ordered[i]->value);
+        if (used + bytes > buffer.size()) {
+            checksum.add(buffer.data(), used);
+            out.write(buffer.data(), used);
+            used = 0;
+            if (bytes > buffer.size()) {
+                buffer.resize(bytes);
+            }
+        }
+        char *entry = buffer.data() + used;
+        std::memset(entry, 0, bytes);
+        uint64_t hash = ordered[i]->hash;
+        std::memcpy(entry, &hash, 8);
+        SnapshotCodec<K>::write(entry + 8, ordered[i]->key);
+        SnapshotCodec<V>::write(entry + 8 + keyBytes, ordered[i]->value);
+        used += bytes;
+    }
+    checksum.add(buffer.data(), used);
+    out.write(buffer.data(), used);
+    header.checksum = checksum.state;
+    out.seekp(0);
+    out.write((const char *)&header, sizeof(header));
+    out.close();
+    if (!out) {
+        throw std::invalid_argument("Could not write snapshot to " + path);
+    }
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Returns an immutable copy of the map indexed by a minimal perfect
+ * hash function, see FrozenBucketedHashMap. The cached hashes are reused, so
+ * keys are only hashed again in the unlikely case that the seed of this map
+ * gives two of them the same 64 bit hash.
+ * 
+ * @return FrozenBucketedHashMap<K,V> 
+ * @throws std::invalid_argument if keys have an equal BucketedHash.
+ */
+FrozenBucketedHashMap<K,V> BucketedHashMap<K,V,Traits>::freeze() const {
+    this->migrate(this->oldTable.size());
+    std::vector<const MapNode<K, V> *> nodes = std::vector<const MapNode<K, V> *>();
+    nodes.reserve(this->size);
+    for (size_t i = 0; i < this->table.size(); i++) {
+        for (const MapNode<K, V> *tmp = this->table[i].begin(); tmp; tmp = tmp->next) {
+            nodes.push_back(tmp);
+        }
+    }
+    return FrozenBucketedHashMap<K, V>(nodes, this->seed);
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief rehashes and resizes the hashmap. Existing nodes are unlinked from
+ * their old bucket and spliced into the new one, so no entry is copied or
+ * reallocated and references to values stay valid.
+ * 
+ */
+void BucketedHashMap<K,V,Traits>::reHash() {
+    this->resize(this->grownCapacity());
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Moves every node into a table of the given number of buckets, as
+ * rounded by the capacity policy, relinking them like reHash().
+ * 
+ * @param buckets 
+ */
+void BucketedHashMap<K,V,Traits>::resize(size_t buckets) {
+    std::chrono::steady_clock::time_point start = this->reHashClock();
+    this->finishReHash();
+    if (this->reHashThreads > 1 && this->size >= kParallelReHashMin) {
+        this->parallelReHash(this->reHashThreads, buckets);
+    } else {
+        this->startReHash(buckets);
+        this->finishReHash();
+    }
+    this->recordReHash(start);
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Returns the capacity after a reHash: the current one times the
+ * growth factor, as rounded by the capacity policy, and always larger.
+ * 
+ * @return size_t 
+ */
+size_t BucketedHashMap<K,V,Traits>::grownCapacity() const {
+    size_t res = (size_t)std::ceil((double)this->capacity * this->growthFactor);
+    return Traits::CapacityPolicy::roundCapacity(res > this->capacity ? res : this->capacity + 1);
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Returns the capacity, as rounded by the capacity policy, holding
+ * entries at no more than the given load.
+ * 
+ * @param entries 
+ * @param load 
+ * @return size_t 
+ */
+size_t BucketedHashMap<K,V,Traits>::fittedCapacity(size_t entries, double load) const {
+    size_t res = (size_t)std::ceil((double)entries / load);
+    return Traits::CapacityPolicy::roundCapacity(res > 0 ? res : 1);
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Sizes the table so that n entries fit under loadFactorThreshold,
+ * so inserting up to n entries never triggers a reHash. Never shrinks.
+ * 
+ * @param n 
+ */
+void BucketedHashMap<K,V,Traits>::reserve(size_t n) {
+    size_t buckets = this->fittedCapacity(n, this->loadFactorThreshold);
+    if (buckets > this->capacity) {
+        this->resize(buckets);
+    }
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Shrinks the table to the fewest buckets holding the current entries
+ * under loadFactorThreshold. Nodes keep their address, so the node slabs of
+ * the pool are kept for reuse and only the bucket vector is given back.
+ * 
+ */
+void BucketedHashMap<K,V,Traits>::shrinkToFit() {
+    size_t buckets = this->fittedCapacity(this->size, this->loadFactorThreshold);
+    if (buckets < this->capacity) {
+        this->resize(buckets);
+    }
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Returns the time a reHash starts at, or a zero time point without
+ * reading the clock when Traits::collectStats is off.
+ * 
+ * @return std::chrono::steady_clock::time_point 
+ */
+std::chrono::steady_clock::time_point BucketedHashMap<K,V,Traits>::reHashClock() const {
+    if constexpr (Traits::collectStats) {
+        return std::chrono::steady_clock::now();
+    }
+    return std::chrono::steady_clock::time_point();
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Counts a finished growth of the table and the time it took, when
+ * Traits::collectStats is on.
+ * 
+ * @param start 
+ */
+void BucketedHashMap<K,V,Traits>::recordReHash(std::chrono::steady_clock::time_point start) {
+    if constexpr (Traits::collectStats) {
+        this->reHashes++;
+        this->reHashNanos += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Grows the table with several threads, partitioned like assign():
+ * each worker unlinks the nodes of a range of old buckets and sorts them by
+ * the range of new buckets they belong to, then each worker splices the
+ * nodes of one new bucket range, so no two threads touch the same KVList.
+ * 
+ * @param threads 
+ */
+void BucketedHashMap<K,V,Traits>::parallelReHash(unsigned int threads, size_t buckets) {
+    std::vector<KVList<K, V>> old = std::move(this->table);
+    this->capacity = buckets;
+    this->table = this->newTable(this->capacity);
+    std::vector<std::vector<MapNode<K, V>*>> parts = std::vector<std::vector<MapNode<K, V>*>>(threads * threads);
+    parallelFor(threads, old.size(), [&](unsigned int t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            MapNode<K, V> *tmp = old[i].release();
+            while (tmp) {
+                parts[t * threads + (size_t)this->indexOf(tmp->hash) * threads / this->capacity].push_back(tmp);
+                tmp = tmp->next;
+            }
+        }
+    });
+    parallelFor(threads, threads, [&](unsigned int, size_t begin, size_t end) {
+        for (size_t p = begin; p < end; p++) {
+            for (size_t t = 0; t < threads; t++) {
+                std::vector<MapNode<K, V>*> &part = parts[t * threads + p];
+                for (size_t j = 0; j < part.size(); j++) {
+                    linkNode(this->table[this->indexOf(part[j]->hash)], part[j]);
+                }
+            }
+        }
+    });
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Grows the table and keeps the previous one around as oldTable,
+ * whose buckets are then moved over by migrate().
+ * 
+ */
+void BucketedHashMap<K,V,Traits>::startReHash(size_t buckets) {
+    this->oldTable = std::move(this->table);
+    this->capacity = buckets;
+    this->table = this->newTable(this->capacity);
+    this->migrateIndex = 0;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Splices every node of the given oldTable bucket into its bucket in
+ * the new table, using the hash cached in the node.
+ * 
+ * @param i 
+ */
+void BucketedHashMap<K,V,Traits>::migrateBucket(size_t i) const {
+    MapNode<K, V> *tmp = this->oldTable[i].release();
+    while (tmp) {
+        MapNode<K, V> *next = tmp->next;
+        linkNode(this->table[this->indexOf(tmp->hash)], tmp);
+        tmp = next;
+    }
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Moves up to the given number of oldTable buckets into the new table,
+ * dropping oldTable once every bucket has been moved. Does nothing when no
+ * reHash is in progress.
+ * 
+ * @param buckets 
+ */
+void BucketedHashMap<K,V,Traits>::migrate(size_t buckets) const {
+    if (!this->isReHashing()) {
+        return;
+    }
+    while (buckets > 0 && this->migrateIndex < this->oldTable.size()) {
+        this->migrateBucket(this->migrateIndex);
+        this->migrateIndex++;
+        buckets--;
+    }
+    if (this->migrateIndex == this->oldTable.size()) {
+        this->oldTable = std::vector<KVList<K, V>>();
+        this->migrateIndex = 0;
+    }
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Sets how many old buckets every insert, get, containsKey and remove
+ * migrates while a reHash is in progress. 0, the default, turns incremental
+ * reHashing off and resizes the whole table inside the insert that crosses the
+ * load factor threshold.
+ * Since const lookups then write to the table, a map shared by several
+ * threads must not call them concurrently while isReHashing() is true.
+ * 
+ * @param bucketsPerOp 
+ */
+void BucketedHashMap<K,V,Traits>::setIncrementalReHash(size_t bucketsPerOp) {
+    this->migrationBudget = bucketsPerOp;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Sets how many threads a full reHash of at least kParallelReHashMin
+ * entries uses, including the calling one. 1, the default, keeps every
+ * reHash on the calling thread.
+ * 
+ * @param threads 
+ */
+void BucketedHashMap<K,V,Traits>::setReHashThreads(unsigned int threads) {
+    this->reHashThreads = threads < 1 ? 1 : threads;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Sets how much a reHash multiplies the capacity by, before rounding
+ * by the capacity policy. The default is 2.
+ * 
+ * @param factor 
+ * @throws std::invalid_argument if factor is not above 1, or too large for
+ * the shrink threshold, see setShrinkThreshold().
+ */
+void BucketedHashMap<K,V,Traits>::setGrowthFactor(double factor) {
+    if (factor <= 1.0) {
+        throw std::invalid_argument("Growth factor must be greater than 1.0!");
+    }
+    if (this->shrinkThreshold * factor * 2 > this->loadFactorThreshold) {
+        throw std::invalid_argument("Growth factor is too large for the shrink threshold!");
+    }
+    this->growthFactor = factor;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Turns on shrinking on remove: once the load drops below threshold
+ * the table shrinks to sit halfway between threshold and
+ * loadFactorThreshold. threshold must stay at or below
+ * loadFactorThreshold / (2 * growth factor), a quarter by default, so the
+ * load right after any grow or shrink stays strictly between the two and
+ * alternating inserts and removes cannot resize back and forth. 0, the
+ * default, never shrinks.
+ * 
+ * @param threshold 
+ * @throws std::invalid_argument if threshold is out of range.
+ */
+void BucketedHashMap<K,V,Traits>::setShrinkThreshold(double threshold) {
+    if (threshold < 0.0 || threshold * this->growthFactor * 2 > this->loadFactorThreshold) {
+        throw std::invalid_argument("Shrink threshold must be between 0 and loadFactorThreshold / (2 * growth factor)!");
+    }
+    this->shrinkThreshold = threshold;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Returns whether an incremental reHash is still migrating buckets.
+ * 
+ * @return true 
+ * @return false 
+ */
+bool BucketedHashMap<K,V,Traits>::isReHashing() const {
+    return !this->oldTable.empty();
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Migrates every remaining bucket of an in-progress incremental reHash.
+ * 
+ */
+void BucketedHashMap<K,V,Traits>::finishReHash() {
+    this->migrate(this->oldTable.size());
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Returns the seed every hash of the map is mixed with.
+ * 
+ * @return uint64_t 
+ */
+uint64_t BucketedHashMap<K,V,Traits>::getSeed() const {
+    return this->seed;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Replaces the random seed drawn at construction, e.g. to make a
+ * test reproducible, and rehashes every entry under the new one. Nodes are
+ * relinked, not copied, so references to values stay valid.
+ * 
+ * @param seed 
+ */
+void BucketedHashMap<K,V,Traits>::setSeed(uint64_t seed) {
+    this->finishReHash();
+    this->seed = seed;
+    std::vector<KVList<K, V>> old = this->newTable(this->capacity);
+    std::swap(old, this->table);
+    for (size_t i = 0; i < old.size(); i++) {
+        MapNode<K, V> *tmp = old[i].release();
+        while (tmp) {
+            MapNode<K, V> *next = tmp->next;
+            tmp->hash = this->hashOf(tmp->key);
+            linkNode(this->table[this->indexOf(tmp->hash)], tmp);
+            tmp = next;
+        }
     }
 }
 
-#endif
\ No newline at end of file
+#endif
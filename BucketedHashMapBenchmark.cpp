@@ -0,0 +1,1051 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string_view>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BucketedHashMap.hpp"
+#include "HashMapEngine.hpp"
+#include "MappedBucketedHashMap.hpp"
+#include "ShardedBucketedHashMap.hpp"
+#include "StaticBucketedHashMap.hpp"
+#include "UnrolledBucketedHashMap.hpp"
+#include "ZipfDistribution.hpp"
+
+static volatile size_t sink = 0;
+
+template <class F>
+/**
+ * @brief Runs fn once and returns the elapsed time in nanoseconds per operation.
+ *
+ * @param ops the number of operations fn performs
+ * @param fn
+ * @return double
+ */
+double nsPerOp(size_t ops, F fn) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / ops;
+}
+
+/**
+ * @brief Returns count string keys that all start with the same long prefix,
+ * like URLs or fully qualified names.
+ *
+ * @param count
+ * @param tag
+ * @return std::vector<std::string>
+ */
+std::vector<std::string> sharedPrefixKeys(size_t count, const std::string &tag) {
+    std::string prefix = "https://service.example.com/api/v2/tenants/acme/resources/" + tag + "/";
+    std::vector<std::string> res = std::vector<std::string>();
+    for (size_t i = 0; i < count; i++) {
+        res.push_back(prefix + std::to_string(i));
+    }
+    return res;
+}
+
+/**
+ * @brief Walks one 8 node chain of shared prefix keys, once comparing the
+ * cached hashes before the keys and once comparing only the keys, which is
+ * what every chain walk did before nodes cached their hash.
+ *
+ */
+void benchSharedPrefixChain() {
+    const size_t rounds = 200000;
+    std::vector<std::string> keys = sharedPrefixKeys(8, "hit");
+    std::vector<std::string> misses = sharedPrefixKeys(8, "mis");
+    std::vector<size_t> hashes = std::vector<size_t>();
+    std::vector<size_t> missHashes = std::vector<size_t>();
+    KVList<std::string, int> list = KVList<std::string, int>();
+    for (size_t i = 0; i < keys.size(); i++) {
+        list.update(keys[i], (int)i);
+        hashes.push_back(std::hash<std::string>()(keys[i]));
+        missHashes.push_back(std::hash<std::string>()(misses[i]));
+    }
+    double keyOnlyHit = nsPerOp(rounds * keys.size(), [&]() {
+        for (size_t r = 0; r < rounds; r++) {
+            for (size_t i = 0; i < keys.size(); i++) {
+                for (MapNode<std::string, int> *tmp = list.begin(); tmp; tmp = tmp->next) {
+                    if (keys[i] == tmp->key) {
+                        sink += tmp->value;
+                        break;
+                    }
+                }
+            }
+        }
+    });
+    double hashedHit = nsPerOp(rounds * keys.size(), [&]() {
+        for (size_t r = 0; r < rounds; r++) {
+            for (size_t i = 0; i < keys.size(); i++) {
+                sink += list.find(keys[i], hashes[i])->value;
+            }
+        }
+    });
+    double keyOnlyMiss = nsPerOp(rounds * misses.size(), [&]() {
+        for (size_t r = 0; r < rounds; r++) {
+            for (size_t i = 0; i < misses.size(); i++) {
+                for (MapNode<std::string, int> *tmp = list.begin(); tmp; tmp = tmp->next) {
+                    sink += misses[i] == tmp->key;
+                }
+            }
+        }
+    });
+    double hashedMiss = nsPerOp(rounds * misses.size(), [&]() {
+        for (size_t r = 0; r < rounds; r++) {
+            for (size_t i = 0; i < misses.size(); i++) {
+                sink += list.find(misses[i], missHashes[i]) != nullptr;
+            }
+        }
+    });
+    std::cout << "8 node chain, shared prefix keys (ns per lookup):" << std::endl;
+    std::cout << "    hit:  key compare only " << keyOnlyHit << ", hash first " << hashedHit << std::endl;
+    std::cout << "    miss: key compare only " << keyOnlyMiss << ", hash first " << hashedMiss << std::endl;
+}
+
+/**
+ * @brief Times inserts, lookups and an explicit reHash of a map of shared
+ * prefix keys. reHash only reads the hash cached in every node.
+ *
+ */
+void benchSharedPrefixMap() {
+    const size_t n = 500000;
+    std::vector<std::string> keys = sharedPrefixKeys(n, "map");
+    BucketedHashMap<std::string, int> bHM = BucketedHashMap<std::string, int>(16, 1.0);
+    double insert = nsPerOp(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            bHM.insert(keys[i], (int)i);
+        }
+    });
+    double get = nsPerOp(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            sink += bHM.get(keys[i]);
+        }
+    });
+    double reHash = nsPerOp(n, [&]() {
+        bHM.reHash();
+    });
+    std::cout << n << " shared prefix keys (ns per entry):" << std::endl;
+    std::cout << "    insert " << insert << ", get " << get << ", reHash " << reHash << std::endl;
+}
+
+/**
+ * @brief A move-only value owning a heap buffer, standing in for large
+ * values that should never be deep copied on insert.
+ */
+struct Buffer {
+    std::unique_ptr<char[]> bytes;
+    size_t length;
+    explicit Buffer(size_t n) : bytes(new char[n]()), length(n) {}
+};
+
+/**
+ * @brief Times filling a map with large values through insert (copies),
+ * insertOrAssign with an rvalue (moves) and tryEmplace (constructs in place),
+ * and with the move-only Buffer through insertOrAssign and tryEmplace.
+ *
+ */
+void benchMoveSemantics() {
+    const size_t n = 100000;
+    const size_t width = 256;
+    std::vector<int> keys = std::vector<int>();
+    for (size_t i = 0; i < n; i++) {
+        keys.push_back((int)i);
+    }
+    double copyInsert = nsPerOp(n, [&]() {
+        BucketedHashMap<int, std::vector<double>> bHM = BucketedHashMap<int, std::vector<double>>((int)n);
+        for (size_t i = 0; i < n; i++) {
+            std::vector<double> value = std::vector<double>(width, 1.0);
+            bHM.insert(keys[i], value);
+        }
+        sink += bHM.getSize();
+    });
+    double moveInsert = nsPerOp(n, [&]() {
+        BucketedHashMap<int, std::vector<double>> bHM = BucketedHashMap<int, std::vector<double>>((int)n);
+        for (size_t i = 0; i < n; i++) {
+            std::vector<double> value = std::vector<double>(width, 1.0);
+            bHM.insertOrAssign(keys[i], std::move(value));
+        }
+        sink += bHM.getSize();
+    });
+    double emplaceInsert = nsPerOp(n, [&]() {
+        BucketedHashMap<int, std::vector<double>> bHM = BucketedHashMap<int, std::vector<double>>((int)n);
+        for (size_t i = 0; i < n; i++) {
+            bHM.tryEmplace(keys[i], width, 1.0);
+        }
+        sink += bHM.getSize();
+    });
+    double moveOnlyAssign = nsPerOp(n, [&]() {
+        BucketedHashMap<int, Buffer> bHM = BucketedHashMap<int, Buffer>((int)n);
+        for (size_t i = 0; i < n; i++) {
+            bHM.insertOrAssign(keys[i], Buffer(width * sizeof(double)));
+        }
+        sink += bHM.getSize();
+    });
+    double moveOnlyEmplace = nsPerOp(n, [&]() {
+        BucketedHashMap<int, Buffer> bHM = BucketedHashMap<int, Buffer>((int)n);
+        for (size_t i = 0; i < n; i++) {
+            bHM.tryEmplace(keys[i], width * sizeof(double));
+        }
+        sink += bHM.getSize();
+    });
+    std::cout << n << " inserts of " << width << " doubles (ns per insert):" << std::endl;
+    std::cout << "    std::vector<double>: insert " << copyInsert << ", insertOrAssign(move) " << moveInsert << ", tryEmplace " << emplaceInsert << std::endl;
+    std::cout << "    move-only Buffer: insertOrAssign(move) " << moveOnlyAssign << ", tryEmplace " << moveOnlyEmplace << std::endl;
+}
+
+/**
+ * @brief Times looking up and inserting n random int keys in batches of 256
+ * through getMany, containsMany and insertMany against a loop of single
+ * get and insert calls. Past the size of the last level cache every single
+ * lookup waits for its bucket and then for its first node in turn, which
+ * the batched calls overlap with prefetches.
+ *
+ * @param n
+ */
+void benchBatched(size_t n) {
+    const size_t batch = 256;
+    std::mt19937_64 rng = std::mt19937_64(42);
+    std::vector<std::pair<int, int>> entries = std::vector<std::pair<int, int>>();
+    std::vector<int> probes = std::vector<int>();
+    for (size_t i = 0; i < n; i++) {
+        entries.push_back(std::pair<int, int>((int)i, (int)i));
+    }
+    std::shuffle(entries.begin(), entries.end(), rng);
+    for (size_t i = 0; i < n; i++) {
+        probes.push_back((int)(rng() % n));
+    }
+    BucketedHashMap<int, int> single = BucketedHashMap<int, int>((int)n);
+    BucketedHashMap<int, int> batched = BucketedHashMap<int, int>((int)n);
+    double insert = nsPerOp(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            single.insert(entries[i].first, entries[i].second);
+        }
+    });
+    double insertMany = nsPerOp(n, [&]() {
+        for (size_t i = 0; i < n; i += batch) {
+            batched.insertMany(&entries[i], std::min(batch, n - i));
+        }
+    });
+    double get = nsPerOp(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            sink += single.get(probes[i]);
+        }
+    });
+    std::vector<int *> values = std::vector<int *>(batch);
+    double getMany = nsPerOp(n, [&]() {
+        for (size_t i = 0; i < n; i += batch) {
+            size_t count = std::min(batch, n - i);
+            batched.getMany(&probes[i], count, values.data());
+            for (size_t j = 0; j < count; j++) {
+                sink += *values[j];
+            }
+        }
+    });
+    std::unique_ptr<bool[]> found = std::unique_ptr<bool[]>(new bool[batch]);
+    double containsMany = nsPerOp(n, [&]() {
+        for (size_t i = 0; i < n; i += batch) {
+            sink += batched.containsMany(&probes[i], std::min(batch, n - i), found.get());
+        }
+    });
+    std::cout << n << " random int keys, batches of " << batch << " (ns per key):" << std::endl;
+    std::cout << "    insert " << insert << ", insertMany " << insertMany << std::endl;
+    std::cout << "    get " << get << ", getMany " << getMany << ", containsMany " << containsMany << std::endl;
+}
+
+/**
+ * @brief Runs threads workers, each doing opsPerThread random operations of
+ * which readPercent are gets and the rest inserts, on a 2^20 key space, and
+ * returns the throughput in million operations per second.
+ *
+ * @param threads
+ * @param opsPerThread
+ * @param readPercent
+ * @param get
+ * @param insert
+ * @return double
+ */
+template <class G, class I>
+double mixedThroughput(size_t threads, size_t opsPerThread, unsigned int readPercent, G get, I insert) {
+    std::vector<std::thread> workers = std::vector<std::thread>();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < threads; t++) {
+        workers.push_back(std::thread([=]() {
+            std::mt19937_64 rng = std::mt19937_64(t + 1);
+            size_t hits = 0;
+            for (size_t i = 0; i < opsPerThread; i++) {
+                uint64_t r = rng();
+                int key = (int)(r & ((1 << 20) - 1));
+                if ((r >> 32) % 100 < readPercent) {
+                    hits += get(key);
+                } else {
+                    insert(key);
+                }
+            }
+            sink += hits;
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    return threads * opsPerThread / std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+/**
+ * @brief Compares one BucketedHashMap behind a single mutex with a
+ * ShardedBucketedHashMap at growing thread counts and read ratios. The
+ * threads only scale on a machine with as many cores.
+ *
+ */
+void benchSharded() {
+    const size_t ops = 500000;
+    const unsigned int readPercents[] = {100, 90, 50};
+    const size_t threadCounts[] = {1, 2, 4, 8, 16, 32};
+    std::cout << "mixed get/insert throughput, 2^20 keys (Mops/s, global mutex vs 64 shards):" << std::endl;
+    for (unsigned int readPercent : readPercents) {
+        for (size_t threads : threadCounts) {
+            BucketedHashMap<int, int> locked = BucketedHashMap<int, int>(1 << 20);
+            std::mutex lock;
+            ShardedBucketedHashMap<int, int> sharded = ShardedBucketedHashMap<int, int>(64);
+            for (int i = 0; i < (1 << 20); i += 2) {
+                locked.insert(i, i);
+                sharded.insert(i, i);
+            }
+            double global = mixedThroughput(threads, ops, readPercent, [&](int key) {
+                std::lock_guard<std::mutex> guard(lock);
+                return locked.contains(key);
+            }, [&](int key) {
+                std::lock_guard<std::mutex> guard(lock);
+                locked.insert(key, key);
+            });
+            double shard = mixedThroughput(threads, ops, readPercent, [&](int key) {
+                int value = 0;
+                return sharded.get(key, value);
+            }, [&](int key) {
+                sharded.insert(key, key);
+            });
+            std::cout << "    " << readPercent << "% reads, " << threads << " threads: " << global << " vs " << shard << std::endl;
+        }
+    }
+}
+
+/**
+ * @brief Times building a map of n pairs at startup, one insert at a time
+ * with every reHash doubling on the way, against one assign() at 1, 4 and 16
+ * threads, and a reHash of the result at the same thread counts. Threads only
+ * speed things up on a machine with as many cores.
+ *
+ * @param n
+ */
+void benchBulkBuild(size_t n) {
+    const unsigned int threadCounts[] = {1, 4, 16};
+    std::vector<std::pair<int, int>> entries = std::vector<std::pair<int, int>>();
+    for (size_t i = 0; i < n; i++) {
+        entries.push_back(std::pair<int, int>((int)(i * 2654435761u), (int)i));
+    }
+    double sequential = nsPerOp(1, [&]() {
+        BucketedHashMap<int, int> bHM = BucketedHashMap<int, int>();
+        for (size_t i = 0; i < n; i++) {
+            bHM.insert(entries[i].first, entries[i].second);
+        }
+        sink += bHM.getSize();
+    });
+    std::cout << n << " pairs, startup build (ms, and speedup over sequential insert or a 1 thread reHash): sequential insert " << sequential / 1e6 << std::endl;
+    double serialReHash = 0;
+    for (unsigned int threads : threadCounts) {
+        BucketedHashMap<int, int> bHM = BucketedHashMap<int, int>();
+        double assign = nsPerOp(1, [&]() {
+            bHM.assign(entries.begin(), entries.end(), threads);
+        });
+        bHM.setReHashThreads(threads);
+        double reHash = nsPerOp(1, [&]() {
+            bHM.reHash();
+        });
+        if (threads == 1) {
+            serialReHash = reHash;
+        }
+        std::cout << "    " << threads << " threads: assign " << assign / 1e6 << " (" << sequential / assign << "x), reHash "
+            << reHash / 1e6 << " (" << serialReHash / reHash << "x)" << std::endl;
+    }
+}
+
+template <class Map, class K>
+/**
+ * @brief Times inserting keys into an empty map, then looking every key up
+ * in a shuffled order and looking up as many missing keys.
+ *
+ * @param keys
+ * @param misses
+ * @param insert
+ * @param hit
+ * @param miss
+ */
+void timeEngine(const std::vector<K> &keys, const std::vector<K> &misses, double &insert, double &hit, double &miss) {
+    std::vector<K> probes = keys;
+    std::shuffle(probes.begin(), probes.end(), std::mt19937_64(7));
+    Map map = Map();
+    insert = nsPerOp(keys.size(), [&]() {
+        for (size_t i = 0; i < keys.size(); i++) {
+            map.insert(keys[i], (int)i);
+        }
+    });
+    hit = nsPerOp(probes.size(), [&]() {
+        for (size_t i = 0; i < probes.size(); i++) {
+            sink += map.get(probes[i]);
+        }
+    });
+    miss = nsPerOp(misses.size(), [&]() {
+        for (size_t i = 0; i < misses.size(); i++) {
+            sink += map.containsKey(misses[i]);
+        }
+    });
+}
+
+/**
+ * @brief Compares the KVList chains of BucketedHashMap with the inline
+ * buckets of UnrolledBucketedHashMap on n int keys and n string keys.
+ *
+ * @param n
+ */
+void benchUnrolled(size_t n) {
+    std::vector<int> ints = std::vector<int>();
+    std::vector<int> intMisses = std::vector<int>();
+    std::vector<std::string> strings = sharedPrefixKeys(n, "hit");
+    std::vector<std::string> stringMisses = sharedPrefixKeys(n, "mis");
+    for (size_t i = 0; i < n; i++) {
+        ints.push_back((int)(i * 2654435761u));
+        intMisses.push_back((int)((i + n) * 2654435761u));
+    }
+    double insert, hit, miss;
+    std::cout << n << " keys, KVList chains vs unrolled buckets (ns per op):" << std::endl;
+    timeEngine<BucketedHashMap<int, int>>(ints, intMisses, insert, hit, miss);
+    std::cout << "    int    KVList:   insert " << insert << ", hit " << hit << ", miss " << miss << std::endl;
+    timeEngine<UnrolledBucketedHashMap<int, int>>(ints, intMisses, insert, hit, miss);
+    std::cout << "    int    unrolled: insert " << insert << ", hit " << hit << ", miss " << miss << std::endl;
+    timeEngine<BucketedHashMap<std::string, int>>(strings, stringMisses, insert, hit, miss);
+    std::cout << "    string KVList:   insert " << insert << ", hit " << hit << ", miss " << miss << std::endl;
+    timeEngine<UnrolledBucketedHashMap<std::string, int>>(strings, stringMisses, insert, hit, miss);
+    std::cout << "    string unrolled: insert " << insert << ", hit " << hit << ", miss " << miss << std::endl;
+}
+
+/**
+ * @brief A/B compares the chained and flat engines through EngineHashMap on
+ * n int keys and n string keys.
+ *
+ * @param n
+ */
+void benchFlat(size_t n) {
+    std::vector<int> ints = std::vector<int>();
+    std::vector<int> intMisses = std::vector<int>();
+    std::vector<std::string> strings = sharedPrefixKeys(n, "hit");
+    std::vector<std::string> stringMisses = sharedPrefixKeys(n, "mis");
+    for (size_t i = 0; i < n; i++) {
+        ints.push_back((int)(i * 2654435761u));
+        intMisses.push_back((int)((i + n) * 2654435761u));
+    }
+    double insert, hit, miss;
+    std::cout << n << " keys, chained vs flat engine (ns per op):" << std::endl;
+    timeEngine<EngineHashMap<int, int, ChainedEngine>>(ints, intMisses, insert, hit, miss);
+    std::cout << "    int    chained: insert " << insert << ", hit " << hit << ", miss " << miss << std::endl;
+    timeEngine<EngineHashMap<int, int, FlatEngine>>(ints, intMisses, insert, hit, miss);
+    std::cout << "    int    flat:    insert " << insert << ", hit " << hit << ", miss " << miss << std::endl;
+    timeEngine<EngineHashMap<std::string, int, ChainedEngine>>(strings, stringMisses, insert, hit, miss);
+    std::cout << "    string chained: insert " << insert << ", hit " << hit << ", miss " << miss << std::endl;
+    timeEngine<EngineHashMap<std::string, int, FlatEngine>>(strings, stringMisses, insert, hit, miss);
+    std::cout << "    string flat:    insert " << insert << ", hit " << hit << ", miss " << miss << std::endl;
+}
+
+/**
+ * @brief BucketedHashMap options reordering chains by move-to-front.
+ */
+struct MoveToFrontTraits : BucketedHashMapTraits {
+    typedef MoveToFront ReorderPolicy;
+};
+
+/**
+ * @brief BucketedHashMap options keeping a value index.
+ */
+struct IndexedValuesTraits : BucketedHashMapTraits {
+    static const bool indexValues = true;
+};
+
+/**
+ * @brief BucketedHashMap options filtering lookups by bucket fingerprints.
+ */
+struct FilteredTraits : BucketedHashMapTraits {
+    static const bool filterBuckets = true;
+};
+
+/**
+ * @brief BucketedHashMap options reordering chains by transposition.
+ */
+struct TransposeTraits : BucketedHashMapTraits {
+    typedef Transpose ReorderPolicy;
+};
+
+template <class Policy>
+/**
+ * @brief Spreads the keys [0, n) over chains KVLists in a random order, then
+ * looks up the keys of ranks through the reorder policy and returns the
+ * average number of nodes visited per lookup.
+ *
+ * @param n
+ * @param chains
+ * @param ranks
+ * @return double
+ */
+double nodesVisited(size_t n, size_t chains, const std::vector<int> &ranks) {
+    std::vector<int> order = std::vector<int>();
+    for (size_t i = 0; i < n; i++) {
+        order.push_back((int)i);
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937_64(11));
+    std::vector<KVList<int, int>> lists = std::vector<KVList<int, int>>(chains);
+    for (size_t i = 0; i < n; i++) {
+        lists[order[i] % chains].update(order[i], order[i]);
+    }
+    size_t visited = 0;
+    for (size_t i = 0; i < ranks.size(); i++) {
+        KVList<int, int> &list = lists[ranks[i] % chains];
+        for (MapNode<int, int> *tmp = list.begin(); tmp; tmp = tmp->next) {
+            visited++;
+            if (tmp->key == ranks[i]) {
+                break;
+            }
+        }
+        sink += list.findAndPromote<Policy>(ranks[i], BucketedHash<int>()(ranks[i]))->value;
+    }
+    return (double)visited / ranks.size();
+}
+
+template <class Traits>
+/**
+ * @brief Inserts the keys [0, n) in a random order into a map and times
+ * getting the keys of ranks.
+ *
+ * @param n
+ * @param lFT
+ * @param ranks
+ * @return double ns per get
+ */
+double timeZipfGets(size_t n, double lFT, const std::vector<int> &ranks) {
+    std::vector<int> order = std::vector<int>();
+    for (size_t i = 0; i < n; i++) {
+        order.push_back((int)i);
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937_64(11));
+    BucketedHashMap<int, int, Traits> bHM = BucketedHashMap<int, int, Traits>(lFT);
+    for (size_t i = 0; i < n; i++) {
+        bHM.insert(order[i], order[i]);
+    }
+    return nsPerOp(ranks.size(), [&]() {
+        for (size_t i = 0; i < ranks.size(); i++) {
+            sink += bHM.get(ranks[i]);
+        }
+    });
+}
+
+/**
+ * @brief Compares the reorder policies under Zipfian key popularity: the
+ * average number of nodes visited per lookup on chains of a fixed length,
+ * and the time per get of maps at the highest load factor threshold allowed,
+ * where chains are at their longest.
+ *
+ * @param skew the Zipf exponent
+ */
+void benchReorder(double skew) {
+    const size_t chains = 1024;
+    const size_t chainLength = 8;
+    const size_t n = 1 << 20;
+    const size_t lookups = 1 << 22;
+    std::mt19937_64 rng = std::mt19937_64(5);
+    ZipfDistribution chainRanks = ZipfDistribution(chains * chainLength, skew);
+    ZipfDistribution mapRanks = ZipfDistribution(n, skew);
+    std::vector<int> chainLookups = std::vector<int>();
+    std::vector<int> mapLookups = std::vector<int>();
+    for (size_t i = 0; i < lookups; i++) {
+        chainLookups.push_back((int)chainRanks(rng) - 1);
+        mapLookups.push_back((int)mapRanks(rng) - 1);
+    }
+    std::cout << "Zipf " << skew << ", " << chains << " chains of " << chainLength << ", nodes visited per lookup:" << std::endl;
+    std::cout << "    none " << nodesVisited<NoReorder>(chains * chainLength, chains, chainLookups);
+    std::cout << ", move to front " << nodesVisited<MoveToFront>(chains * chainLength, chains, chainLookups);
+    std::cout << ", transpose " << nodesVisited<Transpose>(chains * chainLength, chains, chainLookups) << std::endl;
+    std::cout << "Zipf " << skew << ", " << n << " keys at load factor 1, ns per get:" << std::endl;
+    std::cout << "    none " << timeZipfGets<BucketedHashMapTraits>(n, 1.0, mapLookups);
+    std::cout << ", move to front " << timeZipfGets<MoveToFrontTraits>(n, 1.0, mapLookups);
+    std::cout << ", transpose " << timeZipfGets<TransposeTraits>(n, 1.0, mapLookups) << std::endl;
+}
+
+/**
+ * @brief A key whose every instance has the same BucketedHash, as an
+ * attacker gets from a hash function they know, ordered by operator< so
+ * that treeified buckets can search it in O(log n).
+ */
+struct CollidingKey {
+    uint64_t id;
+    bool operator==(const CollidingKey &other) const { return this->id == other.id; }
+    bool operator<(const CollidingKey &other) const { return this->id < other.id; }
+};
+
+/**
+ * @brief A key colliding like CollidingKey without operator<, so equal hashes
+ * can only be told apart one by one, as in an untreeified chain.
+ */
+struct OpaqueCollidingKey {
+    uint64_t id;
+    bool operator==(const OpaqueCollidingKey &other) const { return this->id == other.id; }
+};
+
+template <>
+struct BucketedHash<CollidingKey> {
+    size_t operator()(const CollidingKey &) const { return 0; }
+};
+
+template <>
+struct BucketedHash<OpaqueCollidingKey> {
+    size_t operator()(const OpaqueCollidingKey &) const { return 0; }
+};
+
+template <class K>
+/**
+ * @brief Times inserting n colliding keys and getting each of them back.
+ *
+ * @param n
+ * @param insert
+ * @param get
+ */
+void timeCollisions(size_t n, double &insert, double &get) {
+    BucketedHashMap<K, int> bHM = BucketedHashMap<K, int>();
+    insert = nsPerOp(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            bHM.insert(K{i}, (int)i);
+        }
+    });
+    get = nsPerOp(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            sink += bHM.get(K{i});
+        }
+    });
+}
+
+/**
+ * @brief Hash flooding. First, n uint64_t keys chosen so that every one of
+ * them falls into bucket 0 of an unseeded table (their products with the
+ * Fibonacci multiplier are 0, 1, 2, ..., so their top bits are all 0): the
+ * chain they would form is compared with the longest chain of the seeded map.
+ * Then keys with fully colliding hashes, which no seed can spread, in
+ * growing numbers: ordered keys are searched in treeified buckets, opaque
+ * keys one by one.
+ *
+ * @param n
+ */
+void benchAdversarial(size_t n) {
+    uint64_t inverse = 0x9E3779B97F4A7C15ULL;
+    for (int i = 0; i < 5; i++) {
+        inverse *= 2 - 0x9E3779B97F4A7C15ULL * inverse;
+    }
+    std::vector<uint64_t> keys = std::vector<uint64_t>();
+    for (size_t i = 0; i < n; i++) {
+        keys.push_back((uint64_t)i * inverse);
+    }
+    BucketedHashMap<uint64_t, int> bHM = BucketedHashMap<uint64_t, int>();
+    double insert = nsPerOp(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            bHM.insert(keys[i], (int)i);
+        }
+    });
+    double get = nsPerOp(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            sink += bHM.get(keys[i]);
+        }
+    });
+    BucketedHashMapStats stats = bHM.stats();
+    size_t unseeded = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (PowerOfTwoCapacity::indexOf(BucketedHash<uint64_t>()(keys[i]), stats.buckets) == 0) {
+            unseeded++;
+        }
+    }
+    std::cout << n << " keys crafted for bucket 0: unseeded chain " << unseeded << ", seeded max chain " << stats.maxChainLength;
+    std::cout << " (insert " << insert << " ns, get " << get << " ns)" << std::endl;
+    std::cout << "Keys of equal hash (ns per insert / get):" << std::endl;
+    for (size_t count = 1000; count <= 16000; count *= 4) {
+        double treeInsert, treeGet, opaqueInsert, opaqueGet;
+        timeCollisions<CollidingKey>(count, treeInsert, treeGet);
+        timeCollisions<OpaqueCollidingKey>(count, opaqueInsert, opaqueGet);
+        std::cout << "    " << count << ": treeified " << treeInsert << " / " << treeGet;
+        std::cout << ", opaque " << opaqueInsert << " / " << opaqueGet << std::endl;
+    }
+}
+
+/**
+ * @brief Compares starting up from n string pairs by inserting them into a
+ * new map against opening a snapshot of the same map, which maps the file
+ * and builds nothing, then times gets on both.
+ *
+ * @param n
+ */
+void benchSnapshot(size_t n) {
+    const std::string path = "bench.snapshot";
+    std::vector<std::string> keys = std::vector<std::string>();
+    for (size_t i = 0; i < n; i++) {
+        keys.push_back("key-" + std::to_string(i * 2654435761u));
+    }
+    BucketedHashMap<std::string, uint64_t> built = BucketedHashMap<std::string, uint64_t>();
+    double build = nsPerOp(1, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            built.insert(keys[i], i);
+        }
+    });
+    double save = nsPerOp(1, [&]() {
+        built.saveSnapshot(path);
+    });
+    double open = nsPerOp(1, [&]() {
+        MappedBucketedHashMap<std::string, uint64_t> mapped = MappedBucketedHashMap<std::string, uint64_t>(path, false);
+        sink += mapped.getSize();
+    });
+    double openVerified = nsPerOp(1, [&]() {
+        MappedBucketedHashMap<std::string, uint64_t> mapped = MappedBucketedHashMap<std::string, uint64_t>(path);
+        sink += mapped.getSize();
+    });
+    MappedBucketedHashMap<std::string, uint64_t> mapped = MappedBucketedHashMap<std::string, uint64_t>(path, false);
+    double builtGet = nsPerOp(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            sink += built.get(keys[i]);
+        }
+    });
+    double mappedGet = nsPerOp(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            sink += mapped.get(keys[i]);
+        }
+    });
+    std::remove(path.c_str());
+    std::cout << n << " string pairs, startup (ms): insert " << build / 1e6 << ", saveSnapshot " << save / 1e6;
+    std::cout << ", open snapshot " << open / 1e6 << " (" << openVerified / 1e6 << " with checksum)" << std::endl;
+    std::cout << "    ns per get: built " << builtGet << ", mapped " << mappedGet << std::endl;
+}
+
+template <class K>
+/**
+ * @brief Freezes a map of the given keys and prints the build times, the
+ * bits per key of the perfect hash function and the ns per get of both maps.
+ *
+ * @param label
+ * @param keys
+ */
+void timeFreeze(const std::string &label, const std::vector<K> &keys) {
+    size_t n = keys.size();
+    BucketedHashMap<K, uint64_t> bHM = BucketedHashMap<K, uint64_t>();
+    double build = nsPerOp(1, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            bHM.insert(keys[i], i);
+        }
+    });
+    FrozenBucketedHashMap<K, uint64_t> frozen;
+    double freeze = nsPerOp(1, [&]() {
+        frozen = bHM.freeze();
+    });
+    std::vector<K> shuffled = keys;
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937_64(7));
+    double get = nsPerOp(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            sink += bHM.get(shuffled[i]);
+        }
+    });
+    double frozenGet = nsPerOp(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            sink += frozen.get(shuffled[i]);
+        }
+    });
+    std::cout << "    " << label << ": insert " << build / 1e6 << " ms, freeze " << freeze / 1e6 << " ms, ";
+    std::cout << frozen.hashFunctionBytes() * 8.0 / n << " bits per key; ns per get " << get << " mutable, " << frozenGet << " frozen" << std::endl;
+}
+
+/**
+ * @brief Compares a frozen map against the mutable map it was built from.
+ *
+ * @param n
+ */
+void benchFreeze(size_t n) {
+    std::vector<uint64_t> numbers = std::vector<uint64_t>();
+    std::vector<std::string> strings = std::vector<std::string>();
+    for (size_t i = 0; i < n; i++) {
+        numbers.push_back(i * 2654435761u);
+        strings.push_back("key-" + std::to_string(i * 2654435761u));
+    }
+    std::cout << n << " keys, frozen by minimal perfect hashing:" << std::endl;
+    timeFreeze("uint64_t", numbers);
+    timeFreeze("string", strings);
+}
+
+static constexpr auto kHttpHeaders = makeStaticBucketedHashMap<std::string_view, int>({
+    {"Accept", 0}, {"Accept-Charset", 1}, {"Accept-Encoding", 2}, {"Accept-Language", 3},
+    {"Authorization", 4}, {"Cache-Control", 5}, {"Connection", 6}, {"Content-Encoding", 7},
+    {"Content-Length", 8}, {"Content-Type", 9}, {"Cookie", 10}, {"Date", 11},
+    {"ETag", 12}, {"Expect", 13}, {"Expires", 14}, {"From", 15},
+    {"Host", 16}, {"If-Match", 17}, {"If-Modified-Since", 18}, {"If-None-Match", 19},
+    {"Last-Modified", 20}, {"Location", 21}, {"Origin", 22}, {"Pragma", 23},
+    {"Range", 24}, {"Referer", 25}, {"Server", 26}, {"Set-Cookie", 27},
+    {"Transfer-Encoding", 28}, {"Upgrade", 29}, {"User-Agent", 30}, {"Vary", 31}});
+
+static_assert(kHttpHeaders.getSize() == 32, "every header is in the table");
+static_assert(kHttpHeaders.get("Accept") == 0, "lookups resolve at compile time");
+static_assert(kHttpHeaders.get("Host") == 16, "lookups resolve at compile time");
+static_assert(kHttpHeaders.get("Vary") == 31, "lookups resolve at compile time");
+static_assert(!kHttpHeaders.containsKey("X-Forwarded-For"), "misses resolve at compile time");
+
+/**
+ * @brief Compares a table of HTTP header names built at runtime, as a static
+ * initializer would, with the same table as a constexpr StaticBucketedHashMap.
+ *
+ * @param rounds how many lookups of every header to time
+ */
+void benchStatic(size_t rounds) {
+    const char *names[] = {"Accept", "Accept-Charset", "Accept-Encoding", "Accept-Language",
+        "Authorization", "Cache-Control", "Connection", "Content-Encoding",
+        "Content-Length", "Content-Type", "Cookie", "Date",
+        "ETag", "Expect", "Expires", "From",
+        "Host", "If-Match", "If-Modified-Since", "If-None-Match",
+        "Last-Modified", "Location", "Origin", "Pragma",
+        "Range", "Referer", "Server", "Set-Cookie",
+        "Transfer-Encoding", "Upgrade", "User-Agent", "Vary"};
+    const size_t count = sizeof(names) / sizeof(names[0]);
+    std::unique_ptr<BucketedHashMap<std::string, int>> runtime;
+    double build = nsPerOp(1, [&]() {
+        runtime.reset(new BucketedHashMap<std::string, int>());
+        for (size_t i = 0; i < count; i++) {
+            runtime->insert(names[i], (int)i);
+        }
+    });
+    std::vector<std::string> probes = std::vector<std::string>(names, names + count);
+    double runtimeGet = nsPerOp(rounds * count, [&]() {
+        for (size_t r = 0; r < rounds; r++) {
+            for (size_t i = 0; i < count; i++) {
+                sink += runtime->get(probes[i]);
+            }
+        }
+    });
+    double staticGet = nsPerOp(rounds * count, [&]() {
+        for (size_t r = 0; r < rounds; r++) {
+            for (size_t i = 0; i < count; i++) {
+                sink += kHttpHeaders.get(probes[i]);
+            }
+        }
+    });
+    std::cout << count << " header names: runtime build " << build / 1e3 << " us, constexpr build 0 us; ";
+    std::cout << "ns per get " << runtimeGet << " runtime, " << staticGet << " constexpr" << std::endl;
+}
+
+/**
+ * @brief Times merging, subtracting and intersecting two maps of n keys that
+ * overlap by half, against merging through getEntries() and insert(), both
+ * on bucket aligned maps (a copy, so same seed and capacity) and on maps
+ * with their own seeds.
+ *
+ * @param n
+ */
+void benchSetAlgebra(size_t n) {
+    const unsigned int threadCounts[] = {1, 4};
+    BucketedHashMap<int, int> left = BucketedHashMap<int, int>();
+    BucketedHashMap<int, int> unaligned = BucketedHashMap<int, int>();
+    for (size_t i = 0; i < n; i++) {
+        left.insert((int)(i * 2654435761u), (int)i);
+        unaligned.insert((int)((i + n / 2) * 2654435761u), (int)i);
+    }
+    BucketedHashMap<int, int> aligned = left;
+    aligned.clear();
+    for (size_t i = 0; i < n; i++) {
+        aligned.insert((int)((i + n / 2) * 2654435761u), (int)i);
+    }
+    double entries = nsPerOp(1, [&]() {
+        BucketedHashMap<int, int> res = left;
+        std::vector<MapNode<int, int>> other = aligned.getEntries();
+        for (size_t i = 0; i < other.size(); i++) {
+            if (!res.containsKey(other[i].key)) {
+                res.insert(other[i].key, other[i].value);
+            }
+        }
+        sink += res.getSize();
+    });
+    double copy = nsPerOp(1, [&]() {
+        BucketedHashMap<int, int> res = left;
+        sink += res.getSize();
+    });
+    std::cout << n << " + " << n << " keys, half shared, ms excluding a " << copy / 1e6 << " ms copy:" << std::endl;
+    std::cout << "    getEntries + insert " << (entries - copy) / 1e6 << std::endl;
+    auto run = [&](const char *label, const BucketedHashMap<int, int> &right, unsigned int threads) {
+        double merge = nsPerOp(1, [&]() {
+            BucketedHashMap<int, int> res = left;
+            res.merge(right, [](const int &mine, const int &theirs) { return mine + theirs; }, threads);
+            sink += res.getSize();
+        });
+        double subtract = nsPerOp(1, [&]() {
+            BucketedHashMap<int, int> res = left;
+            res.subtract(right, threads);
+            sink += res.getSize();
+        });
+        double intersect = nsPerOp(1, [&]() {
+            BucketedHashMap<int, int> res = left;
+            res.intersect(right, threads);
+            sink += res.getSize();
+        });
+        std::cout << "    " << label << ", " << threads << " threads: merge " << (merge - copy) / 1e6;
+        std::cout << ", subtract " << (subtract - copy) / 1e6 << ", intersect " << (intersect - copy) / 1e6 << std::endl;
+    };
+    for (unsigned int threads : threadCounts) {
+        run("aligned", aligned, threads);
+    }
+    for (unsigned int threads : threadCounts) {
+        run("own seeds", unaligned, threads);
+    }
+}
+
+template <class Traits>
+/**
+ * @brief Times the write path of a map of n sessions holding values
+ * resource ids, then containsValue() on it.
+ *
+ * @param n
+ * @param values
+ * @param insert
+ * @param assign
+ * @param remove
+ * @param contains
+ */
+void timeValueIndex(size_t n, size_t values, double &insert, double &assign, double &remove, double &contains) {
+    BucketedHashMap<int, int, Traits> bHM = BucketedHashMap<int, int, Traits>();
+    insert = nsPerOp(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            bHM.insert((int)i, (int)(i * 2654435761u % values));
+        }
+    });
+    assign = nsPerOp(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            bHM.insert((int)i, (int)((i + 1) * 2654435761u % values));
+        }
+    });
+    size_t probes = Traits::indexValues ? n : 64;
+    contains = nsPerOp(probes, [&]() {
+        for (size_t i = 0; i < probes; i++) {
+            sink += bHM.containsValue((int)(i * 7 % (values * 2)));
+        }
+    });
+    remove = nsPerOp(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            sink += bHM.remove((int)i);
+        }
+    });
+}
+
+/**
+ * @brief Compares a map keeping a value index with a plain one, from 4 keys
+ * per value down to every key sharing one value.
+ *
+ * @param n
+ */
+void benchValueIndex(size_t n) {
+    size_t values[3] = {n / 4, 100, 1};
+    std::cout << n << " keys, ns per op (plain / indexed):" << std::endl;
+    for (int i = 0; i < 3; i++) {
+        double insert, assign, remove, contains;
+        double indexedInsert, indexedAssign, indexedRemove, indexedContains;
+        timeValueIndex<BucketedHashMapTraits>(n, values[i], insert, assign, remove, contains);
+        timeValueIndex<IndexedValuesTraits>(n, values[i], indexedInsert, indexedAssign, indexedRemove, indexedContains);
+        std::cout << "    " << values[i] << " values: insert " << insert << " / " << indexedInsert << ", assign " << assign << " / " << indexedAssign;
+        std::cout << ", remove " << remove << " / " << indexedRemove << ", containsValue " << contains << " / " << indexedContains << std::endl;
+    }
+}
+
+template <class Traits, class K>
+/**
+ * @brief Fills a map with keys under a load factor threshold and returns
+ * the best of three rounds of containsKey() over probes, in ns per lookup.
+ *
+ * @param keys
+ * @param probes
+ * @param loadFactor
+ * @return double
+ */
+double timeMissFilter(const std::vector<K> &keys, const std::vector<K> &probes, double loadFactor) {
+    BucketedHashMap<K, int, Traits> bHM = BucketedHashMap<K, int, Traits>(loadFactor);
+    for (size_t i = 0; i < keys.size(); i++) {
+        bHM.insert(keys[i], (int)i);
+    }
+    double best = 0;
+    for (int round = 0; round < 3; round++) {
+        double ns = nsPerOp(probes.size(), [&]() {
+            for (size_t i = 0; i < probes.size(); i++) {
+                sink += bHM.containsKey(probes[i]);
+            }
+        });
+        if (round == 0 || ns < best) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Compares plain and fingerprint filtered lookups when 70% of them
+ * miss, for int and shared prefix string keys, at the default load factor
+ * and at 1.
+ *
+ * @param n
+ */
+void benchMissFilter(size_t n) {
+    std::vector<int> ints = std::vector<int>();
+    std::vector<int> intProbes = std::vector<int>();
+    std::vector<std::string> strings = sharedPrefixKeys(n, "hit");
+    std::vector<std::string> stringMisses = sharedPrefixKeys(n, "mis");
+    std::vector<std::string> stringProbes = std::vector<std::string>();
+    std::mt19937_64 rng = std::mt19937_64(25);
+    for (size_t i = 0; i < n; i++) {
+        ints.push_back((int)(i * 2654435761u));
+    }
+    for (size_t i = 0; i < n; i++) {
+        size_t r = rng() % n;
+        bool hit = rng() % 10 < 3;
+        intProbes.push_back(hit ? ints[r] : (int)((r + n) * 2654435761u));
+        stringProbes.push_back(hit ? strings[r] : stringMisses[r]);
+    }
+    std::cout << n << " keys, 70% misses, containsKey ns per op (plain / filtered):" << std::endl;
+    double loadFactors[2] = {0.75, 1.0};
+    for (int i = 0; i < 2; i++) {
+        double plainInts = timeMissFilter<BucketedHashMapTraits>(ints, intProbes, loadFactors[i]);
+        double filteredInts = timeMissFilter<FilteredTraits>(ints, intProbes, loadFactors[i]);
+        double plainStrings = timeMissFilter<BucketedHashMapTraits>(strings, stringProbes, loadFactors[i]);
+        double filteredStrings = timeMissFilter<FilteredTraits>(strings, stringProbes, loadFactors[i]);
+        std::cout << "    load factor " << loadFactors[i] << ": int " << plainInts << " / " << filteredInts;
+        std::cout << ", string " << plainStrings << " / " << filteredStrings << std::endl;
+    }
+}
+
+int main() {
+    benchSharedPrefixChain();
+    benchSharedPrefixMap();
+    benchMoveSemantics();
+    benchBatched(1 << 16);
+    benchBatched(1 << 24);
+    benchSharded();
+    benchBulkBuild(1 << 23);
+    benchUnrolled(1 << 20);
+    benchFlat(1 << 20);
+    benchReorder(0.99);
+    benchAdversarial(1 << 20);
+    benchSnapshot(1 << 20);
+    benchFreeze(1 << 20);
+    benchStatic(1 << 16);
+    benchSetAlgebra(1 << 20);
+    benchValueIndex(1 << 20);
+    benchMissFilter(1 << 20);
+    return 0;
+}
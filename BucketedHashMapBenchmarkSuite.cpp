@@ -0,0 +1,396 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "BucketedHashMap.hpp"
+#include "ZipfDistribution.hpp"
+
+static volatile size_t sink = 0;
+
+/**
+ * @brief One measurement of the suite, written out as a CSV line or a JSON
+ * object.
+ */
+struct Result {
+    std::string map;
+    std::string key;
+    size_t size;
+    double loadFactor;
+    std::string pattern;
+    std::string op;
+    double nsPerOp;
+};
+
+/**
+ * @brief The options of a run, read from the command line.
+ */
+struct Options {
+    std::vector<size_t> sizes;
+    std::vector<std::string> keys;
+    std::vector<double> loadFactors;
+    size_t maxSize;
+    double zipfSkew;
+    std::string format;
+    std::string out;
+};
+
+template <class F>
+/**
+ * @brief Runs fn once and returns the elapsed time in nanoseconds per operation.
+ *
+ * @param ops the number of operations fn performs
+ * @param fn
+ * @return double
+ */
+double nsPerOp(size_t ops, F fn) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / (ops ? ops : 1);
+}
+
+/**
+ * @brief The splitmix64 finalizer, a bijection on 64 bit integers, used to
+ * turn indices into distinct keys that look random.
+ *
+ * @param x
+ * @return uint64_t
+ */
+uint64_t splitmix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/**
+ * @brief Returns the i-th key of a type. Distinct indices give distinct keys,
+ * so indices [0, n) are the keys in the map and [n, 2n) keys that miss.
+ *
+ * @tparam K int, uint64_t or std::string
+ * @param i
+ * @return K
+ */
+template <class K>
+K makeKey(uint64_t i);
+
+template <>
+int makeKey<int>(uint64_t i) {
+    return (int)(uint32_t)(i * 2654435761u);
+}
+
+template <>
+uint64_t makeKey<uint64_t>(uint64_t i) {
+    return splitmix64(i);
+}
+
+template <>
+std::string makeKey<std::string>(uint64_t i) {
+    return "key-" + std::to_string(splitmix64(i));
+}
+
+template <class K>
+/**
+ * @brief Adapts BucketedHashMap to the operations of the suite.
+ */
+struct BucketedAdapter {
+    BucketedHashMap<K, int> map;
+    explicit BucketedAdapter(double lFT) : map(lFT) {}
+    static const char *name() { return "BucketedHashMap"; }
+    void insert(const K &key, int value) { this->map.insert(key, value); }
+    int find(const K &key) const {
+        int *res = this->map.find(key);
+        return res ? *res : 0;
+    }
+    void remove(const K &key) { this->map.remove(key); }
+    size_t iterate() const {
+        size_t res = 0;
+        for (typename BucketedHashMap<K, int>::const_iterator it = this->map.begin(); it != this->map.end(); ++it) {
+            res += it->value;
+        }
+        return res;
+    }
+    void reHash() { this->map.reHash(); }
+};
+
+template <class K>
+/**
+ * @brief Adapts std::unordered_map to the operations of the suite, with the
+ * same maximum load factor.
+ */
+struct UnorderedAdapter {
+    std::unordered_map<K, int> map;
+    explicit UnorderedAdapter(double lFT) { this->map.max_load_factor((float)lFT); }
+    static const char *name() { return "std::unordered_map"; }
+    void insert(const K &key, int value) { this->map[key] = value; }
+    int find(const K &key) const {
+        typename std::unordered_map<K, int>::const_iterator it = this->map.find(key);
+        return it != this->map.end() ? it->second : 0;
+    }
+    void remove(const K &key) { this->map.erase(key); }
+    size_t iterate() const {
+        size_t res = 0;
+        for (typename std::unordered_map<K, int>::const_iterator it = this->map.begin(); it != this->map.end(); ++it) {
+            res += it->second;
+        }
+        return res;
+    }
+    void reHash() { this->map.rehash(this->map.bucket_count() * 2); }
+};
+
+/**
+ * @brief The inputs shared by every map and load factor of one key type and
+ * size: the keys, keys that miss, and the key indices of the uniform and
+ * Zipfian lookups.
+ */
+template <class K>
+struct Workload {
+    std::vector<K> keys;
+    std::vector<K> misses;
+    std::vector<uint32_t> uniform;
+    std::vector<uint32_t> zipf;
+    Workload(size_t n, double skew) {
+        size_t lookups = n > (1 << 20) ? n : (1 << 20);
+        std::mt19937_64 rng = std::mt19937_64(n);
+        ZipfDistribution ranks = ZipfDistribution(n, skew);
+        this->keys.reserve(n);
+        this->misses.reserve(n);
+        for (size_t i = 0; i < n; i++) {
+            this->keys.push_back(makeKey<K>(i));
+            this->misses.push_back(makeKey<K>(n + i));
+        }
+        this->uniform.reserve(lookups);
+        this->zipf.reserve(lookups);
+        for (size_t i = 0; i < lookups; i++) {
+            this->uniform.push_back((uint32_t)(rng() % n));
+            this->zipf.push_back((uint32_t)(ranks(rng) - 1));
+        }
+    }
+};
+
+template <class Map, class K>
+/**
+ * @brief Measures every operation of one map on a workload: inserting the
+ * keys into an empty map, hits under both access patterns, misses,
+ * iteration, a reHash and finally removing every key.
+ *
+ * @param w
+ * @param keyName
+ * @param lFT
+ * @param results
+ */
+void runMap(const Workload<K> &w, const std::string &keyName, double lFT, std::vector<Result> &results) {
+    size_t n = w.keys.size();
+    Map map = Map(lFT);
+    Result r = Result{Map::name(), keyName, n, lFT, "sequential", "", 0.0};
+    r.op = "insert";
+    r.nsPerOp = nsPerOp(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            map.insert(w.keys[i], (int)i);
+        }
+    });
+    results.push_back(r);
+    r.op = "hit";
+    r.pattern = "uniform";
+    r.nsPerOp = nsPerOp(w.uniform.size(), [&]() {
+        size_t sum = 0;
+        for (size_t i = 0; i < w.uniform.size(); i++) {
+            sum += map.find(w.keys[w.uniform[i]]);
+        }
+        sink += sum;
+    });
+    results.push_back(r);
+    r.pattern = "zipf";
+    r.nsPerOp = nsPerOp(w.zipf.size(), [&]() {
+        size_t sum = 0;
+        for (size_t i = 0; i < w.zipf.size(); i++) {
+            sum += map.find(w.keys[w.zipf[i]]);
+        }
+        sink += sum;
+    });
+    results.push_back(r);
+    r.op = "miss";
+    r.pattern = "uniform";
+    r.nsPerOp = nsPerOp(w.uniform.size(), [&]() {
+        size_t sum = 0;
+        for (size_t i = 0; i < w.uniform.size(); i++) {
+            sum += map.find(w.misses[w.uniform[i]]);
+        }
+        sink += sum;
+    });
+    results.push_back(r);
+    r.op = "iterate";
+    r.pattern = "sequential";
+    r.nsPerOp = nsPerOp(n, [&]() {
+        sink += map.iterate();
+    });
+    results.push_back(r);
+    r.op = "reHash";
+    r.nsPerOp = nsPerOp(n, [&]() {
+        map.reHash();
+    });
+    results.push_back(r);
+    r.op = "remove";
+    r.nsPerOp = nsPerOp(n, [&]() {
+        for (size_t i = 0; i < n; i++) {
+            map.remove(w.keys[i]);
+        }
+    });
+    results.push_back(r);
+}
+
+template <class K>
+/**
+ * @brief Runs both maps at every size and load factor for one key type.
+ *
+ * @param keyName
+ * @param options
+ * @param results
+ */
+void runKey(const std::string &keyName, const Options &options, std::vector<Result> &results) {
+    for (size_t n : options.sizes) {
+        if (n > options.maxSize) {
+            continue;
+        }
+        Workload<K> w = Workload<K>(n, options.zipfSkew);
+        for (double lFT : options.loadFactors) {
+            runMap<BucketedAdapter<K>>(w, keyName, lFT, results);
+            runMap<UnorderedAdapter<K>>(w, keyName, lFT, results);
+            std::cerr << keyName << " n=" << n << " load factor " << lFT << " done" << std::endl;
+        }
+    }
+}
+
+/**
+ * @brief Writes the results as CSV with a header line.
+ *
+ * @param o
+ * @param results
+ */
+void writeCsv(std::ostream &o, const std::vector<Result> &results) {
+    o << "map,key,size,load_factor,pattern,op,ns_per_op" << std::endl;
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        o << r.map << "," << r.key << "," << r.size << "," << r.loadFactor << "," << r.pattern << "," << r.op << "," << r.nsPerOp << std::endl;
+    }
+}
+
+/**
+ * @brief Writes the results as a JSON array of objects.
+ *
+ * @param o
+ * @param results
+ */
+void writeJson(std::ostream &o, const std::vector<Result> &results) {
+    o << "[" << std::endl;
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        o << "  {\"map\": \"" << r.map << "\", \"key\": \"" << r.key << "\", \"size\": " << r.size
+          << ", \"load_factor\": " << r.loadFactor << ", \"pattern\": \"" << r.pattern << "\", \"op\": \"" << r.op
+          << "\", \"ns_per_op\": " << r.nsPerOp << "}" << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+    o << "]" << std::endl;
+}
+
+/**
+ * @brief Splits a comma separated list.
+ *
+ * @param list
+ * @return std::vector<std::string>
+ */
+std::vector<std::string> splitList(const std::string &list) {
+    std::vector<std::string> res = std::vector<std::string>();
+    std::stringstream ss = std::stringstream(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            res.push_back(item);
+        }
+    }
+    return res;
+}
+
+/**
+ * @brief Prints the command line options.
+ *
+ */
+void usage() {
+    std::cerr << "usage: BucketedHashMapBenchmarkSuite [options]" << std::endl
+              << "  --sizes LIST          entry counts (default 1000,10000,100000,1000000,10000000,100000000)" << std::endl
+              << "  --max-size N          skip sizes above N" << std::endl
+              << "  --keys LIST           key types among int,uint64,string (default all)" << std::endl
+              << "  --load-factors LIST   loadFactorThreshold values (default 0.5,0.75,1.0)" << std::endl
+              << "  --zipf-skew S         skew of the Zipfian pattern (default 0.99)" << std::endl
+              << "  --format csv|json     output format (default csv)" << std::endl
+              << "  --out FILE            write results to FILE instead of stdout" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    Options options = Options{{1000, 10000, 100000, 1000000, 10000000, 100000000}, {"int", "uint64", "string"}, {0.5, 0.75, 1.0}, SIZE_MAX, 0.99, "csv", ""};
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--sizes") {
+            options.sizes.clear();
+            for (const std::string &s : splitList(value)) {
+                options.sizes.push_back(std::stoull(s));
+            }
+        } else if (arg == "--max-size") {
+            options.maxSize = std::stoull(value);
+        } else if (arg == "--keys") {
+            options.keys = splitList(value);
+        } else if (arg == "--load-factors") {
+            options.loadFactors.clear();
+            for (const std::string &s : splitList(value)) {
+                options.loadFactors.push_back(std::stod(s));
+            }
+        } else if (arg == "--zipf-skew") {
+            options.zipfSkew = std::stod(value);
+        } else if (arg == "--format") {
+            options.format = value;
+        } else if (arg == "--out") {
+            options.out = value;
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (options.format != "csv" && options.format != "json") {
+        usage();
+        return 1;
+    }
+    std::vector<Result> results = std::vector<Result>();
+    for (const std::string &key : options.keys) {
+        if (key == "int") {
+            runKey<int>(key, options, results);
+        } else if (key == "uint64") {
+            runKey<uint64_t>(key, options, results);
+        } else if (key == "string") {
+            runKey<std::string>(key, options, results);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    std::ofstream file;
+    if (!options.out.empty()) {
+        file.open(options.out);
+    }
+    std::ostream &o = options.out.empty() ? std::cout : file;
+    if (options.format == "json") {
+        writeJson(o, results);
+    } else {
+        writeCsv(o, results);
+    }
+    return 0;
+}
@@ -0,0 +1,196 @@
+#ifndef BUCKETED_HASH_MAP_ITERATOR_HPP
+#define BUCKETED_HASH_MAP_ITERATOR_HPP
+
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+#include "KVList.hpp"
+
+template <class K, class V>
+/**
+ * @brief What a BucketedHashMapIterator yields: references to the key and the
+ * value of one entry, in the spirit of std::pair<const K, V>. The key is
+ * always const and the value is const for a const_iterator, while the cached
+ * hash and chain link of the node stay out of reach, so iterating cannot
+ * misfile or unlink an entry.
+ *
+ * @author Jonathan Ung
+ */
+struct BucketedHashMapEntry {
+    const K &key;
+    V &value;
+};
+
+template <class K, class V, bool Const>
+/**
+ * @brief Forward iterator over every entry of a BucketedHashMap. It walks the
+ * buckets of the table in order and the MapNode chain of each bucket, and
+ * yields a BucketedHashMapEntry of each node, so no entry is ever copied.
+ * Like the map's own node pointers it stays valid across a reHash of the
+ * node it points at, but a reHash during iteration may reorder what is left.
+ *
+ * @author Jonathan Ung
+ */
+class BucketedHashMapIterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef BucketedHashMapEntry<K, typename std::conditional<Const, const V, V>::type> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef value_type reference;
+        /**
+         * @brief What operator-> returns: it holds the entry, so it->key and
+         * it->value reach through it.
+         */
+        struct pointer {
+            value_type entry;
+            const value_type *operator->() const {
+                return &this->entry;
+            }
+        };
+        BucketedHashMapIterator();
+        BucketedHashMapIterator(const std::vector<KVList<K, V>> *, size_t);
+        template <bool C, class = typename std::enable_if<Const && !C>::type>
+        BucketedHashMapIterator(const BucketedHashMapIterator<K, V, C> &);
+        reference operator*() const;
+        pointer operator->() const;
+        BucketedHashMapIterator<K, V, Const> &operator++();
+        BucketedHashMapIterator<K, V, Const> operator++(int);
+        template <class T, class U, bool A, bool B>
+        friend bool operator==(const BucketedHashMapIterator<T, U, A> &, const BucketedHashMapIterator<T, U, B> &);
+        template <class T, class U, bool A, bool B>
+        friend bool operator!=(const BucketedHashMapIterator<T, U, A> &, const BucketedHashMapIterator<T, U, B> &);
+        template <class T, class U, bool C>
+        friend class BucketedHashMapIterator;
+
+    private:
+        const std::vector<KVList<K, V>> *table;
+        size_t bucket;
+        MapNode<K, V> *node;
+        void skipEmpty();
+};
+
+template <class K, class V, bool Const>
+/**
+ * @brief Construct a new Bucketed Hash Map Iterator object equal to end()
+ *
+ */
+BucketedHashMapIterator<K,V,Const>::BucketedHashMapIterator() {
+    this->table = nullptr;
+    this->bucket = 0;
+    this->node = nullptr;
+}
+
+template <class K, class V, bool Const>
+/**
+ * @brief Construct a new Bucketed Hash Map Iterator object on the first entry
+ * at or after the given bucket.
+ *
+ * @param table
+ * @param bucket
+ */
+BucketedHashMapIterator<K,V,Const>::BucketedHashMapIterator(const std::vector<KVList<K, V>> *table, size_t bucket) {
+    this->table = table;
+    this->bucket = bucket;
+    this->node = bucket < table->size() ? (*table)[bucket].begin() : nullptr;
+    this->skipEmpty();
+}
+
+template <class K, class V, bool Const>
+template <bool C, class>
+/**
+ * @brief Converts an iterator into a const_iterator.
+ *
+ * @param other
+ */
+BucketedHashMapIterator<K,V,Const>::BucketedHashMapIterator(const BucketedHashMapIterator<K, V, C> &other) {
+    this->table = other.table;
+    this->bucket = other.bucket;
+    this->node = other.node;
+}
+
+template <class K, class V, bool Const>
+/**
+ * @brief Moves forward to the first node of the next non-empty bucket while
+ * the current bucket is exhausted.
+ *
+ */
+void BucketedHashMapIterator<K,V,Const>::skipEmpty() {
+    while (!this->node && this->table && this->bucket + 1 < this->table->size()) {
+        this->bucket++;
+        this->node = (*this->table)[this->bucket].begin();
+    }
+}
+
+template <class K, class V, bool Const>
+/**
+ * @brief Returns the key and value of the current entry.
+ *
+ * @return reference
+ */
+typename BucketedHashMapIterator<K,V,Const>::reference BucketedHashMapIterator<K,V,Const>::operator*() const {
+    return reference{this->node->key, this->node->value};
+}
+
+template <class K, class V, bool Const>
+/**
+ * @brief Gives access to the key and value of the current entry.
+ *
+ * @return pointer
+ */
+typename BucketedHashMapIterator<K,V,Const>::pointer BucketedHashMapIterator<K,V,Const>::operator->() const {
+    return pointer{**this};
+}
+
+template <class K, class V, bool Const>
+/**
+ * @brief Advances to the next entry.
+ *
+ * @return BucketedHashMapIterator<K,V,Const>&
+ */
+BucketedHashMapIterator<K,V,Const> &BucketedHashMapIterator<K,V,Const>::operator++() {
+    this->node = this->node->next;
+    this->skipEmpty();
+    return *this;
+}
+
+template <class K, class V, bool Const>
+/**
+ * @brief Advances to the next entry and returns the previous position.
+ *
+ * @return BucketedHashMapIterator<K,V,Const>
+ */
+BucketedHashMapIterator<K,V,Const> BucketedHashMapIterator<K,V,Const>::operator++(int) {
+    BucketedHashMapIterator<K,V,Const> res = *this;
+    ++*this;
+    return res;
+}
+
+template <class K, class V, bool A, bool B>
+/**
+ * @brief Two iterators are equal when they point at the same entry; every
+ * exhausted iterator equals end().
+ *
+ * @param i1
+ * @param i2
+ * @return true
+ * @return false
+ */
+bool operator==(const BucketedHashMapIterator<K,V,A> &i1, const BucketedHashMapIterator<K,V,B> &i2) {
+    return i1.node == i2.node;
+}
+
+template <class K, class V, bool A, bool B>
+/**
+ * @brief Returns whether two iterators point at different entries.
+ *
+ * @param i1
+ * @param i2
+ * @return true
+ * @return false
+ */
+bool operator!=(const BucketedHashMapIterator<K,V,A> &i1, const BucketedHashMapIterator<K,V,B> &i2) {
+    return !(i1 == i2);
+}
+
+#endif
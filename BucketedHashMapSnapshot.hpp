@@ -0,0 +1,145 @@
+#ifndef BUCKETED_HASH_MAP_SNAPSHOT_HPP
+#define BUCKETED_HASH_MAP_SNAPSHOT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+/**
+ * @brief The header at the start of a snapshot file written by
+ * BucketedHashMap::saveSnapshot() and read by MappedBucketedHashMap.
+ * The body that follows is 8 byte aligned and made of 8 byte words:
+ * buckets + 1 offsets (bucket i holds the entries from offsets[i] to
+ * offsets[i + 1], counted in bytes from the first entry), then the entries,
+ * each a hash followed by its key and value as written by SnapshotCodec.
+ * Entries are placed with PowerOfTwoCapacity and the seed of the map, so a
+ * snapshot is only readable by a build with the same BucketedHash and byte
+ * order.
+ *
+ * @param magic kSnapshotMagic
+ * @param version kSnapshotVersion
+ * @param keyKind, keySize, valueKind, valueSize the SnapshotCodec of K and V
+ * @param seed the hash seed of the map
+ * @param buckets the number of buckets, a power of two
+ * @param entries the number of entries
+ * @param bodyBytes the bytes following the header
+ * @param checksum SnapshotChecksum of the body
+ *
+ * @author Jonathan Ung
+ */
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t keyKind;
+    uint32_t keySize;
+    uint32_t valueKind;
+    uint32_t valueSize;
+    uint32_t reserved;
+    uint64_t seed;
+    uint64_t buckets;
+    uint64_t entries;
+    uint64_t bodyBytes;
+    uint64_t checksum;
+};
+
+static const char kSnapshotMagic[8] = {'B', 'H', 'M', 'S', 'N', 'A', 'P', '\0'};
+static const uint32_t kSnapshotVersion = 1;
+
+/**
+ * @brief Rounds a byte count up to a whole number of 8 byte words.
+ *
+ * @param bytes
+ * @return size_t
+ */
+inline size_t snapshotPad(size_t bytes) {
+    return (bytes + 7) & ~(size_t)7;
+}
+
+template <class T, class = void>
+/**
+ * @brief How a key or value type is laid out in a snapshot. Trivially
+ * copyable types are stored as their bytes, padded to 8, and read back in
+ * place as a const T&. fits() checks that an encoded T starting at in lies
+ * within the available bytes before skip() or read() trust it.
+ *
+ * @author Jonathan Ung
+ */
+struct SnapshotCodec {
+    static_assert(std::is_trivially_copyable<T>::value, "snapshots hold trivially copyable types or std::string");
+    static_assert(alignof(T) <= 8, "snapshot entries are only 8 byte aligned");
+    typedef const T &View;
+    static const uint32_t kind = 0;
+    static const uint32_t width = sizeof(T);
+    static size_t bytes(const T &) { return snapshotPad(sizeof(T)); }
+    static void write(char *out, const T &t) { std::memcpy(out, &t, sizeof(T)); }
+    static View read(const char *in) { return *reinterpret_cast<const T *>(in); }
+    static size_t skip(const char *) { return snapshotPad(sizeof(T)); }
+    static bool fits(const char *, size_t available) { return available >= snapshotPad(sizeof(T)); }
+};
+
+template <>
+/**
+ * @brief std::string is stored length prefixed: a 64 bit length, then the
+ * characters padded to 8, and read back in place as a std::string_view.
+ */
+struct SnapshotCodec<std::string> {
+    typedef std::string_view View;
+    static const uint32_t kind = 1;
+    static const uint32_t width = 0;
+    static size_t bytes(const std::string &s) { return 8 + snapshotPad(s.size()); }
+    static void write(char *out, const std::string &s) {
+        uint64_t length = s.size();
+        std::memcpy(out, &length, 8);
+        std::memcpy(out + 8, s.data(), s.size());
+    }
+    static View read(const char *in) {
+        uint64_t length;
+        std::memcpy(&length, in, 8);
+        return std::string_view(in + 8, (size_t)length);
+    }
+    static size_t skip(const char *in) {
+        uint64_t length;
+        std::memcpy(&length, in, 8);
+        return 8 + snapshotPad((size_t)length);
+    }
+    static bool fits(const char *in, size_t available) {
+        if (available < 8) {
+            return false;
+        }
+        uint64_t length;
+        std::memcpy(&length, in, 8);
+        return length <= available - 8 && snapshotPad((size_t)length) <= available - 8;
+    }
+};
+
+/**
+ * @brief A streaming checksum of a snapshot body, one 8 byte word at a time
+ * (an xxHash64 round per word), to detect truncated or corrupted files.
+ *
+ * @author Jonathan Ung
+ */
+struct SnapshotChecksum {
+    uint64_t state = 0x27D4EB2F165667C5ULL;
+    void add(const char *, size_t);
+};
+
+/**
+ * @brief Folds words of data into the checksum.
+ *
+ * @param data
+ * @param bytes a multiple of 8
+ */
+inline void SnapshotChecksum::add(const char *data, size_t bytes) {
+    for (size_t i = 0; i < bytes; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        this->state += word * 0xC2B2AE3D27D4EB4FULL;
+        this->state = (this->state << 31) | (this->state >> 33);
+        this->state *= 0x9E3779B185EBCA87ULL;
+    }
+}
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef BUCKETED_HASH_MAP_STATS_HPP
+#define BUCKETED_HASH_MAP_STATS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+/**
+ * @brief A snapshot of the structure of a BucketedHashMap, returned by
+ * BucketedHashMap::stats(). The structural fields are computed from the
+ * buckets when stats() is called; the lifetime counters are kept by the map
+ * and its NodePool as they go, and the reHash ones stay 0 when
+ * Traits::collectStats is false.
+ *
+ * @param buckets the number of buckets, including those of a reHash in progress
+ * @param size the number of entries
+ * @param loadFactor size / buckets, so during a reHash the old buckets not
+ * migrated yet count as well, like the entries they hold
+ * @param emptyBuckets the number of buckets holding no entry
+ * @param maxChainLength the length of the longest chain
+ * @param treeifiedBuckets the number of chains long enough to be indexed by a ChainTree
+ * @param chainLengths chainLengths[i] is the number of buckets holding i entries
+ * @param tableBytes the bytes held by the bucket vectors
+ * @param nodeBytes the bytes of node slabs held by the pool, live and free nodes alike
+ * @param reHashes the number of times the table has grown
+ * @param reHashNanos the total time spent growing the table
+ * @param nodesAllocated the number of nodes ever constructed
+ * @param nodesFreed the number of nodes ever destroyed or dropped with their slab
+ *
+ * @author Jonathan Ung
+ */
+struct BucketedHashMapStats {
+    size_t buckets;
+    size_t size;
+    double loadFactor;
+    size_t emptyBuckets;
+    size_t maxChainLength;
+    size_t treeifiedBuckets;
+    std::vector<size_t> chainLengths;
+    size_t tableBytes;
+    size_t nodeBytes;
+    size_t reHashes;
+    uint64_t reHashNanos;
+    size_t nodesAllocated;
+    size_t nodesFreed;
+};
+
+/**
+ * @brief returns an ostream representation of the stats
+ *
+ * @param o
+ * @param s
+ * @return std::ostream&
+ */
+inline std::ostream &operator<<(std::ostream &o, const BucketedHashMapStats &s) {
+    o << "Bucketed Hash Map Stats: [ " << std::endl;
+    o << "    buckets: " << s.buckets << ", size: " << s.size << ", load factor: " << s.loadFactor << std::endl;
+    o << "    empty buckets: " << s.emptyBuckets << ", max chain length: " << s.maxChainLength << ", treeified buckets: " << s.treeifiedBuckets << std::endl;
+    o << "    chain lengths:";
+    for (size_t i = 0; i < s.chainLengths.size(); i++) {
+        o << " " << i << ":" << s.chainLengths[i];
+    }
+    o << std::endl;
+    o << "    table bytes: " << s.tableBytes << ", node bytes: " << s.nodeBytes << std::endl;
+    o << "    reHashes: " << s.reHashes << ", reHash time: " << s.reHashNanos / 1000000.0 << " ms" << std::endl;
+    o << "    nodes allocated: " << s.nodesAllocated << ", nodes freed: " << s.nodesFreed << std::endl;
+    o << "]" << std::endl;
+    return o;
+}
+
+#endif
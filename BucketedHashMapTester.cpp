@@ -1,8 +1,1486 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
 #include "BucketedHashMap.hpp"
+#include "HashMapEngine.hpp"
+#include "MappedBucketedHashMap.hpp"
+#include "ReadMostlyBucketedHashMap.hpp"
+#include "ShardedBucketedHashMap.hpp"
+#include "UnrolledBucketedHashMap.hpp"
+
+/**
+ * @brief Checks that values keep their address across a reHash, since the
+ * nodes are relinked into the new table instead of being copied.
+ * 
+ * @return true 
+ * @return false 
+ */
+bool testReHashPointerStability() {
+    BucketedHashMap<int, std::string> bHM = BucketedHashMap<int, std::string>(4);
+    std::vector<std::string*> before = std::vector<std::string*>();
+    for (int i = 0; i < 4; i++) {
+        bHM.insert(i, std::to_string(i * 100));
+        before.push_back(&bHM.get(i));
+    }
+    bHM.reHash();
+    for (int i = 0; i < 4; i++) {
+        if (&bHM.get(i) != before[i] || bHM.get(i) != std::to_string(i * 100)) {
+            return false;
+        }
+    }
+    return bHM.getSize() == 4;
+}
+
+template <class K>
+/**
+ * @brief Freezes a map of the given keys, valued by position, and checks
+ * that every key returns its value, that each of misses is absent and that
+ * iteration visits every entry once.
+ * 
+ * @param keys 
+ * @param misses 
+ * @return true 
+ * @return false 
+ */
+bool freezesExactly(const std::vector<K> &keys, const std::vector<K> &misses) {
+    BucketedHashMap<K, int> map = BucketedHashMap<K, int>();
+    for (size_t i = 0; i < keys.size(); i++) {
+        map.insert(keys[i], (int)i);
+    }
+    FrozenBucketedHashMap<K, int> frozen = map.freeze();
+    if (frozen.getSize() != (int)keys.size() || frozen.isEmpty() != keys.empty()) {
+        return false;
+    }
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (!frozen.containsKey(keys[i]) || frozen.get(keys[i]) != (int)i) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < misses.size(); i++) {
+        if (frozen.containsKey(misses[i])) {
+            return false;
+        }
+    }
+    long sum = 0;
+    size_t visited = 0;
+    for (auto it = frozen.begin(); it != frozen.end(); ++it) {
+        sum += it->value;
+        visited++;
+    }
+    return visited == keys.size() && sum == (long)keys.size() * ((long)keys.size() - 1) / 2;
+}
+
+/**
+ * @brief Checks freeze() on int and string keys, and on an empty map.
+ * 
+ * @return true 
+ * @return false 
+ */
+bool testFreeze() {
+    std::vector<int> ints = std::vector<int>();
+    std::vector<int> intMisses = std::vector<int>();
+    std::vector<std::string> strings = std::vector<std::string>();
+    std::vector<std::string> stringMisses = std::vector<std::string>();
+    for (int i = 0; i < 20000; i++) {
+        ints.push_back(i * 7);
+        intMisses.push_back(i * 7 + 3);
+        strings.push_back("key/" + std::to_string(i));
+        stringMisses.push_back("miss/" + std::to_string(i));
+    }
+    return freezesExactly(ints, intMisses) && freezesExactly(strings, stringMisses)
+        && freezesExactly(std::vector<int>(), intMisses);
+}
+
+/**
+ * @brief Reads a whole file into a string.
+ * 
+ * @param path 
+ * @return std::string 
+ */
+std::string readFile(const std::string &path) {
+    std::ifstream in = std::ifstream(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+/**
+ * @brief Writes a string to a file, replacing it.
+ * 
+ * @param path 
+ * @param bytes 
+ */
+void writeFile(const std::string &path, const std::string &bytes) {
+    std::ofstream out = std::ofstream(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), (std::streamsize)bytes.size());
+}
+
+template <class K, class V>
+/**
+ * @brief Opens a snapshot, returning whether it was accepted.
+ * 
+ * @param path 
+ * @param verify 
+ * @return true 
+ * @return false 
+ */
+bool opens(const std::string &path, bool verify) {
+    try {
+        MappedBucketedHashMap<K, V> mapped = MappedBucketedHashMap<K, V>(path, verify);
+        return true;
+    } catch (const std::invalid_argument &) {
+        return false;
+    }
+}
+
+/**
+ * @brief Saves a map with string values and reads every value back through
+ * a MappedBucketedHashMap, then checks that a truncated file, a snapshot of
+ * other types, a corrupted checksum and out of range offsets are rejected,
+ * and that a corrupted string length is reported by lookups instead of read
+ * past the mapping when the checksum is skipped.
+ * 
+ * @return true 
+ * @return false 
+ */
+bool testSnapshot() {
+    const std::string path = "BucketedHashMapTester.snap";
+    const std::string broken = "BucketedHashMapTester.broken.snap";
+    BucketedHashMap<int, std::string> map = BucketedHashMap<int, std::string>();
+    for (int i = 0; i < 5000; i++) {
+        map.insert(i * 3, std::string((size_t)(i % 40), 'a' + (char)(i % 26)));
+    }
+    map.saveSnapshot(path);
+    bool ok = true;
+    {
+        MappedBucketedHashMap<int, std::string> mapped = MappedBucketedHashMap<int, std::string>(path);
+        ok = mapped.getSize() == 5000 && !mapped.containsKey(1);
+        for (int i = 0; ok && i < 5000; i++) {
+            ok = mapped.get(i * 3) == map.get(i * 3);
+        }
+    }
+    std::string bytes = readFile(path);
+    writeFile(broken, bytes.substr(0, bytes.size() / 2));
+    ok = ok && !opens<int, std::string>(broken, false);
+    ok = ok && !opens<int, int>(path, false) && !opens<long, std::string>(path, false);
+    SnapshotHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    size_t entries = sizeof(header) + (size_t)(header.buckets + 1) * 8;
+    std::string corrupted = bytes;
+    corrupted[entries] ^= 1;
+    writeFile(broken, corrupted);
+    ok = ok && !opens<int, std::string>(broken, true) && opens<int, std::string>(broken, false);
+    corrupted = bytes;
+    uint64_t far = (uint64_t)1 << 40;
+    std::memcpy(&corrupted[sizeof(header) + 8], &far, 8);
+    writeFile(broken, corrupted);
+    ok = ok && !opens<int, std::string>(broken, false);
+    corrupted = bytes;
+    std::memcpy(&corrupted[entries + 16], &far, 8);
+    writeFile(broken, corrupted);
+    if (ok) {
+        MappedBucketedHashMap<int, std::string> mapped = MappedBucketedHashMap<int, std::string>(broken, false);
+        size_t reported = 0;
+        for (int i = 0; i < 5000; i++) {
+            try {
+                ok = ok && mapped.get(i * 3) == map.get(i * 3);
+            } catch (const std::invalid_argument &) {
+                reported++;
+            }
+        }
+        ok = ok && reported > 0;
+    }
+    std::remove(path.c_str());
+    std::remove(broken.c_str());
+    return ok;
+}
+
+/**
+ * @brief Interleaves inserts, overwrites, removes and lookups with an
+ * incremental reHash migrating one bucket per operation, so most of them run
+ * while entries are split between oldTable and table, and checks each one
+ * and copies made mid-migration against a std::map.
+ * 
+ * @return true 
+ * @return false 
+ */
+bool testIncrementalReHash() {
+    BucketedHashMap<int, std::string> map = BucketedHashMap<int, std::string>(4, 0.75);
+    map.setIncrementalReHash(1);
+    std::map<int, std::string> ref = std::map<int, std::string>();
+    std::mt19937 rng = std::mt19937(5);
+    size_t migratingOps = 0;
+    for (int i = 0; i < 40000; i++) {
+        int key = (int)(rng() % 6000);
+        unsigned int op = rng() % 4;
+        bool migrating = map.isReHashing();
+        if (op < 2) {
+            map.insert(key, std::to_string(i));
+            ref[key] = std::to_string(i);
+        } else if (op == 2 && ref.count(key)) {
+            if (map.remove(key) != ref[key]) {
+                return false;
+            }
+            ref.erase(key);
+        } else if (map.containsKey(key) != (ref.count(key) != 0) || (ref.count(key) && map.get(key) != ref[key])) {
+            return false;
+        }
+        migratingOps += migrating;
+        if (map.getSize() != (int)ref.size()) {
+            return false;
+        }
+        if (i % 4000 == 0 && map.isReHashing()) {
+            BucketedHashMap<int, std::string> copy = map;
+            for (std::map<int, std::string>::iterator it = ref.begin(); it != ref.end(); ++it) {
+                if (copy.get(it->first) != it->second) {
+                    return false;
+                }
+            }
+        }
+    }
+    map.finishReHash();
+    if (map.isReHashing() || migratingOps == 0) {
+        return false;
+    }
+    for (int key = 0; key < 6000; key++) {
+        if (map.containsKey(key) != (ref.count(key) != 0) || (ref.count(key) && map.get(key) != ref[key])) {
+            return false;
+        }
+    }
+    return map.getSize() == (int)ref.size();
+}
+
+/**
+ * @brief Runs grow, shrink, grow cycles with a shrink threshold of 0.25
+ * under a load factor threshold of 1, checking after every operation that
+ * the load stays between the two, then that inserts and removes alternating
+ * at either threshold resize at most once, that reserve() sizes the table
+ * for its entries up front and that shrinkToFit() gives the fewest buckets
+ * holding them.
+ * 
+ * @return true 
+ * @return false 
+ */
+bool testShrink() {
+    BucketedHashMap<int, int> map = BucketedHashMap<int, int>(1, 1.0);
+    map.setShrinkThreshold(0.25);
+    for (int cycle = 0; cycle < 3; cycle++) {
+        for (int i = 0; i < 4096; i++) {
+            map.insert(i, i);
+            if ((double)map.getSize() / (double)map.stats().buckets > 1.0) {
+                return false;
+            }
+        }
+        for (int i = 0; i < 4096; i++) {
+            map.remove(i);
+            if (map.getSize() > 0 && (double)map.getSize() / (double)map.stats().buckets < 0.25) {
+                return false;
+            }
+        }
+        if (map.stats().buckets > 2) {
+            return false;
+        }
+    }
+    for (int i = 0; i < 1024; i++) {
+        map.insert(i, i);
+    }
+    size_t reHashes = map.stats().reHashes;
+    for (int i = 0; i < 1000; i++) {
+        map.insert(1024, 0);
+        map.remove(1024);
+    }
+    if (map.stats().reHashes > reHashes + 1) {
+        return false;
+    }
+    for (int i = 512; i < 1024; i++) {
+        map.remove(i);
+    }
+    reHashes = map.stats().reHashes;
+    for (int i = 0; i < 1000; i++) {
+        map.remove(511);
+        map.insert(511, 511);
+    }
+    if (map.stats().reHashes > reHashes + 1) {
+        return false;
+    }
+    BucketedHashMap<int, int> reserved = BucketedHashMap<int, int>(1, 1.0);
+    reserved.reserve(10000);
+    size_t buckets = reserved.stats().buckets;
+    reHashes = reserved.stats().reHashes;
+    for (int i = 0; i < 10000; i++) {
+        reserved.insert(i, i);
+    }
+    if (buckets != 16384 || reserved.stats().buckets != buckets || reserved.stats().reHashes != reHashes) {
+        return false;
+    }
+    for (int i = 1000; i < 10000; i++) {
+        reserved.remove(i);
+    }
+    if (reserved.stats().buckets != buckets) {
+        return false;
+    }
+    reserved.shrinkToFit();
+    if (reserved.stats().buckets != 1024) {
+        return false;
+    }
+    for (int i = 0; i < 1000; i++) {
+        if (reserved.get(i) != i) {
+            return false;
+        }
+    }
+    return reserved.getSize() == 1000;
+}
+
+/**
+ * @brief A key whose std::hash only takes 4 values, so that many keys share
+ * a chain whatever the seed, ordered for ChainTree.
+ */
+struct CollidingKey {
+    int id;
+    bool operator==(const CollidingKey &other) const { return this->id == other.id; }
+    bool operator<(const CollidingKey &other) const { return this->id < other.id; }
+};
+
+/**
+ * @brief A key whose std::hash is constant and which has no operator<.
+ */
+struct UnorderedKey {
+    int id;
+    bool operator==(const UnorderedKey &other) const { return this->id == other.id; }
+};
+
+/**
+ * @brief A key whose std::hash throws for negative ids.
+ */
+struct ThrowingKey {
+    int id;
+    bool operator==(const ThrowingKey &other) const { return this->id == other.id; }
+};
+
+/**
+ * @brief A value counting how many instances were constructed and how many
+ * are alive.
+ */
+struct Tracked {
+    static inline int constructed = 0;
+    static inline int live = 0;
+    int v;
+    Tracked(int v) : v(v) { constructed++; live++; }
+    Tracked(const Tracked &other) : v(other.v) { constructed++; live++; }
+    Tracked &operator=(const Tracked &other) { this->v = other.v; return *this; }
+    ~Tracked() { live--; }
+};
+
+namespace std {
+    template <>
+    struct hash<ThrowingKey> {
+        size_t operator()(const ThrowingKey &key) const {
+            if (key.id < 0) {
+                throw std::runtime_error("unhashable key");
+            }
+            return (size_t)key.id;
+        }
+    };
+    template <>
+    struct hash<CollidingKey> {
+        size_t operator()(const CollidingKey &key) const { return (size_t)(key.id % 4); }
+    };
+    template <>
+    struct hash<UnorderedKey> {
+        size_t operator()(const UnorderedKey &) const { return 7; }
+    };
+}
+
+/**
+ * @brief Checks the in-place inserts: tryEmplace() constructs nothing for a
+ * present key, emplace() destroys its node for one, insertOrAssign()
+ * reports whether it inserted, move-only values go through all of them, and
+ * a key whose hash throws leaves the map and every value as they were.
+ * 
+ * @return true 
+ * @return false 
+ */
+bool testEmplace() {
+    BucketedHashMap<int, Tracked> tracked = BucketedHashMap<int, Tracked>();
+    std::pair<Tracked*, bool> first = tracked.tryEmplace(1, 10);
+    int constructed = Tracked::constructed;
+    std::pair<Tracked*, bool> again = tracked.tryEmplace(1, 20);
+    if (!first.second || again.second || again.first != first.first || first.first->v != 10 || Tracked::constructed != constructed) {
+        return false;
+    }
+    int live = Tracked::live;
+    std::pair<Tracked*, bool> emplaced = tracked.emplace(1, 30);
+    if (emplaced.second || emplaced.first->v != 10 || Tracked::live != live || !tracked.emplace(2, 30).second) {
+        return false;
+    }
+    std::pair<Tracked*, bool> assigned = tracked.insertOrAssign(2, Tracked(40));
+    std::pair<Tracked*, bool> added = tracked.insertOrAssign(3, Tracked(50));
+    if (assigned.second || assigned.first->v != 40 || !added.second || tracked.find(3) != added.first || tracked.getSize() != 3) {
+        return false;
+    }
+    BucketedHashMap<ThrowingKey, Tracked> throwing = BucketedHashMap<ThrowingKey, Tracked>();
+    throwing.tryEmplace(ThrowingKey{1}, 1);
+    live = Tracked::live;
+    int thrown = 0;
+    try {
+        throwing.emplace(ThrowingKey{-1}, 2);
+    } catch (const std::runtime_error &) {
+        thrown++;
+    }
+    try {
+        throwing.tryEmplace(ThrowingKey{-2}, 3);
+    } catch (const std::runtime_error &) {
+        thrown++;
+    }
+    try {
+        throwing.insertOrAssign(ThrowingKey{-3}, Tracked(4));
+    } catch (const std::runtime_error &) {
+        thrown++;
+    }
+    if (thrown != 3 || Tracked::live != live || throwing.getSize() != 1 || throwing.get(ThrowingKey{1}).v != 1) {
+        return false;
+    }
+    BucketedHashMap<std::string, std::unique_ptr<int>> owners = BucketedHashMap<std::string, std::unique_ptr<int>>();
+    owners.tryEmplace(std::string("a"), new int(1));
+    owners.emplace(std::string("b"), new int(2));
+    std::unique_ptr<int> c = std::unique_ptr<int>(new int(3));
+    owners.insertOrAssign(std::string("c"), std::move(c));
+    owners.insertOrAssign(std::string("a"), std::unique_ptr<int>(new int(4)));
+    for (int i = 0; i < 1000; i++) {
+        owners.tryEmplace("key/" + std::to_string(i), new int(i));
+    }
+    std::unique_ptr<int> removed = owners.remove("b");
+    return !c && *removed == 2 && *owners.get("a") == 4 && *owners.get("c") == 3 && *owners.get("key/999") == 999
+        && owners.getSize() == 1002;
+}
+
+/**
+ * @brief BucketedHashMap options reordering chains by move-to-front.
+ */
+struct MoveToFrontTraits : BucketedHashMapTraits {
+    typedef MoveToFront ReorderPolicy;
+};
+
+template <class Policy>
+/**
+ * @brief BucketedHashMap options reordering chains by any policy.
+ */
+struct ReorderTraits : BucketedHashMapTraits {
+    typedef Policy ReorderPolicy;
+};
+
+template <class Policy>
+/**
+ * @brief Puts 6 keys in one chain and looks the last of it up repeatedly
+ * through a const reference. Every lookup must keep the entries intact, and
+ * the key must jump to the head at once under MoveToFront, climb one place
+ * per lookup under Transpose and stay put under NoReorder.
+ * 
+ * @return true 
+ * @return false 
+ */
+bool testReorder() {
+    BucketedHashMap<UnorderedKey, int, ReorderTraits<Policy>> map = BucketedHashMap<UnorderedKey, int, ReorderTraits<Policy>>(16);
+    for (int i = 0; i < 6; i++) {
+        map.insert(UnorderedKey{i}, i * 10);
+    }
+    const BucketedHashMap<UnorderedKey, int, ReorderTraits<Policy>> &view = map;
+    std::vector<int> order = std::vector<int>();
+    for (auto it = view.begin(); it != view.end(); ++it) {
+        order.push_back(it->key.id);
+    }
+    int hot = order.back();
+    for (int lookup = 1; lookup <= 6; lookup++) {
+        if (view.get(UnorderedKey{hot}) != hot * 10) {
+            return false;
+        }
+        std::vector<int> now = std::vector<int>();
+        for (auto it = view.begin(); it != view.end(); ++it) {
+            if (it->value != it->key.id * 10) {
+                return false;
+            }
+            now.push_back(it->key.id);
+        }
+        size_t expected = 5;
+        if (std::is_same<Policy, MoveToFront>::value) {
+            expected = 0;
+        } else if (std::is_same<Policy, Transpose>::value) {
+            expected = lookup >= 5 ? 0 : 5 - lookup;
+        }
+        if (now.size() != 6 || now[expected] != hot || !std::is_permutation(now.begin(), now.end(), order.begin())) {
+            return false;
+        }
+    }
+    return map.getSize() == 6;
+}
+
+/**
+ * @brief BucketedHashMap options of the original map: any bucket count,
+ * doubled on a reHash, and hash % buckets.
+ */
+struct ModuloTraits : BucketedHashMapTraits {
+    typedef ModuloCapacity CapacityPolicy;
+};
+
+/**
+ * @brief BucketedHashMap options keeping the bucket count prime.
+ */
+struct PrimeTraits : BucketedHashMapTraits {
+    typedef PrimeCapacity CapacityPolicy;
+};
+
+/**
+ * @brief BucketedHashMap options keeping a value index.
+ */
+struct IndexedValuesTraits : BucketedHashMapTraits {
+    static const bool indexValues = true;
+};
+
+/**
+ * @brief BucketedHashMap options filtering lookups by bucket fingerprints.
+ */
+struct FilteredTraits : BucketedHashMapTraits {
+    static const bool filterBuckets = true;
+};
+
+template <class Traits>
+/**
+ * @brief Checks that a map holds exactly the entries of a reference map,
+ * and with a value index that every key is also found by its value.
+ * 
+ * @param map 
+ * @param ref 
+ * @return true 
+ * @return false 
+ */
+bool sameEntries(const BucketedHashMap<int, int, Traits> &map, const std::map<int, int> &ref) {
+    if (map.getSize() != (int)ref.size()) {
+        return false;
+    }
+    for (std::map<int, int>::const_iterator it = ref.begin(); it != ref.end(); ++it) {
+        if (!map.containsKey(it->first) || map.get(it->first) != it->second) {
+            return false;
+        }
+        if constexpr (Traits::indexValues) {
+            std::vector<int> keys = map.keysForValue(it->second);
+            if (std::find(keys.begin(), keys.end(), it->first) == keys.end()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Checks the batch operations: getMany() and containsMany() on mixed
+ * hits and misses, and insertMany() on batches holding duplicate keys and
+ * crossing reHashes, both whole and incremental.
+ * 
+ * @return true 
+ * @return false 
+ */
+bool testBatch() {
+    BucketedHashMap<int, int> map = BucketedHashMap<int, int>();
+    for (int i = 0; i < 3000; i += 2) {
+        map.insert(i, -i);
+    }
+    std::vector<int> keys = std::vector<int>();
+    for (int i = 0; i < 3000; i++) {
+        keys.push_back((i * 7919) % 3000);
+    }
+    std::vector<int *> values = std::vector<int *>(keys.size());
+    bool found[3000];
+    if (map.getMany(keys.data(), keys.size(), values.data()) != 1500 || map.containsMany(keys.data(), keys.size(), found) != 1500) {
+        return false;
+    }
+    for (size_t i = 0; i < keys.size(); i++) {
+        bool hit = keys[i] % 2 == 0;
+        if (found[i] != hit || (values[i] != nullptr) != hit || (hit && (values[i] != map.find(keys[i]) || *values[i] != -keys[i]))) {
+            return false;
+        }
+    }
+    BucketedHashMap<std::string, int> strings = BucketedHashMap<std::string, int>();
+    strings.insert("a", 1);
+    std::string_view probes[] = {"a", "b"};
+    int *stringValues[2];
+    if (strings.getMany(probes, 2, stringValues) != 1 || *stringValues[0] != 1 || stringValues[1]) {
+        return false;
+    }
+    for (int incremental = 0; incremental < 2; incremental++) {
+        BucketedHashMap<int, int> batched = BucketedHashMap<int, int>(8);
+        batched.setIncrementalReHash(incremental);
+        std::map<int, int> ref = std::map<int, int>();
+        std::vector<std::pair<int, int>> entries = std::vector<std::pair<int, int>>();
+        std::mt19937 rng = std::mt19937(13);
+        for (int i = 0; i < 5000; i++) {
+            entries.push_back(std::pair<int, int>((int)(rng() % 2000), i));
+        }
+        size_t fresh = 0;
+        for (size_t i = 0; i < entries.size(); i++) {
+            fresh += ref.count(entries[i].first) == 0;
+            ref[entries[i].first] = entries[i].second;
+        }
+        size_t reHashes = batched.stats().reHashes;
+        if (batched.insertMany(entries.data(), entries.size()) != fresh || batched.stats().reHashes <= reHashes) {
+            return false;
+        }
+        if (!sameEntries(batched, ref) || batched.insertMany(entries.data(), 100) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Returns whether n is prime.
+ * 
+ * @param n 
+ * @return true 
+ * @return false 
+ */
+bool isPrime(size_t n) {
+    if (n < 2) {
+        return false;
+    }
+    for (size_t d = 2; d * d <= n; d++) {
+        if (n % d == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <class Traits>
+/**
+ * @brief Grows a map of 3 buckets through several reHashes, whole and
+ * incremental, then removes half of its keys, checking the bucket counts
+ * the capacity policy promises between reHashes and every entry against a
+ * std::map.
+ * 
+ * @return true 
+ * @return false 
+ */
+bool testCapacityPolicy() {
+    for (size_t incremental = 0; incremental < 3; incremental += 2) {
+        BucketedHashMap<int, int, Traits> map = BucketedHashMap<int, int, Traits>(3);
+        map.setIncrementalReHash(incremental);
+        std::map<int, int> ref = std::map<int, int>();
+        std::mt19937 rng = std::mt19937(17);
+        for (int i = 0; i < 5000; i++) {
+            int key = (int)(rng() % 100000);
+            map.insert(key, i);
+            ref[key] = i;
+            size_t buckets = map.stats().buckets;
+            if (!map.isReHashing() && (std::is_same<typename Traits::CapacityPolicy, PrimeCapacity>::value ? !isPrime(buckets) : buckets % 3 != 0 || ((buckets / 3) & (buckets / 3 - 1)) != 0)) {
+                return false;
+            }
+        }
+        if (map.stats().reHashes < 8 || !sameEntries(map, ref)) {
+            return false;
+        }
+        for (std::map<int, int>::iterator it = ref.begin(); it != ref.end();) {
+            if (map.remove(it->first) != it->second) {
+                return false;
+            }
+            it = ref.erase(it);
+            if (it != ref.end()) {
+                ++it;
+            }
+        }
+        map.finishReHash();
+        if (!sameEntries(map, ref)) {
+            return false;
+        }
+        for (int key = 0; key < 100000; key += 97) {
+            if (map.containsKey(key) != (ref.count(key) != 0)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Checks that a histogram of chain lengths covers buckets buckets
+ * and size entries.
+ * 
+ * @param stats 
+ * @return true 
+ * @return false 
+ */
+bool consistent(const BucketedHashMapStats &stats) {
+    size_t buckets = 0;
+    size_t entries = 0;
+    for (size_t i = 0; i < stats.chainLengths.size(); i++) {
+        buckets += stats.chainLengths[i];
+        entries += i * stats.chainLengths[i];
+    }
+    return buckets == stats.buckets && entries == stats.size && stats.emptyBuckets == stats.chainLengths[0]
+        && stats.maxChainLength + 1 == stats.chainLengths.size() && stats.loadFactor == (double)stats.size / (double)stats.buckets;
+}
+
+/**
+ * @brief Checks stats() on a known layout, keys with a constant hash piling
+ * into one chain of 16 buckets until it is treeified and back, and on a map
+ * in the middle of an incremental reHash, whose old buckets count towards
+ * the buckets, the histogram and the load factor.
+ * 
+ * @return true 
+ * @return false 
+ */
+bool testStats() {
+    BucketedHashMap<UnorderedKey, int> chain = BucketedHashMap<UnorderedKey, int>(16);
+    BucketedHashMapStats stats = chain.stats();
+    if (stats.buckets != 16 || stats.size != 0 || stats.emptyBuckets != 16 || stats.maxChainLength != 0 || stats.loadFactor != 0.0
+        || stats.chainLengths != std::vector<size_t>(1, 16) || stats.reHashes != 0 || stats.nodesAllocated != 0) {
+        return false;
+    }
+    for (int i = 0; i < 10; i++) {
+        chain.insert(UnorderedKey{i}, i);
+        stats = chain.stats();
+        if (!consistent(stats) || stats.emptyBuckets != 15 || stats.maxChainLength != (size_t)i + 1
+            || stats.treeifiedBuckets != (i >= 8 ? 1u : 0u) || stats.loadFactor != (i + 1) / 16.0) {
+            return false;
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        chain.remove(UnorderedKey{i});
+    }
+    stats = chain.stats();
+    if (!consistent(stats) || stats.maxChainLength != 7 || stats.treeifiedBuckets != 0 || stats.reHashes != 0
+        || stats.nodesAllocated != 10 || stats.nodesFreed != 3 || stats.nodeBytes == 0) {
+        return false;
+    }
+    BucketedHashMap<int, int> growing = BucketedHashMap<int, int>(4);
+    growing.setIncrementalReHash(1);
+    int inserted = 0;
+    while (!growing.isReHashing()) {
+        growing.insert(inserted, inserted);
+        inserted++;
+    }
+    stats = growing.stats();
+    if (!consistent(stats) || stats.buckets <= 8 || stats.buckets >= 12 || stats.reHashes != 1 || stats.size != (size_t)inserted) {
+        return false;
+    }
+    growing.finishReHash();
+    stats = growing.stats();
+    return consistent(stats) && stats.buckets == 8 && stats.size == (size_t)inserted;
+}
+
+/**
+ * @brief Checks that a string keyed map holds exactly the entries of ref.
+ * 
+ * @param map 
+ * @param ref 
+ * @return true 
+ * @return false 
+ */
+bool sameEntries(const BucketedHashMap<std::string, int> &map, const std::map<std::string, int> &ref) {
+    if (map.getSize() != (int)ref.size()) {
+        return false;
+    }
+    for (std::map<std::string, int>::const_iterator it = ref.begin(); it != ref.end(); ++it) {
+        const int *value = map.find(it->first);
+        if (!value || *value != it->second) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Runs two string keyed maps drawing their nodes from one small-block
+ * arena through inserts, removes, a merge, a copy, a move, an assign and a
+ * clear, then destroys them, releases the arena and uses it again.
+ * 
+ * @return true 
+ * @return false 
+ */
+bool testArena() {
+    NodeArena arena = NodeArena(4096);
+    for (int round = 0; round < 2; round++) {
+        BucketedHashMap<std::string, int> left = BucketedHashMap<std::string, int>(16, 1.0, &arena);
+        BucketedHashMap<std::string, int> right = BucketedHashMap<std::string, int>(16, 1.0, &arena);
+        std::map<std::string, int> leftRef = std::map<std::string, int>();
+        std::map<std::string, int> rightRef = std::map<std::string, int>();
+        for (int i = 0; i < 3000; i++) {
+            std::string key = "key/" + std::to_string(i);
+            if (i % 3 != 0) {
+                left.insert(key, i);
+                leftRef[key] = i;
+            }
+            if (i % 2 == 0) {
+                right.insert(key, -i);
+                rightRef[key] = -i;
+            }
+        }
+        for (int i = 0; i < 3000; i += 10) {
+            std::string key = "key/" + std::to_string(i);
+            if (leftRef.erase(key)) {
+                left.remove(key);
+            }
+        }
+        left.merge(right);
+        leftRef.insert(rightRef.begin(), rightRef.end());
+        BucketedHashMap<std::string, int> copy = left;
+        BucketedHashMap<std::string, int> moved = std::move(right);
+        if (!sameEntries(left, leftRef) || !sameEntries(copy, leftRef) || !sameEntries(moved, rightRef) || !right.isEmpty()
+            || left.stats().nodeBytes == 0) {
+            return false;
+        }
+        std::vector<std::pair<std::string, int>> entries = std::vector<std::pair<std::string, int>>(rightRef.begin(), rightRef.end());
+        left.assign(entries.begin(), entries.end());
+        moved.clear();
+        moved.insert("after clear", 1);
+        if (!sameEntries(left, rightRef) || moved.getSize() != 1 || moved.get("after clear") != 1 || !sameEntries(copy, leftRef)) {
+            return false;
+        }
+        left = copy;
+        if (!sameEntries(left, leftRef)) {
+            return false;
+        }
+    }
+    arena.release();
+    BucketedHashMap<std::string, int> reused = BucketedHashMap<std::string, int>(16, 1.0, &arena);
+    for (int i = 0; i < 1000; i++) {
+        reused.insert("key/" + std::to_string(i), i);
+    }
+    return reused.getSize() == 1000 && reused.get("key/999") == 999;
+}
+
+template <class Traits>
+/**
+ * @brief Builds maps from a range holding duplicate keys with assign() and
+ * the range constructor at 1 and 4 threads, which must match inserting the
+ * pairs in order, then reHashes a map above kParallelReHashMin entries on 4
+ * threads.
+ * 
+ * @return true 
+ * @return false 
+ */
+bool testBulkBuild() {
+    std::vector<std::pair<int, int>> entries = std::vector<std::pair<int, int>>();
+    std::map<int, int> ref = std::map<int, int>();
+    std::mt19937 rng = std::mt19937(11);
+    for (int i = 0; i < 100000; i++) {
+        int key = (int)(rng() % 60000);
+        entries.push_back(std::pair<int, int>(key, i % 1000));
+        ref[key] = i % 1000;
+    }
+    const unsigned int threadCounts[] = {1, 4};
+    for (unsigned int threads : threadCounts) {
+        BucketedHashMap<int, int, Traits> built = BucketedHashMap<int, int, Traits>(entries.begin(), entries.end(), threads);
+        BucketedHashMap<int, int, Traits> assigned = BucketedHashMap<int, int, Traits>();
+        for (int i = -100; i < 0; i++) {
+            assigned.insert(i, i);
+        }
+        assigned.assign(entries.begin(), entries.end(), threads);
+        if (!sameEntries(built, ref) || !sameEntries(assigned, ref) || assigned.containsKey(-1)) {
+            return false;
+        }
+        assigned.insert(-1, -1);
+        assigned.remove(entries[0].first);
+        if (assigned.containsKey(entries[0].first) || assigned.get(-1) != -1) {
+            return false;
+        }
+    }
+    BucketedHashMap<int, int, Traits> big = BucketedHashMap<int, int, Traits>();
+    std::map<int, int> bigRef = std::map<int, int>();
+    for (int i = 0; i < 100000; i++) {
+        big.insert(i * 3, i % 1000);
+        bigRef[i * 3] = i % 1000;
+    }
+    size_t buckets = big.stats().buckets;
+    size_t reHashes = big.stats().reHashes;
+    big.setReHashThreads(4);
+    big.reHash();
+    if (big.stats().buckets <= buckets || big.stats().reHashes != reHashes + 1 || !sameEntries(big, bigRef)) {
+        return false;
+    }
+    big.remove(0);
+    big.insert(1, 1);
+    return big.getSize() == 100000 && !big.containsKey(0) && big.get(1) == 1;
+}
+
+template <class Traits>
+/**
+ * @brief Checks merge, subtract and intersect, with and without resolvers,
+ * against a std::map, both on bucket aligned maps (other built from a copy)
+ * and on maps with their own seeds, on one and on four threads.
+ * 
+ * @return true 
+ * @return false 
+ */
+bool testSetAlgebra() {
+    std::mt19937 rng = std::mt19937(23);
+    BucketedHashMap<int, int, Traits> left = BucketedHashMap<int, int, Traits>();
+    std::map<int, int> leftRef = std::map<int, int>();
+    for (int i = 0; i < 6000; i++) {
+        int key = (int)(rng() % 12000);
+        left.insert(key, i);
+        leftRef[key] = i;
+    }
+    BucketedHashMap<int, int, Traits> aligned = left;
+    aligned.clear();
+    BucketedHashMap<int, int, Traits> unaligned = BucketedHashMap<int, int, Traits>();
+    std::map<int, int> rightRef = std::map<int, int>();
+    for (int i = 0; i < 6000; i++) {
+        int key = (int)(rng() % 12000);
+        aligned.insert(key, -i);
+        unaligned.insert(key, -i);
+        rightRef[key] = -i;
+    }
+    if (aligned.stats().buckets != left.stats().buckets) {
+        return false;
+    }
+    std::map<int, int> merged = leftRef;
+    std::map<int, int> summed = leftRef;
+    std::map<int, int> subtracted = leftRef;
+    std::map<int, int> intersected = std::map<int, int>();
+    std::map<int, int> intersectSummed = std::map<int, int>();
+    for (std::map<int, int>::iterator it = rightRef.begin(); it != rightRef.end(); ++it) {
+        merged.insert(*it);
+        summed[it->first] = leftRef.count(it->first) ? leftRef[it->first] + it->second : it->second;
+        subtracted.erase(it->first);
+        if (leftRef.count(it->first)) {
+            intersected[it->first] = leftRef[it->first];
+            intersectSummed[it->first] = leftRef[it->first] + it->second;
+        }
+    }
+    auto sum = [](const int &mine, const int &theirs) { return mine + theirs; };
+    const BucketedHashMap<int, int, Traits> *rights[2] = {&aligned, &unaligned};
+    const unsigned int threadCounts[2] = {1, 4};
+    for (int r = 0; r < 2; r++) {
+        for (int t = 0; t < 2; t++) {
+            BucketedHashMap<int, int, Traits> res = left;
+            res.merge(*rights[r], threadCounts[t]);
+            if (!sameEntries(res, merged)) {
+                return false;
+            }
+            res = left;
+            res.merge(*rights[r], sum, threadCounts[t]);
+            if (!sameEntries(res, summed)) {
+                return false;
+            }
+            res = left;
+            res.subtract(*rights[r], threadCounts[t]);
+            if (!sameEntries(res, subtracted)) {
+                return false;
+            }
+            res = left;
+            res.intersect(*rights[r], threadCounts[t]);
+            if (!sameEntries(res, intersected)) {
+                return false;
+            }
+            res = left;
+            res.intersect(*rights[r], sum, threadCounts[t]);
+            if (!sameEntries(res, intersectSummed)) {
+                return false;
+            }
+        }
+    }
+    BucketedHashMap<int, int, Traits> self = left;
+    self.subtract(self);
+    return self.isEmpty();
+}
+
+typedef BucketedHashMap<std::string, int, IndexedValuesTraits> IndexedMap;
+static_assert(std::is_const<std::remove_reference<decltype(std::declval<IndexedMap &>()["ABC"])>::type>::value, "indexed values are read only through operator[]");
+static_assert(std::is_const<std::remove_pointer<decltype(std::declval<IndexedMap &>().find("ABC"))>::type>::value, "indexed values are read only through find()");
+static_assert(std::is_same<IndexedMap::iterator, IndexedMap::const_iterator>::value, "indexed values are read only through the iterators");
+static_assert(!std::is_const<std::remove_reference<decltype(std::declval<BucketedHashMap<std::string, int> &>()["ABC"])>::type>::value, "other maps hand out writable values");
+
+/**
+ * @brief Checks that a ValueIndex drops a node under the value it was added
+ * with even if the value changed behind its back, and that an indexed map
+ * keeps its index exact through overwrites, removes and reinserts, the
+ * sequence of the demo in main().
+ * 
+ * @return true 
+ * @return false 
+ */
+bool testValueIndex() {
+    ValueIndex<std::string, int> index = ValueIndex<std::string, int>();
+    MapNode<std::string, int> a = MapNode<std::string, int>("a", 1);
+    MapNode<std::string, int> b = MapNode<std::string, int>("b", 1);
+    index.add(&a);
+    index.add(&b);
+    a.value = 2;
+    index.remove(&a);
+    if (index.keysFor(1) != std::vector<std::string>(1, "b") || index.contains(2)) {
+        return false;
+    }
+    b.value = 3;
+    index.remove(&b);
+    if (index.contains(1) || index.getValueCount() != 0) {
+        return false;
+    }
+    IndexedMap map = IndexedMap(0.5);
+    map.insert("ABC", 5);
+    map.insertOrAssign(std::string("ABC"), 3000);
+    map.insert("ABCDE", 30);
+    map.insert("neighbour", 3000);
+    if (map.containsValue(5) || map.keysForValue(3000).size() != 2) {
+        return false;
+    }
+    if (map.remove("ABC") != 3000 || map.keysForValue(3000) != std::vector<std::string>(1, "neighbour")) {
+        return false;
+    }
+    map.insert("ABC", 7);
+    map.remove("neighbour");
+    return !map.containsValue(3000) && map.keysForValue(7) == std::vector<std::string>(1, "ABC") && map.getSize() == 2;
+}
+
+template <class Key, class Traits>
+/**
+ * @brief Checks that a map holds the keys [0, live) with value id * 10 and
+ * none of [live, count).
+ * 
+ * @param map 
+ * @param live 
+ * @param count 
+ * @return true 
+ * @return false 
+ */
+bool holdsFirst(const BucketedHashMap<Key, int, Traits> &map, int live, int count) {
+    if (map.getSize() != live) {
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        const int *value = map.find(Key{i});
+        if (i < live ? !value || *value != i * 10 : value != nullptr) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <class Key, class Traits>
+/**
+ * @brief Pushes colliding keys into a few chains well past the treeify
+ * threshold, then removes them one at a time back to an empty map, checking
+ * every lookup and the size after each step, and checks that treeified
+ * chains survive a setSeed().
+ * 
+ * @return true 
+ * @return false 
+ */
+bool testTreeify() {
+    const int count = 40;
+    BucketedHashMap<Key, int, Traits> map = BucketedHashMap<Key, int, Traits>();
+    for (int i = 0; i < count; i++) {
+        map.insert(Key{i}, i * 10);
+        if (!holdsFirst(map, i + 1, count)) {
+            return false;
+        }
+    }
+    if (map.stats().treeifiedBuckets == 0) {
+        return false;
+    }
+    map.setSeed(map.getSeed() + 1);
+    if (!holdsFirst(map, count, count) || map.stats().treeifiedBuckets == 0) {
+        return false;
+    }
+    for (int i = count - 1; i >= 0; i--) {
+        map.remove(Key{i});
+        if (!holdsFirst(map, i, count)) {
+            return false;
+        }
+    }
+    return map.stats().treeifiedBuckets == 0;
+}
+
+/**
+ * @brief Runs lock-free readers against a writer that inserts, replaces and
+ * removes keys and resizes the table. Readers check that keys which are never
+ * removed are always found with their value, and that churned keys are
+ * either missing or hold one of the values written for them. Configure with
+ * -DBUCKETED_HASH_MAP_TSAN=ON to also check the read path for data races.
+ * 
+ * @return true 
+ * @return false 
+ */
+bool testReadMostlyStress() {
+    ReadMostlyBucketedHashMap<int, int> map = ReadMostlyBucketedHashMap<int, int>(16);
+    for (int i = 0; i < 1000; i++) {
+        map.insert(i, i * 2);
+    }
+    std::atomic<bool> done(false);
+    std::atomic<bool> ok(true);
+    std::vector<std::thread> readers = std::vector<std::thread>();
+    for (int t = 0; t < 3; t++) {
+        readers.push_back(std::thread([&]() {
+            while (!done.load()) {
+                for (int i = 0; i < 2000; i++) {
+                    int value = -1;
+                    bool found = map.get(i, value);
+                    if (i < 1000 ? !found || value != i * 2 : found && value != i * 2 && value != i * 3) {
+                        ok.store(false);
+                    }
+                }
+            }
+        }));
+    }
+    for (int round = 0; round < 200; round++) {
+        for (int i = 1000; i < 2000; i++) {
+            map.insert(i, i * 2);
+        }
+        for (int i = 1000; i < 2000; i += 2) {
+            map.insert(i, i * 3);
+        }
+        if (round % 20 == 0) {
+            map.reHash();
+        }
+        for (int i = 1000; i < 2000; i++) {
+            map.remove(i);
+        }
+    }
+    done.store(true);
+    for (size_t t = 0; t < readers.size(); t++) {
+        readers[t].join();
+    }
+    return ok.load() && map.getSize() == 1000;
+}
+
+typedef BucketedHashMap<std::string, int> StringMap;
+static_assert(std::is_const<std::remove_reference<decltype(std::declval<StringMap::iterator &>()->key)>::type>::value, "iterators never hand out a writable key");
+static_assert(!std::is_const<std::remove_reference<decltype(std::declval<StringMap::iterator &>()->value)>::type>::value, "iterators hand out writable values");
+static_assert(std::is_const<std::remove_reference<decltype(std::declval<StringMap::const_iterator &>()->value)>::type>::value, "const iterators hand out read only values");
+static_assert(std::is_convertible<StringMap::iterator, StringMap::const_iterator>::value, "an iterator converts to a const_iterator");
+static_assert(!std::is_convertible<StringMap::const_iterator, StringMap::iterator>::value, "a const_iterator does not convert back");
+
+/**
+ * @brief Walks an empty map, a map in the middle of an incremental reHash
+ * and a const view of it, checking that every entry is visited once, that
+ * values written through an iterator stick, and that iterators compare equal
+ * to the const_iterators they convert to.
+ * 
+ * @return true 
+ * @return false 
+ */
+bool testIterators() {
+    StringMap empty = StringMap();
+    if (empty.begin() != empty.end() || empty.cbegin() != empty.cend()) {
+        return false;
+    }
+    StringMap map = StringMap(8);
+    map.setIncrementalReHash(1);
+    int inserted = 0;
+    while (!map.isReHashing() || inserted < 100) {
+        map.insert("key/" + std::to_string(inserted), inserted);
+        inserted++;
+    }
+    if (!map.isReHashing()) {
+        return false;
+    }
+    std::vector<bool> seen = std::vector<bool>(inserted, false);
+    for (StringMap::iterator it = map.begin(); it != map.end(); ++it) {
+        if (it->key != "key/" + std::to_string(it->value) || seen[it->value]) {
+            return false;
+        }
+        seen[it->value] = true;
+        (*it).value = -it->value - 1;
+    }
+    if (map.isReHashing() || std::count(seen.begin(), seen.end(), true) != inserted) {
+        return false;
+    }
+    const StringMap &view = map;
+    int visited = 0;
+    for (StringMap::const_iterator it = view.begin(); it != view.end(); it++) {
+        if (map.get(it->key) != it->value || it->value >= 0) {
+            return false;
+        }
+        visited++;
+    }
+    StringMap::iterator first = map.begin();
+    StringMap::const_iterator converted = first;
+    StringMap::const_iterator second = converted;
+    ++second;
+    return visited == inserted && converted == first && first == view.begin() && second != first
+        && map.get("key/0") == -1;
+}
+
+/**
+ * @brief Inserts disjoint string keys from several threads into a sharded
+ * map, then checks that every key is found through the hash computed once by
+ * the sharded map, by std::string and by std::string_view, that
+ * tryEmplace() leaves existing keys alone, and that removes land in the
+ * right shard.
+ * 
+ * @return true 
+ * @return false 
+ */
+bool testSharded() {
+    ShardedBucketedHashMap<std::string, int> map = ShardedBucketedHashMap<std::string, int>(8, 4, 1.0);
+    std::vector<std::thread> writers = std::vector<std::thread>();
+    for (int t = 0; t < 4; t++) {
+        writers.push_back(std::thread([&map, t]() {
+            for (int i = t; i < 20000; i += 4) {
+                map.insertOrAssign("key/" + std::to_string(i), i);
+            }
+        }));
+    }
+    for (size_t t = 0; t < writers.size(); t++) {
+        writers[t].join();
+    }
+    if (map.getSize() != 20000) {
+        return false;
+    }
+    for (int i = 0; i < 20000; i++) {
+        std::string key = "key/" + std::to_string(i);
+        int value = -1;
+        if (!map.get(key, value) || value != i || !map.contains(std::string_view(key)) || map.tryEmplace(key, -i)) {
+            return false;
+        }
+        if (map.contains("miss/" + std::to_string(i))) {
+            return false;
+        }
+    }
+    for (int i = 0; i < 20000; i += 2) {
+        if (map.remove("key/" + std::to_string(i)) != i) {
+            return false;
+        }
+    }
+    size_t visited = 0;
+    bool odd = true;
+    map.forEach([&](const std::string &, const int &value) {
+        visited++;
+        odd = odd && value % 2 == 1;
+    });
+    return odd && visited == 10000 && map.getSize() == 10000 && !map.contains(std::string("key/0"));
+}
+
+template <class K>
+/**
+ * @brief Returns the i-th test key of type K.
+ * 
+ * @param i 
+ * @return K 
+ */
+K keyOf(int i) {
+    if constexpr (std::is_same<K, std::string>::value) {
+        return "key/" + std::to_string(i);
+    } else {
+        return K{i};
+    }
+}
+
+template <class K>
+/**
+ * @brief Checks that an unrolled map holds exactly the entries of ref.
+ * 
+ * @param map 
+ * @param ref 
+ * @param keys the key range to probe
+ * @return true 
+ * @return false 
+ */
+bool sameEntries(const UnrolledBucketedHashMap<K, int> &map, const std::map<int, int> &ref, int keys) {
+    if (map.getSize() != (int)ref.size() || map.isEmpty() != ref.empty()) {
+        return false;
+    }
+    for (int i = 0; i < keys; i++) {
+        std::map<int, int>::const_iterator it = ref.find(i);
+        if (map.containsKey(keyOf<K>(i)) != (it != ref.end()) || (it != ref.end() && map.get(keyOf<K>(i)) != it->second)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <class K>
+/**
+ * @brief Runs random inserts, overwrites and removes against the unrolled
+ * engine and a std::map, with the load factor threshold at the inline slot
+ * count so that many buckets spill into overflow blocks, then checks copies
+ * and moves of the result.
+ * 
+ * @return true 
+ * @return false 
+ */
+bool unrolledMatches() {
+    UnrolledBucketedHashMap<K, int> map = UnrolledBucketedHashMap<K, int>(1, (double)UnrolledBucketedHashMap<K, int>::getInlineSlots());
+    std::map<int, int> ref = std::map<int, int>();
+    std::mt19937 rng = std::mt19937(5);
+    for (int i = 0; i < 40000; i++) {
+        int key = (int)(rng() % 3000);
+        if (rng() % 3 == 0) {
+            if (ref.count(key) && (map.remove(keyOf<K>(key)) != ref[key] || !ref.erase(key))) {
+                return false;
+            }
+        } else {
+            map.insert(keyOf<K>(key), i);
+            ref[key] = i;
+        }
+        if (i % 4000 == 0 && !sameEntries(map, ref, 3000)) {
+            return false;
+        }
+    }
+    if (map.getCapacity() < 2 || !sameEntries(map, ref, 3000)) {
+        return false;
+    }
+    UnrolledBucketedHashMap<K, int> copy = map;
+    UnrolledBucketedHashMap<K, int> assigned = UnrolledBucketedHashMap<K, int>();
+    assigned.insert(keyOf<K>(-1), -1);
+    assigned = copy;
+    UnrolledBucketedHashMap<K, int> moved = std::move(copy);
+    if (!sameEntries(moved, ref, 3000) || !sameEntries(assigned, ref, 3000) || !copy.isEmpty()) {
+        return false;
+    }
+    copy.insert(keyOf<K>(1), 1);
+    map.clear();
+    return copy.getSize() == 1 && copy.get(keyOf<K>(1)) == 1 && map.isEmpty() && !map.containsKey(keyOf<K>(1))
+        && sameEntries(moved, ref, 3000);
+}
+
+/**
+ * @brief Checks the unrolled engine on int and string keys, and on keys
+ * whose std::hash takes 4 values, which pile dozens of entries into one
+ * bucket: removing its inline entries one by one moves overflow entries
+ * into the holes and frees the overflow blocks as they empty.
+ * 
+ * @return true 
+ * @return false 
+ */
+bool testUnrolled() {
+    if (!unrolledMatches<int>() || !unrolledMatches<std::string>()) {
+        return false;
+    }
+    UnrolledBucketedHashMap<CollidingKey, int> map = UnrolledBucketedHashMap<CollidingKey, int>(1, (double)UnrolledBucketedHashMap<CollidingKey, int>::getInlineSlots());
+    for (int round = 0; round < 2; round++) {
+        for (int i = 0; i < 400; i++) {
+            map.insert(CollidingKey{i}, i);
+        }
+        for (int i = 0; i < 400; i++) {
+            if (map.remove(CollidingKey{i}) != i) {
+                return false;
+            }
+            for (int j = i + 1; j < 400; j += 7) {
+                if (map.get(CollidingKey{j}) != j) {
+                    return false;
+                }
+            }
+        }
+        if (!map.isEmpty() || map.containsKey(CollidingKey{0})) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Runs random inserts, overwrites and removes against the flat engine
+ * and a std::map, then churns keys in and out at a constant size, which must
+ * reuse tombstones instead of growing the table, and finally grows it.
+ * 
+ * @return true 
+ * @return false 
+ */
+bool testFlatHashMap() {
+    EngineHashMap<int, int, FlatEngine> map = EngineHashMap<int, int, FlatEngine>();
+    std::map<int, int> ref = std::map<int, int>();
+    std::mt19937 rng = std::mt19937(3);
+    for (int i = 0; i < 50000; i++) {
+        int key = (int)(rng() % 2000);
+        if (rng() % 3 == 0) {
+            if (ref.count(key) && (map.remove(key) != ref[key] || !ref.erase(key))) {
+                return false;
+            }
+        } else {
+            map.insert(key, i);
+            ref[key] = i;
+        }
+        if (map.containsKey(key) != (ref.count(key) != 0)) {
+            return false;
+        }
+    }
+    EngineHashMap<int, int, FlatEngine> copy = map;
+    for (int key = 0; key < 2000; key++) {
+        if (copy.containsKey(key) != (ref.count(key) != 0) || (ref.count(key) && copy.get(key) != ref[key])) {
+            return false;
+        }
+    }
+    if (copy.getSize() != (int)ref.size()) {
+        return false;
+    }
+    map.clear();
+    for (int i = 0; i < 64; i++) {
+        map.insert(i, i);
+    }
+    int capacity = map.getCapacity();
+    for (int i = 64; i < 100000; i++) {
+        map.insert(i, i);
+        if (map.remove(i - 64) != i - 64) {
+            return false;
+        }
+    }
+    if (map.getCapacity() != capacity || map.getSize() != 64) {
+        return false;
+    }
+    for (int i = 0; i < 100000; i++) {
+        map.insert(i, -i);
+    }
+    for (int i = 0; i < 100000; i++) {
+        if (map.get(i) != -i) {
+            return false;
+        }
+    }
+    return map.getSize() == 100000 && map.getCapacity() > capacity;
+}
+
+/**
+ * @brief Prints the outcome of a test.
+ * 
+ * @param name 
+ * @param passed 
+ * @return true if the test passed
+ * @return false 
+ */
+bool report(const char *name, bool passed) {
+    std::cout << name << ": " << (passed ? "passed" : "FAILED") << std::endl;
+    return passed;
+}
 
 int main() {
+    bool ok = true;
+    ok = report("reHash pointer stability", testReHashPointerStability()) && ok;
+    ok = report("lock-free read stress", testReadMostlyStress()) && ok;
+    ok = report("sharded", testSharded()) && ok;
+    ok = report("iterators", testIterators()) && ok;
+    ok = report("flat engine", testFlatHashMap()) && ok;
+    ok = report("unrolled engine", testUnrolled()) && ok;
+    ok = report("freeze", testFreeze()) && ok;
+    ok = report("snapshot round trip", testSnapshot()) && ok;
+    ok = report("incremental reHash", testIncrementalReHash()) && ok;
+    ok = report("shrink", testShrink()) && ok;
+    ok = report("treeify", testTreeify<CollidingKey, BucketedHashMapTraits>()) && ok;
+    ok = report("treeify, move-to-front", testTreeify<CollidingKey, MoveToFrontTraits>()) && ok;
+    ok = report("treeify, unordered keys", testTreeify<UnorderedKey, BucketedHashMapTraits>()) && ok;
+    ok = report("treeify, unordered keys, move-to-front", testTreeify<UnorderedKey, MoveToFrontTraits>()) && ok;
+    ok = report("set algebra", testSetAlgebra<BucketedHashMapTraits>()) && ok;
+    ok = report("set algebra, value index", testSetAlgebra<IndexedValuesTraits>()) && ok;
+    ok = report("set algebra, bucket filter", testSetAlgebra<FilteredTraits>()) && ok;
+    ok = report("value index", testValueIndex()) && ok;
+    ok = report("emplace", testEmplace()) && ok;
+    ok = report("batch operations", testBatch()) && ok;
+    ok = report("no reorder", testReorder<NoReorder>()) && ok;
+    ok = report("move-to-front", testReorder<MoveToFront>()) && ok;
+    ok = report("transpose", testReorder<Transpose>()) && ok;
+    ok = report("modulo capacity", testCapacityPolicy<ModuloTraits>()) && ok;
+    ok = report("prime capacity", testCapacityPolicy<PrimeTraits>()) && ok;
+    ok = report("stats", testStats()) && ok;
+    ok = report("shared arena", testArena()) && ok;
+    ok = report("bulk build", testBulkBuild<BucketedHashMapTraits>()) && ok;
+    ok = report("bulk build, value index", testBulkBuild<IndexedValuesTraits>()) && ok;
+    ok = report("bulk build, bucket filter", testBulkBuild<FilteredTraits>()) && ok;
     BucketedHashMap<std::string, int> bHM = BucketedHashMap<std::string, int>(0.5);
     bHM.insert("ABC", 5);
     bHM.showStructure();
@@ -27,6 +1505,10 @@ int main() {
     bHM.showStructure();
     std::cout << bHM << std::endl;
     std::cout << bHM.getSize() << std::endl;
-    std::cout << bHM["ABC"] << std::endl;
-    return 0;
+    try {
+        std::cout << bHM["ABC"] << std::endl;
+    } catch (const std::invalid_argument &e) {
+        std::cout << "ABC after remove: " << e.what() << std::endl;
+    }
+    return ok ? 0 : 1;
 }
\ No newline at end of file
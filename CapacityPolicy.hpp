@@ -0,0 +1,203 @@
+#ifndef CAPACITY_POLICY_HPP
+#define CAPACITY_POLICY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "ReorderPolicy.hpp"
+
+/**
+ * @brief Capacity policy keeping the bucket count a power of two. The hash
+ * is spread by a Fibonacci (golden ratio) multiply and the bucket is taken
+ * from the top bits of the product, so even identity hashes such as
+ * std::hash<int> on sequential ids spread evenly without any division.
+ *
+ * @author Jonathan Ung
+ */
+struct PowerOfTwoCapacity {
+    static size_t roundCapacity(size_t);
+    static size_t grow(size_t);
+    static size_t indexOf(size_t, size_t);
+    static unsigned int leadingZeros(uint64_t);
+};
+
+/**
+ * @brief Returns the smallest power of two not below cap.
+ *
+ * @param cap
+ * @return size_t
+ */
+inline size_t PowerOfTwoCapacity::roundCapacity(size_t cap) {
+    size_t res = 1;
+    while (res < cap) {
+        res *= 2;
+    }
+    return res;
+}
+
+/**
+ * @brief Returns the capacity after a reHash.
+ *
+ * @param cap
+ * @return size_t
+ */
+inline size_t PowerOfTwoCapacity::grow(size_t cap) {
+    return cap * 2;
+}
+
+/**
+ * @brief Returns the number of leading zero bits of a non-zero value.
+ *
+ * @param x
+ * @return unsigned int
+ */
+inline unsigned int PowerOfTwoCapacity::leadingZeros(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned int)__builtin_clzll(x);
+#else
+    unsigned int res = 0;
+    while (!(x & 0x8000000000000000ULL)) {
+        x <<= 1;
+        res++;
+    }
+    return res;
+#endif
+}
+
+/**
+ * @brief Returns the bucket of a hash in a table of cap buckets, i.e. the top
+ * log2(cap) bits of hash * 2^64 / phi. The shift is split in two so a single
+ * bucket table shifts by 64 without undefined behaviour.
+ *
+ * @param hash
+ * @param cap a power of two
+ * @return size_t
+ */
+inline size_t PowerOfTwoCapacity::indexOf(size_t hash, size_t cap) {
+    uint64_t h = (uint64_t)hash * 0x9E3779B97F4A7C15ULL;
+    return (size_t)((h >> leadingZeros(cap)) >> 1);
+}
+
+/**
+ * @brief Capacity policy of the original map: the bucket count is used as
+ * given, doubles on every reHash, and a bucket is picked with hash % cap.
+ *
+ * @author Jonathan Ung
+ */
+struct ModuloCapacity {
+    static size_t roundCapacity(size_t);
+    static size_t grow(size_t);
+    static size_t indexOf(size_t, size_t);
+};
+
+/**
+ * @brief Returns cap unchanged.
+ *
+ * @param cap
+ * @return size_t
+ */
+inline size_t ModuloCapacity::roundCapacity(size_t cap) {
+    return cap;
+}
+
+/**
+ * @brief Returns the capacity after a reHash.
+ *
+ * @param cap
+ * @return size_t
+ */
+inline size_t ModuloCapacity::grow(size_t cap) {
+    return cap * 2;
+}
+
+/**
+ * @brief Returns the bucket of a hash in a table of cap buckets.
+ *
+ * @param hash
+ * @param cap
+ * @return size_t
+ */
+inline size_t ModuloCapacity::indexOf(size_t hash, size_t cap) {
+    return hash % cap;
+}
+
+/**
+ * @brief Capacity policy keeping the bucket count prime and picking a bucket
+ * with hash % cap, which spreads keys whose hashes share a common factor.
+ *
+ * @author Jonathan Ung
+ */
+struct PrimeCapacity {
+    static size_t roundCapacity(size_t);
+    static size_t grow(size_t);
+    static size_t indexOf(size_t, size_t);
+};
+
+/**
+ * @brief Returns the smallest prime not below cap.
+ *
+ * @param cap
+ * @return size_t
+ */
+inline size_t PrimeCapacity::roundCapacity(size_t cap) {
+    if (cap <= 2) {
+        return 2;
+    }
+    size_t res = cap % 2 == 0 ? cap + 1 : cap;
+    while (true) {
+        bool prime = true;
+        for (size_t d = 3; d * d <= res; d += 2) {
+            if (res % d == 0) {
+                prime = false;
+                break;
+            }
+        }
+        if (prime) {
+            return res;
+        }
+        res += 2;
+    }
+}
+
+/**
+ * @brief Returns the capacity after a reHash, the first prime past twice cap.
+ *
+ * @param cap
+ * @return size_t
+ */
+inline size_t PrimeCapacity::grow(size_t cap) {
+    return roundCapacity(cap * 2);
+}
+
+/**
+ * @brief Returns the bucket of a hash in a table of cap buckets.
+ *
+ * @param hash
+ * @param cap
+ * @return size_t
+ */
+inline size_t PrimeCapacity::indexOf(size_t hash, size_t cap) {
+    return hash % cap;
+}
+
+/**
+ * @brief Default compile time options of a BucketedHashMap. To change one,
+ * derive from this struct and shadow the member, e.g.
+ * struct LegacyTraits : BucketedHashMapTraits { typedef ModuloCapacity CapacityPolicy; };
+ *
+ * @param CapacityPolicy how the bucket count is rounded and grown and how a hash picks its bucket
+ * @param collectStats whether the map counts and times its reHashes for stats()
+ * @param ReorderPolicy how a lookup reorders the chain it hits, see ReorderPolicy.hpp
+ * @param indexValues whether the map keeps a ValueIndex, making containsValue()
+ * and keysForValue() hash lookups at the price of memory and slower writes
+ * @param filterBuckets whether a lookup checks the fingerprint of its bucket
+ * before walking it, so most misses touch no node
+ */
+struct BucketedHashMapTraits {
+    typedef PowerOfTwoCapacity CapacityPolicy;
+    static const bool collectStats = true;
+    typedef NoReorder ReorderPolicy;
+    static const bool indexValues = false;
+    static const bool filterBuckets = false;
+};
+
+#endif
@@ -0,0 +1,215 @@
+#ifndef CHAIN_TREE_HPP
+#define CHAIN_TREE_HPP
+
+#include <set>
+#include <type_traits>
+#include <utility>
+#include "MapNode.hpp"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CHAIN_TREE_COLD __attribute__((noinline, cold))
+#else
+#define CHAIN_TREE_COLD
+#endif
+
+template <class A, class B, class = void>
+/**
+ * @brief True when a const A can be compared with a const B by operator<.
+ */
+struct IsLessComparable : std::false_type {};
+
+template <class A, class B>
+struct IsLessComparable<A, B, std::void_t<decltype(std::declval<const A &>() < std::declval<const B &>())>> : std::true_type {};
+
+template <class K, class V>
+/**
+ * @brief A balanced search tree over the nodes of one long KVList chain,
+ * which stays linked as a list: the tree only indexes its nodes by hash,
+ * then by key when K has an operator<, and remembers the node in front of
+ * each so that a node can be unlinked without walking the chain. Lookups
+ * and removals take O(log n), except among keys of equal hash and no
+ * operator<, which are searched one by one. Its functions are kept out of
+ * line so the list code that only rarely calls them stays small.
+ *
+ * @author Jonathan Ung
+ */
+class ChainTree {
+    private:
+        /**
+         * @brief A node of the chain and the node in front of it, nullptr for the head.
+         */
+        struct Entry {
+            MapNode<K, V> *node;
+            mutable MapNode<K, V> *prev;
+        };
+        struct HashProbe {
+            size_t hash;
+        };
+        template <class Q>
+        struct KeyProbe {
+            size_t hash;
+            const Q *key;
+        };
+        /**
+         * @brief Orders entries by hash, then by key when K has an operator<,
+         * and compares probes holding only a hash or a hash and a key.
+         */
+        struct Less {
+            typedef void is_transparent;
+            bool operator()(const Entry &a, const Entry &b) const {
+                if (a.node->hash != b.node->hash) {
+                    return a.node->hash < b.node->hash;
+                }
+                if constexpr (IsLessComparable<K, K>::value) {
+                    return a.node->key < b.node->key;
+                } else {
+                    return false;
+                }
+            }
+            bool operator()(const HashProbe &a, const Entry &b) const {
+                return a.hash < b.node->hash;
+            }
+            bool operator()(const Entry &a, const HashProbe &b) const {
+                return a.node->hash < b.hash;
+            }
+            template <class Q>
+            bool operator()(const KeyProbe<Q> &a, const Entry &b) const {
+                return a.hash < b.node->hash || (a.hash == b.node->hash && *a.key < b.node->key);
+            }
+            template <class Q>
+            bool operator()(const Entry &a, const KeyProbe<Q> &b) const {
+                return a.node->hash < b.hash || (a.node->hash == b.hash && a.node->key < *b.key);
+            }
+        };
+        typedef std::multiset<Entry, Less> Tree;
+        Tree tree;
+        template <class Q>
+        typename Tree::const_iterator locate(const Q &, size_t) const;
+        typename Tree::const_iterator locate(const MapNode<K, V> *) const;
+
+    public:
+        explicit ChainTree(MapNode<K, V> *);
+        ~ChainTree();
+        template <class Q>
+        MapNode<K, V>* find(const Q &, size_t) const;
+        void pushFront(MapNode<K, V> *, MapNode<K, V> *);
+        template <class Q>
+        MapNode<K, V>* unlink(const Q &, size_t, MapNode<K, V> *&);
+};
+
+template <class K, class V>
+/**
+ * @brief Builds the tree of a chain.
+ *
+ * @param head the first node of the chain
+ */
+CHAIN_TREE_COLD ChainTree<K,V>::ChainTree(MapNode<K, V> *head) {
+    MapNode<K, V> *prev = nullptr;
+    for (MapNode<K, V> *tmp = head; tmp; tmp = tmp->next) {
+        this->tree.insert(Entry{tmp, prev});
+        prev = tmp;
+    }
+}
+
+template <class K, class V>
+/**
+ * @brief Destructor for a ChainTree. The nodes belong to the list and are
+ * left alone.
+ */
+CHAIN_TREE_COLD ChainTree<K,V>::~ChainTree() {}
+
+template <class K, class V>
+template <class Q>
+/**
+ * @brief Returns the entry of a key, or end(). The key is only ordered
+ * against K when both compare with operator<, otherwise the nodes of equal
+ * hash are compared with operator== one by one.
+ *
+ * @param key
+ * @param hash
+ * @return typename ChainTree<K,V>::Tree::const_iterator
+ */
+typename ChainTree<K,V>::Tree::const_iterator ChainTree<K,V>::locate(const Q &key, size_t hash) const {
+    if constexpr (IsLessComparable<K, K>::value && IsLessComparable<Q, K>::value && IsLessComparable<K, Q>::value) {
+        return this->tree.find(KeyProbe<Q>{hash, &key});
+    } else {
+        std::pair<typename Tree::const_iterator, typename Tree::const_iterator> range = this->tree.equal_range(HashProbe{hash});
+        for (typename Tree::const_iterator it = range.first; it != range.second; ++it) {
+            if (key == it->node->key) {
+                return it;
+            }
+        }
+        return this->tree.end();
+    }
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the entry of a node of the chain.
+ *
+ * @param node
+ * @return typename ChainTree<K,V>::Tree::const_iterator
+ */
+typename ChainTree<K,V>::Tree::const_iterator ChainTree<K,V>::locate(const MapNode<K, V> *node) const {
+    return this->locate(node->key, node->hash);
+}
+
+template <class K, class V>
+template <class Q>
+/**
+ * @brief Returns the node of a key, or nullptr.
+ *
+ * @param key
+ * @param hash
+ * @return MapNode<K,V>*
+ */
+CHAIN_TREE_COLD MapNode<K,V>* ChainTree<K,V>::find(const Q &key, size_t hash) const {
+    typename Tree::const_iterator it = this->locate(key, hash);
+    return it != this->tree.end() ? it->node : nullptr;
+}
+
+template <class K, class V>
+/**
+ * @brief Adds a node the chain has just linked in front of its old head.
+ *
+ * @param node the new head, whose key is not in the chain yet
+ * @param oldHead the former head, or nullptr
+ */
+CHAIN_TREE_COLD void ChainTree<K,V>::pushFront(MapNode<K, V> *node, MapNode<K, V> *oldHead) {
+    if (oldHead) {
+        this->locate(oldHead)->prev = node;
+    }
+    this->tree.insert(Entry{node, nullptr});
+}
+
+template <class K, class V>
+template <class Q>
+/**
+ * @brief Unlinks the node of a key from the chain and the tree without
+ * destroying it.
+ *
+ * @param key
+ * @param hash
+ * @param head the head of the chain, updated if the node was the head
+ * @return MapNode<K,V>* the node, or nullptr if the key is not in the chain
+ */
+CHAIN_TREE_COLD MapNode<K,V>* ChainTree<K,V>::unlink(const Q &key, size_t hash, MapNode<K, V> *&head) {
+    typename Tree::const_iterator it = this->locate(key, hash);
+    if (it == this->tree.end()) {
+        return nullptr;
+    }
+    MapNode<K, V> *node = it->node;
+    MapNode<K, V> *prev = it->prev;
+    if (prev) {
+        prev->next = node->next;
+    } else {
+        head = node->next;
+    }
+    if (node->next) {
+        this->locate(node->next)->prev = prev;
+    }
+    this->tree.erase(it);
+    return node;
+}
+
+#endif
@@ -0,0 +1,252 @@
+#ifndef EPOCH_DOMAIN_HPP
+#define EPOCH_DOMAIN_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Process-wide epoch based reclamation. Readers wrap every traversal
+ * of shared memory in an EpochGuard, which publishes the global epoch they
+ * entered in. Writers unlink memory first and then retire() it with a
+ * deleter; collect() advances the epoch and runs the deleters of everything
+ * retired before the oldest epoch any reader is still in, since no reader
+ * can reach it any more.
+ * Readers never block and never write to memory shared with other readers
+ * apart from their own record.
+ *
+ * @author Jonathan Ung
+ */
+class EpochDomain {
+    private:
+        /**
+         * @brief The published epoch of one thread, 0 while it is outside any
+         * guard. Records are reused by later threads and never freed.
+         */
+        struct alignas(64) Record {
+            std::atomic<uint64_t> epoch;
+            std::atomic<bool> inUse;
+            Record *next;
+        };
+        struct Retired {
+            void *ptr;
+            void (*deleter)(void *);
+            uint64_t epoch;
+        };
+        /**
+         * @brief Holds the calling thread's record and hands it back when
+         * the thread exits.
+         */
+        struct ThreadRecord {
+            Record *record;
+            unsigned int depth;
+            ThreadRecord();
+            ~ThreadRecord();
+        };
+        std::atomic<uint64_t> epoch;
+        std::atomic<Record *> records;
+        std::mutex retiredLock;
+        std::vector<Retired> retired;
+        EpochDomain();
+        Record *acquireRecord();
+        static ThreadRecord &threadRecord();
+        friend class EpochGuard;
+
+    public:
+        EpochDomain(const EpochDomain &) = delete;
+        EpochDomain &operator=(const EpochDomain &) = delete;
+        ~EpochDomain();
+        static EpochDomain &instance();
+        void retire(void *, void (*)(void *));
+        size_t collect();
+        size_t pending();
+};
+
+/**
+ * @brief Marks the calling thread as reading shared memory for as long as it
+ * lives. Guards nest; only the outermost one publishes an epoch.
+ *
+ * @author Jonathan Ung
+ */
+class EpochGuard {
+    public:
+        EpochGuard();
+        EpochGuard(const EpochGuard &) = delete;
+        EpochGuard &operator=(const EpochGuard &) = delete;
+        ~EpochGuard();
+};
+
+/**
+ * @brief Construct a new Epoch Domain object. Epoch 0 is reserved for threads
+ * outside any guard.
+ *
+ */
+inline EpochDomain::EpochDomain() {
+    this->epoch.store(1);
+    this->records.store(nullptr);
+}
+
+/**
+ * @brief Destructor for the EpochDomain, run at exit once no reader is left,
+ * which frees everything still retired.
+ */
+inline EpochDomain::~EpochDomain() {
+    for (size_t i = 0; i < this->retired.size(); i++) {
+        this->retired[i].deleter(this->retired[i].ptr);
+    }
+}
+
+/**
+ * @brief Returns the process-wide domain.
+ *
+ * @return EpochDomain&
+ */
+inline EpochDomain &EpochDomain::instance() {
+    static EpochDomain domain;
+    return domain;
+}
+
+/**
+ * @brief Returns a free record, reusing one left by an exited thread before
+ * pushing a new one onto the list.
+ *
+ * @return Record*
+ */
+inline EpochDomain::Record *EpochDomain::acquireRecord() {
+    for (Record *r = this->records.load(); r; r = r->next) {
+        bool expected = false;
+        if (!r->inUse.load() && r->inUse.compare_exchange_strong(expected, true)) {
+            return r;
+        }
+    }
+    Record *r = new Record();
+    r->epoch.store(0);
+    r->inUse.store(true);
+    r->next = this->records.load();
+    while (!this->records.compare_exchange_weak(r->next, r)) {}
+    return r;
+}
+
+/**
+ * @brief Construct a new Thread Record object holding a record of the domain
+ *
+ */
+inline EpochDomain::ThreadRecord::ThreadRecord() {
+    this->record = EpochDomain::instance().acquireRecord();
+    this->depth = 0;
+}
+
+/**
+ * @brief Destructor for a ThreadRecord, run at thread exit, which returns the
+ * record for reuse.
+ */
+inline EpochDomain::ThreadRecord::~ThreadRecord() {
+    this->record->epoch.store(0);
+    this->record->inUse.store(false);
+}
+
+/**
+ * @brief Returns the calling thread's record holder.
+ *
+ * @return ThreadRecord&
+ */
+inline EpochDomain::ThreadRecord &EpochDomain::threadRecord() {
+    static thread_local ThreadRecord tr;
+    return tr;
+}
+
+/**
+ * @brief Hands memory that is no longer reachable from the shared structure
+ * to the domain, which runs deleter on it once every reader that could
+ * still hold a pointer to it has left its guard.
+ *
+ * @param ptr
+ * @param deleter
+ */
+inline void EpochDomain::retire(void *ptr, void (*deleter)(void *)) {
+    std::lock_guard<std::mutex> guard(this->retiredLock);
+    this->retired.push_back(Retired{ptr, deleter, this->epoch.load()});
+}
+
+/**
+ * @brief Advances the epoch and frees everything retired before the oldest
+ * epoch a reader is still in.
+ *
+ * @return size_t the number of deleters run
+ */
+inline size_t EpochDomain::collect() {
+    this->epoch.fetch_add(1);
+    uint64_t oldest = UINT64_MAX;
+    for (Record *r = this->records.load(); r; r = r->next) {
+        uint64_t e = r->epoch.load();
+        if (e != 0 && e < oldest) {
+            oldest = e;
+        }
+    }
+    std::vector<Retired> ready = std::vector<Retired>();
+    {
+        std::lock_guard<std::mutex> guard(this->retiredLock);
+        size_t kept = 0;
+        for (size_t i = 0; i < this->retired.size(); i++) {
+            if (this->retired[i].epoch < oldest) {
+                ready.push_back(this->retired[i]);
+            } else {
+                this->retired[kept++] = this->retired[i];
+            }
+        }
+        this->retired.resize(kept);
+    }
+    for (size_t i = 0; i < ready.size(); i++) {
+        ready[i].deleter(ready[i].ptr);
+    }
+    return ready.size();
+}
+
+/**
+ * @brief Returns how many retired pointers are still waiting to be freed.
+ *
+ * @return size_t
+ */
+inline size_t EpochDomain::pending() {
+    std::lock_guard<std::mutex> guard(this->retiredLock);
+    return this->retired.size();
+}
+
+/**
+ * @brief Construct a new Epoch Guard object. The epoch is published and then
+ * read again: if it moved in between, a collect() may have missed the
+ * published value, so the thread publishes the new epoch and checks again.
+ * Every access is sequentially consistent, which is what lets collect() see
+ * the epoch of any reader that entered before the epoch advanced.
+ *
+ */
+inline EpochGuard::EpochGuard() {
+    EpochDomain::ThreadRecord &tr = EpochDomain::threadRecord();
+    if (tr.depth++ > 0) {
+        return;
+    }
+    EpochDomain &domain = EpochDomain::instance();
+    uint64_t e = domain.epoch.load();
+    while (true) {
+        tr.record->epoch.store(e);
+        uint64_t now = domain.epoch.load();
+        if (now == e) {
+            break;
+        }
+        e = now;
+    }
+}
+
+/**
+ * @brief Destructor for an Epoch Guard object, leaving the epoch once the
+ * outermost guard ends.
+ */
+inline EpochGuard::~EpochGuard() {
+    EpochDomain::ThreadRecord &tr = EpochDomain::threadRecord();
+    if (--tr.depth == 0) {
+        tr.record->epoch.store(0);
+    }
+}
+
+#endif
@@ -0,0 +1,597 @@
+#ifndef FLAT_HASH_MAP_HPP
+#define FLAT_HASH_MAP_HPP
+
+#include <iostream>
+#include <functional>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FLAT_HASH_MAP_SSE2 1
+#endif
+
+/**
+ * @brief A group of 16 control bytes, compared against a tag all at once.
+ * A control byte is either kEmpty, kDeleted, or the 7-bit tag of the hash of
+ * the key stored in the matching slot. Every match function returns a 16-bit
+ * mask with one bit per slot of the group.
+ *
+ * @author Jonathan Ung
+ */
+class ControlGroup {
+    public:
+        static const int8_t kEmpty = -128;
+        static const int8_t kDeleted = -2;
+        static const size_t kWidth = 16;
+        explicit ControlGroup(const int8_t *);
+        uint32_t match(int8_t) const;
+        uint32_t matchEmpty() const;
+        uint32_t matchEmptyOrDeleted() const;
+        static unsigned int lowestBit(uint32_t);
+
+    private:
+#ifdef FLAT_HASH_MAP_SSE2
+        __m128i ctrl;
+#else
+        const int8_t *ctrl;
+#endif
+};
+
+/**
+ * @brief Loads the 16 control bytes starting at c.
+ *
+ * @param c
+ */
+inline ControlGroup::ControlGroup(const int8_t *c) {
+#ifdef FLAT_HASH_MAP_SSE2
+    this->ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(c));
+#else
+    this->ctrl = c;
+#endif
+}
+
+/**
+ * @brief Returns the slots whose control byte equals the given tag.
+ *
+ * @param tag
+ * @return uint32_t
+ */
+inline uint32_t ControlGroup::match(int8_t tag) const {
+#ifdef FLAT_HASH_MAP_SSE2
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(tag), this->ctrl));
+#else
+    uint32_t res = 0;
+    for (size_t i = 0; i < kWidth; i++) {
+        res |= (uint32_t)(this->ctrl[i] == tag) << i;
+    }
+    return res;
+#endif
+}
+
+/**
+ * @brief Returns the slots that have never been used since the last resize.
+ *
+ * @return uint32_t
+ */
+inline uint32_t ControlGroup::matchEmpty() const {
+    return this->match(kEmpty);
+}
+
+/**
+ * @brief Returns the slots that can take a new entry, i.e. whose control byte
+ * has its sign bit set.
+ *
+ * @return uint32_t
+ */
+inline uint32_t ControlGroup::matchEmptyOrDeleted() const {
+#ifdef FLAT_HASH_MAP_SSE2
+    return (uint32_t)_mm_movemask_epi8(this->ctrl);
+#else
+    uint32_t res = 0;
+    for (size_t i = 0; i < kWidth; i++) {
+        res |= (uint32_t)(this->ctrl[i] < 0) << i;
+    }
+    return res;
+#endif
+}
+
+/**
+ * @brief Returns the index of the lowest set bit of a non-zero mask.
+ *
+ * @param mask
+ * @return unsigned int
+ */
+inline unsigned int ControlGroup::lowestBit(uint32_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned int)__builtin_ctz(mask);
+#else
+    unsigned int res = 0;
+    while (!(mask & 1)) {
+        mask >>= 1;
+        res++;
+    }
+    return res;
+#endif
+}
+
+template <class K, class V>
+/**
+ * @brief An open-addressing hash map that stores its entries flat in one slot
+ * array, next to a parallel array of 1-byte control tags. Lookups probe whole
+ * groups of 16 tags with one SIMD compare and only compare keys on a tag hit.
+ * It exposes the same interface as BucketedHashMap so the two engines can be
+ * swapped, see HashMapEngine.hpp.
+ *
+ * @author Jonathan Ung
+ */
+class FlatHashMap {
+    private:
+        struct Slot {
+            K key;
+            V value;
+        };
+        size_t size;
+        size_t tombstones;
+        size_t groupCount;
+        int8_t *ctrl;
+        Slot *slots;
+        static size_t hashOf(const K &);
+        static int8_t tagOf(size_t);
+        static size_t groupsFor(size_t);
+        size_t slotCount() const;
+        size_t find(const K &, size_t) const;
+        size_t findFree(size_t) const;
+        void allocate(size_t);
+        void destroy();
+        void resize(size_t);
+
+    public:
+        static const size_t npos = (size_t)-1;
+        FlatHashMap();
+        FlatHashMap(int);
+        FlatHashMap(const FlatHashMap &);
+        FlatHashMap(FlatHashMap &&);
+        ~FlatHashMap();
+        FlatHashMap<K,V>& operator=(const FlatHashMap<K,V>&);
+        FlatHashMap<K,V>& operator=(FlatHashMap<K,V>&&);
+        void clear();
+        bool containsKey(const K &) const;
+        V& get(const K &) const;
+        V& operator[](const K &) const;
+        bool isEmpty() const;
+        void insert(const K, const V);
+        V remove(const K &);
+        int getSize() const;
+        int getCapacity() const;
+        void show() const;
+};
+
+template <class K, class V>
+/**
+ * @brief Hashes a key and spreads its bits, since std::hash is the identity
+ * for integers and both the group index and the tag need well mixed bits.
+ *
+ * @param key
+ * @return size_t
+ */
+size_t FlatHashMap<K,V>::hashOf(const K &key) {
+    uint64_t h = (uint64_t)std::hash<K>()(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (size_t)h;
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the 7-bit control tag of a hash.
+ *
+ * @param hash
+ * @return int8_t
+ */
+int8_t FlatHashMap<K,V>::tagOf(size_t hash) {
+    return (int8_t)(hash & 0x7f);
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the power of two number of groups needed to hold the given
+ * number of entries below the 7/8 maximum load.
+ *
+ * @param entries
+ * @return size_t
+ */
+size_t FlatHashMap<K,V>::groupsFor(size_t entries) {
+    size_t groups = 1;
+    while (groups * ControlGroup::kWidth * 7 / 8 < entries) {
+        groups *= 2;
+    }
+    return groups;
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the number of slots of the table.
+ *
+ * @return size_t
+ */
+size_t FlatHashMap<K,V>::slotCount() const {
+    return this->groupCount * ControlGroup::kWidth;
+}
+
+template <class K, class V>
+/**
+ * @brief Allocates empty control bytes and uninitialized slots for the given number of groups.
+ *
+ * @param groups
+ */
+void FlatHashMap<K,V>::allocate(size_t groups) {
+    this->groupCount = groups;
+    this->ctrl = new int8_t[this->slotCount()];
+    for (size_t i = 0; i < this->slotCount(); i++) {
+        this->ctrl[i] = ControlGroup::kEmpty;
+    }
+    this->slots = static_cast<Slot *>(::operator new(sizeof(Slot) * this->slotCount()));
+    this->size = 0;
+    this->tombstones = 0;
+}
+
+template <class K, class V>
+/**
+ * @brief Destroys every stored entry and frees both arrays.
+ *
+ */
+void FlatHashMap<K,V>::destroy() {
+    if (!this->ctrl) {
+        return;
+    }
+    for (size_t i = 0; i < this->slotCount(); i++) {
+        if (this->ctrl[i] >= 0) {
+            this->slots[i].~Slot();
+        }
+    }
+    delete[] this->ctrl;
+    ::operator delete(this->slots);
+    this->ctrl = nullptr;
+    this->slots = nullptr;
+}
+
+template <class K, class V>
+/**
+ * @brief Construct a new Flat Hash Map< K, V>:: Flat Hash Map object
+ *
+ */
+FlatHashMap<K,V>::FlatHashMap() {
+    this->allocate(1);
+}
+
+template <class K, class V>
+/**
+ * @brief Construct a new Flat Hash Map< K, V>:: Flat Hash Map object sized
+ * to hold cap entries without resizing
+ *
+ * @param cap
+ */
+FlatHashMap<K,V>::FlatHashMap(int cap) {
+    if (cap < 1) {
+        throw std::invalid_argument("Capacity must be larger than 0!");
+    }
+    this->allocate(groupsFor(cap));
+}
+
+template <class K, class V>
+/**
+ * @brief Copy constructor for a FlatHashMap object.
+ *
+ * @param other
+ */
+FlatHashMap<K,V>::FlatHashMap(const FlatHashMap &other) {
+    this->allocate(other.groupCount);
+    for (size_t i = 0; i < other.slotCount(); i++) {
+        if (other.ctrl[i] >= 0) {
+            this->insert(other.slots[i].key, other.slots[i].value);
+        }
+    }
+}
+
+template <class K, class V>
+/**
+ * @brief Move constructor for a FlatHashMap object.
+ *
+ * @param other
+ */
+FlatHashMap<K,V>::FlatHashMap(FlatHashMap &&other) {
+    this->size = other.size;
+    this->tombstones = other.tombstones;
+    this->groupCount = other.groupCount;
+    this->ctrl = other.ctrl;
+    this->slots = other.slots;
+    other.allocate(1);
+}
+
+template <class K, class V>
+/**
+ * @brief Destructor for a FlatHashMap object.
+ */
+FlatHashMap<K,V>::~FlatHashMap() {
+    this->destroy();
+}
+
+template <class K, class V>
+/**
+ * @brief Copies a map using an overloaded assignment operator.
+ *
+ * @param other
+ * @return FlatHashMap<K,V>&
+ */
+FlatHashMap<K,V>& FlatHashMap<K,V>::operator=(const FlatHashMap<K,V>& other) {
+    if (this != &other) {
+        FlatHashMap<K,V> tmp = other;
+        *this = std::move(tmp);
+    }
+    return *this;
+}
+
+template <class K, class V>
+/**
+ * @brief Moves a map using an overloaded assignment operator.
+ *
+ * @param other
+ * @return FlatHashMap<K,V>&
+ */
+FlatHashMap<K,V>& FlatHashMap<K,V>::operator=(FlatHashMap<K,V>&& other) {
+    if (this != &other) {
+        std::swap(this->size, other.size);
+        std::swap(this->tombstones, other.tombstones);
+        std::swap(this->groupCount, other.groupCount);
+        std::swap(this->ctrl, other.ctrl);
+        std::swap(this->slots, other.slots);
+    }
+    return *this;
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the slot holding the key, or npos. Groups are visited in
+ * triangular order, which covers every group of a power of two table, and the
+ * probe stops at the first group that still has an empty slot.
+ *
+ * @param key
+ * @param hash
+ * @return size_t
+ */
+size_t FlatHashMap<K,V>::find(const K &key, size_t hash) const {
+    size_t mask = this->groupCount - 1;
+    size_t group = (hash >> 7) & mask;
+    int8_t tag = tagOf(hash);
+    for (size_t step = 1; step <= this->groupCount; step++) {
+        ControlGroup g = ControlGroup(this->ctrl + group * ControlGroup::kWidth);
+        for (uint32_t m = g.match(tag); m; m &= m - 1) {
+            size_t i = group * ControlGroup::kWidth + ControlGroup::lowestBit(m);
+            if (this->slots[i].key == key) {
+                return i;
+            }
+        }
+        if (g.matchEmpty()) {
+            return npos;
+        }
+        group = (group + step) & mask;
+    }
+    return npos;
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the first empty or deleted slot on the probe sequence of the hash.
+ *
+ * @param hash
+ * @return size_t
+ */
+size_t FlatHashMap<K,V>::findFree(size_t hash) const {
+    size_t mask = this->groupCount - 1;
+    size_t group = (hash >> 7) & mask;
+    for (size_t step = 1; ; step++) {
+        uint32_t m = ControlGroup(this->ctrl + group * ControlGroup::kWidth).matchEmptyOrDeleted();
+        if (m) {
+            return group * ControlGroup::kWidth + ControlGroup::lowestBit(m);
+        }
+        group = (group + step) & mask;
+    }
+}
+
+template <class K, class V>
+/**
+ * @brief Moves every entry into a new table of the given number of groups,
+ * which also drops all tombstones.
+ *
+ * @param groups
+ */
+void FlatHashMap<K,V>::resize(size_t groups) {
+    int8_t *oldCtrl = this->ctrl;
+    Slot *oldSlots = this->slots;
+    size_t oldSlotCount = this->slotCount();
+    size_t oldSize = this->size;
+    this->allocate(groups);
+    for (size_t i = 0; i < oldSlotCount; i++) {
+        if (oldCtrl[i] >= 0) {
+            size_t hash = hashOf(oldSlots[i].key);
+            size_t j = this->findFree(hash);
+            this->ctrl[j] = tagOf(hash);
+            new (&this->slots[j]) Slot{std::move(oldSlots[i].key), std::move(oldSlots[i].value)};
+            oldSlots[i].~Slot();
+        }
+    }
+    this->size = oldSize;
+    delete[] oldCtrl;
+    ::operator delete(oldSlots);
+}
+
+template <class K, class V>
+/**
+ * @brief clears the map
+ *
+ */
+void FlatHashMap<K,V>::clear() {
+    for (size_t i = 0; i < this->slotCount(); i++) {
+        if (this->ctrl[i] >= 0) {
+            this->slots[i].~Slot();
+        }
+        this->ctrl[i] = ControlGroup::kEmpty;
+    }
+    this->size = 0;
+    this->tombstones = 0;
+}
+
+template <class K, class V>
+/**
+ * @brief Returns whether or not the map contains the passed in key
+ *
+ * @param key
+ * @return true
+ * @return false
+ */
+bool FlatHashMap<K,V>::containsKey(const K &key) const {
+    return this->find(key, hashOf(key)) != npos;
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the reference to the value paired to the given key
+ *
+ * @param key
+ * @return V&
+ * @throws std::invalid_argument if the key is not found.
+ */
+V& FlatHashMap<K,V>::get(const K &key) const {
+    size_t i = this->find(key, hashOf(key));
+    if (i == npos) {
+        throw std::invalid_argument("Key not found");
+    }
+    return this->slots[i].value;
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the reference to the value paired to the given key
+ *
+ * @param key
+ * @return V&
+ */
+V& FlatHashMap<K,V>::operator[](const K &key) const {
+    return this->get(key);
+}
+
+template <class K, class V>
+/**
+ * @brief Returns whether or not the map is empty.
+ *
+ * @return true
+ * @return false
+ */
+bool FlatHashMap<K,V>::isEmpty() const {
+    return this->size == 0;
+}
+
+template <class K, class V>
+/**
+ * @brief inserts a key-value pair into the map, overwriting the value of an
+ * existing key. The table grows once live entries and tombstones would exceed
+ * 7/8 of the slots; if mostly tombstones are in the way it is only rebuilt.
+ *
+ * @param key
+ * @param value
+ */
+void FlatHashMap<K,V>::insert(const K key, const V value) {
+    size_t hash = hashOf(key);
+    size_t i = this->find(key, hash);
+    if (i != npos) {
+        this->slots[i].value = value;
+        return;
+    }
+    if ((this->size + this->tombstones + 1) * 8 > this->slotCount() * 7) {
+        if ((this->size + 1) * 16 > this->slotCount() * 7) {
+            this->resize(this->groupCount * 2);
+        } else {
+            this->resize(this->groupCount);
+        }
+    }
+    i = this->findFree(hash);
+    if (this->ctrl[i] == ControlGroup::kDeleted) {
+        this->tombstones--;
+    }
+    new (&this->slots[i]) Slot{key, value};
+    this->ctrl[i] = tagOf(hash);
+    this->size++;
+}
+
+template <class K, class V>
+/**
+ * @brief removes the given key and value from the map. The slot becomes
+ * empty again when its group already has an empty slot, because no probe
+ * can have continued past that group; otherwise it is left as a tombstone.
+ *
+ * @param key
+ * @return V
+ * @throws std::invalid_argument if the key is not found.
+ */
+V FlatHashMap<K,V>::remove(const K &key) {
+    size_t i = this->find(key, hashOf(key));
+    if (i == npos) {
+        throw std::invalid_argument("No key found.");
+    }
+    V res = std::move(this->slots[i].value);
+    this->slots[i].~Slot();
+    size_t group = i / ControlGroup::kWidth;
+    if (ControlGroup(this->ctrl + group * ControlGroup::kWidth).matchEmpty()) {
+        this->ctrl[i] = ControlGroup::kEmpty;
+    } else {
+        this->ctrl[i] = ControlGroup::kDeleted;
+        this->tombstones++;
+    }
+    this->size--;
+    return res;
+}
+
+template <class K, class V>
+/**
+ * @brief returns the size of the map
+ *
+ * @return int
+ */
+int FlatHashMap<K,V>::getSize() const {
+    return this->size;
+}
+
+template <class K, class V>
+/**
+ * @brief returns the number of slots of the map
+ *
+ * @return int
+ */
+int FlatHashMap<K,V>::getCapacity() const {
+    return this->slotCount();
+}
+
+template <class K, class V>
+/**
+ * @brief prints the map
+ *
+ */
+void FlatHashMap<K,V>::show() const {
+    std::cout << "Flat Hash Map Entries: [ " << std::endl;
+    size_t printed = 0;
+    for (size_t i = 0; i < this->slotCount(); i++) {
+        if (this->ctrl[i] >= 0) {
+            std::cout << "    " << "{K: " << this->slots[i].key << ", V: " << this->slots[i].value << "}";
+            if (++printed < this->size) {
+                std::cout << ",";
+            }
+            std::cout << std::endl;
+        }
+    }
+    std::cout << "]" << std::endl;
+}
+
+#endif
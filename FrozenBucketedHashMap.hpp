@@ -0,0 +1,408 @@
+#ifndef FROZEN_BUCKETED_HASH_MAP_HPP
+#define FROZEN_BUCKETED_HASH_MAP_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include "BucketedHash.hpp"
+#include "MapNode.hpp"
+
+template <class K, class V>
+/**
+ * @brief An immutable map built once by BucketedHashMap::freeze(), for data
+ * that is loaded and then only read. Its entries lie in one contiguous array
+ * with no empty slot, indexed by a minimal perfect hash function in the
+ * style of PTHash: keys are split into small buckets (60% of the keys into
+ * 30% of the buckets, so the large buckets are placed while the table is
+ * still empty), and each bucket stores the 16 bit pilot that moves all its
+ * keys onto free slots of a table 2% larger than the key count. The few keys
+ * landing past the end are then remapped into the holes left below it.
+ * A lookup is one hash, two small array reads, one entry access and one key
+ * compare, with no chain walk and no division. The function costs under
+ * 5 bits per key on top of the entries at a million keys, a little more for
+ * smaller maps.
+ *
+ * @author Jonathan Ung
+ */
+class FrozenBucketedHashMap {
+    public:
+        /**
+         * @brief A key and its value, stored side by side.
+         */
+        struct Entry {
+            K key;
+            V value;
+        };
+
+    private:
+        static const uint16_t kMaxPilot = 0xFFFF;
+        static const int kMaxAttempts = 16;
+        uint64_t seed;
+        size_t tableSize;
+        uint32_t skewedBuckets;
+        uint32_t bucketCount;
+        std::vector<uint16_t> pilots;
+        std::vector<uint32_t> remap;
+        std::vector<Entry> entries;
+        static uint64_t mix(uint64_t);
+        static size_t fastRange(uint64_t, size_t);
+        size_t bucketOf(uint64_t) const;
+        size_t positionOf(uint64_t, uint16_t) const;
+        size_t slotOf(uint64_t) const;
+        bool build(const std::vector<uint64_t> &, std::vector<size_t> &);
+        template <class Q>
+        const Entry *findEntry(const Q &) const;
+
+    public:
+        FrozenBucketedHashMap();
+        FrozenBucketedHashMap(const std::vector<const MapNode<K, V> *> &, uint64_t);
+        template <class Q>
+        const V &get(const Q &) const;
+        template <class Q>
+        bool containsKey(const Q &) const;
+        int getSize() const;
+        bool isEmpty() const;
+        const Entry *begin() const;
+        const Entry *end() const;
+        size_t hashFunctionBytes() const;
+        uint64_t getSeed() const;
+};
+
+template <class K, class V>
+/**
+ * @brief Construct a new empty FrozenBucketedHashMap object
+ */
+FrozenBucketedHashMap<K,V>::FrozenBucketedHashMap() : seed(0), tableSize(0), skewedBuckets(0), bucketCount(0) {}
+
+template <class K, class V>
+/**
+ * @brief Builds the map from distinct MapNodes, such as the nodes of a
+ * BucketedHashMap, reusing their cached hashes when the seed they were
+ * hashed with separates them. Otherwise, e.g. when two keys have
+ * equal 64 bit hashes, the keys are rehashed with a new seed and the build
+ * retried.
+ *
+ * @param nodes
+ * @param seed the seed the cached hashes were computed with
+ * @throws std::invalid_argument if the keys cannot be told apart by any seed,
+ * i.e. some have an equal BucketedHash, or there are 2^32 or more of them.
+ */
+FrozenBucketedHashMap<K,V>::FrozenBucketedHashMap(const std::vector<const MapNode<K, V> *> &nodes, uint64_t seed) : seed(seed), tableSize(0), skewedBuckets(0), bucketCount(0) {
+    std::vector<uint64_t> hashes = std::vector<uint64_t>();
+    hashes.reserve(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        hashes.push_back((uint64_t)nodes[i]->hash);
+    }
+    if (nodes.size() >= ((size_t)1 << 32)) {
+        throw std::invalid_argument("Too many keys to freeze");
+    }
+    if (nodes.empty()) {
+        return;
+    }
+    std::vector<size_t> slots = std::vector<size_t>();
+    for (int attempt = 0; !this->build(hashes, slots); attempt++) {
+        if (attempt + 1 == kMaxAttempts) {
+            throw std::invalid_argument("Keys of equal hash cannot be frozen");
+        }
+        this->seed = randomHashSeed();
+        for (size_t i = 0; i < nodes.size(); i++) {
+            hashes[i] = (uint64_t)hashKey<K>(nodes[i]->key, this->seed);
+        }
+    }
+    std::vector<const MapNode<K, V> *> atSlot = std::vector<const MapNode<K, V> *>(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        atSlot[slots[i]] = nodes[i];
+    }
+    this->entries.reserve(nodes.size());
+    for (size_t i = 0; i < atSlot.size(); i++) {
+        this->entries.push_back(Entry{atSlot[i]->key, atSlot[i]->value});
+    }
+}
+
+template <class K, class V>
+/**
+ * @brief Scrambles the bits of a hash (the murmur3 finalizer).
+ *
+ * @param x
+ * @return uint64_t
+ */
+uint64_t FrozenBucketedHashMap<K,V>::mix(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDULL;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ULL;
+    return x ^ (x >> 33);
+}
+
+template <class K, class V>
+/**
+ * @brief Maps a uniform 64 bit value onto [0, n) with a multiply instead of
+ * a division.
+ *
+ * @param x
+ * @param n
+ * @return size_t
+ */
+size_t FrozenBucketedHashMap<K,V>::fastRange(uint64_t x, size_t n) {
+#if defined(__SIZEOF_INT128__)
+    return (size_t)(((unsigned __int128)x * n) >> 64);
+#else
+    return (size_t)(x % n);
+#endif
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the bucket of a hash: the low 32 bits choose between the
+ * dense first 30% of the buckets (60% of the keys) and the rest, the high
+ * 32 bits the bucket within them.
+ *
+ * @param hash
+ * @return size_t
+ */
+size_t FrozenBucketedHashMap<K,V>::bucketOf(uint64_t hash) const {
+    uint64_t high = hash >> 32;
+    if ((uint32_t)hash < 0x9999999AU) {
+        return (size_t)((high * this->skewedBuckets) >> 32);
+    }
+    return this->skewedBuckets + (size_t)((high * (this->bucketCount - this->skewedBuckets)) >> 32);
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the table position a pilot moves a hash to.
+ *
+ * @param hash
+ * @param pilot
+ * @return size_t
+ */
+size_t FrozenBucketedHashMap<K,V>::positionOf(uint64_t hash, uint16_t pilot) const {
+    return fastRange(mix(hash + pilot * 0x9E3779B97F4A7C15ULL), this->tableSize);
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the entry slot of a hash.
+ *
+ * @param hash
+ * @return size_t
+ */
+size_t FrozenBucketedHashMap<K,V>::slotOf(uint64_t hash) const {
+    size_t position = this->positionOf(hash, this->pilots[this->bucketOf(hash)]);
+    return position < this->entries.size() ? position : this->remap[position - this->entries.size()];
+}
+
+template <class K, class V>
+/**
+ * @brief Searches a pilot for every bucket, largest buckets first, then
+ * remaps the positions past the key count onto the free slots below it.
+ *
+ * @param hashes the hash of every key
+ * @param slots set to the entry slot of every key
+ * @return true on success
+ * @return false if two keys of a bucket have an equal hash or a bucket has
+ * no pilot that places it, in which case the seed must change
+ */
+bool FrozenBucketedHashMap<K,V>::build(const std::vector<uint64_t> &hashes, std::vector<size_t> &slots) {
+    size_t n = hashes.size();
+    double log2n = std::max(1.0, std::log2((double)n));
+    this->bucketCount = (uint32_t)std::max<size_t>(2, (size_t)std::ceil(5.0 * n / log2n));
+    this->skewedBuckets = std::max<uint32_t>(1, (uint32_t)(this->bucketCount * 0.3));
+    this->tableSize = std::max(n, (size_t)std::ceil(n / 0.98));
+    std::vector<size_t> starts = std::vector<size_t>(this->bucketCount + 1, 0);
+    for (size_t i = 0; i < n; i++) {
+        starts[this->bucketOf(hashes[i]) + 1]++;
+    }
+    size_t largest = 0;
+    for (size_t b = 0; b < this->bucketCount; b++) {
+        largest = std::max(largest, starts[b + 1]);
+        starts[b + 1] += starts[b];
+    }
+    std::vector<size_t> members = std::vector<size_t>(n);
+    std::vector<size_t> fill = std::vector<size_t>(starts.begin(), starts.end() - 1);
+    for (size_t i = 0; i < n; i++) {
+        members[fill[this->bucketOf(hashes[i])]++] = i;
+    }
+    std::vector<uint32_t> bySize = std::vector<uint32_t>(this->bucketCount);
+    std::vector<size_t> sizeStarts = std::vector<size_t>(largest + 2, 0);
+    for (size_t b = 0; b < this->bucketCount; b++) {
+        sizeStarts[largest - (starts[b + 1] - starts[b]) + 1]++;
+    }
+    for (size_t s = 0; s <= largest; s++) {
+        sizeStarts[s + 1] += sizeStarts[s];
+    }
+    for (size_t b = 0; b < this->bucketCount; b++) {
+        bySize[sizeStarts[largest - (starts[b + 1] - starts[b])]++] = (uint32_t)b;
+    }
+    this->pilots.assign(this->bucketCount, 0);
+    std::vector<char> taken = std::vector<char>(this->tableSize, 0);
+    std::vector<size_t> positions = std::vector<size_t>(this->tableSize, 0);
+    std::vector<uint64_t> bucketHashes = std::vector<uint64_t>();
+    for (size_t k = 0; k < bySize.size(); k++) {
+        size_t b = bySize[k];
+        size_t begin = starts[b];
+        size_t end = starts[b + 1];
+        if (begin == end) {
+            break;
+        }
+        bucketHashes.clear();
+        for (size_t i = begin; i < end; i++) {
+            bucketHashes.push_back(hashes[members[i]]);
+        }
+        std::sort(bucketHashes.begin(), bucketHashes.end());
+        if (std::adjacent_find(bucketHashes.begin(), bucketHashes.end()) != bucketHashes.end()) {
+            return false;
+        }
+        bool placed = false;
+        for (uint32_t pilot = 0; pilot <= kMaxPilot && !placed; pilot++) {
+            placed = true;
+            for (size_t i = begin; i < end; i++) {
+                size_t position = this->positionOf(hashes[members[i]], (uint16_t)pilot);
+                if (taken[position]) {
+                    for (size_t j = begin; j < i; j++) {
+                        taken[positions[members[j]]] = 0;
+                    }
+                    placed = false;
+                    break;
+                }
+                taken[position] = 1;
+                positions[members[i]] = position;
+            }
+            if (placed) {
+                this->pilots[b] = (uint16_t)pilot;
+            }
+        }
+        if (!placed) {
+            return false;
+        }
+    }
+    this->remap.assign(this->tableSize - n, 0);
+    size_t hole = 0;
+    for (size_t position = n; position < this->tableSize; position++) {
+        if (taken[position]) {
+            while (taken[hole]) {
+                hole++;
+            }
+            this->remap[position - n] = (uint32_t)hole++;
+        }
+    }
+    slots.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        slots[i] = positions[i] < n ? positions[i] : this->remap[positions[i] - n];
+    }
+    return true;
+}
+
+template <class K, class V>
+template <class Q>
+/**
+ * @brief Returns the entry of a key, or nullptr. Every hash leads to some
+ * entry, so a missing key costs the same single compare as a present one.
+ *
+ * @param key
+ * @return const Entry*
+ */
+const typename FrozenBucketedHashMap<K,V>::Entry *FrozenBucketedHashMap<K,V>::findEntry(const Q &key) const {
+    if (this->entries.empty()) {
+        return nullptr;
+    }
+    const Entry &entry = this->entries[this->slotOf((uint64_t)hashKey<K>(key, this->seed))];
+    return entry.key == key ? &entry : nullptr;
+}
+
+template <class K, class V>
+template <class Q>
+/**
+ * @brief Returns the value of a key.
+ *
+ * @param key
+ * @return const V&
+ * @throws std::invalid_argument if the key is not in the map.
+ */
+const V &FrozenBucketedHashMap<K,V>::get(const Q &key) const {
+    const Entry *entry = this->findEntry(key);
+    if (!entry) {
+        throw std::invalid_argument("Key not found");
+    }
+    return entry->value;
+}
+
+template <class K, class V>
+template <class Q>
+/**
+ * @brief Checks if a key is in the map.
+ *
+ * @param key
+ * @return true
+ * @return false
+ */
+bool FrozenBucketedHashMap<K,V>::containsKey(const Q &key) const {
+    return this->findEntry(key) != nullptr;
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the number of entries.
+ *
+ * @return int
+ */
+int FrozenBucketedHashMap<K,V>::getSize() const {
+    return (int)this->entries.size();
+}
+
+template <class K, class V>
+/**
+ * @brief Checks if the map has no entries.
+ *
+ * @return true
+ * @return false
+ */
+bool FrozenBucketedHashMap<K,V>::isEmpty() const {
+    return this->entries.empty();
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the first entry, in slot order.
+ *
+ * @return const Entry*
+ */
+const typename FrozenBucketedHashMap<K,V>::Entry *FrozenBucketedHashMap<K,V>::begin() const {
+    return this->entries.data();
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the past-the-end entry.
+ *
+ * @return const Entry*
+ */
+const typename FrozenBucketedHashMap<K,V>::Entry *FrozenBucketedHashMap<K,V>::end() const {
+    return this->entries.data() + this->entries.size();
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the bytes taken by the hash function, the pilots and the
+ * remapped positions, not counting the entries.
+ *
+ * @return size_t
+ */
+size_t FrozenBucketedHashMap<K,V>::hashFunctionBytes() const {
+    return this->pilots.size() * sizeof(uint16_t) + this->remap.size() * sizeof(uint32_t);
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the seed the keys are hashed with, which is the seed of the
+ * map frozen unless that seed could not separate them.
+ *
+ * @return uint64_t
+ */
+uint64_t FrozenBucketedHashMap<K,V>::getSeed() const {
+    return this->seed;
+}
+
+#endif
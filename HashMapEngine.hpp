@@ -0,0 +1,41 @@
+#ifndef HASH_MAP_ENGINE_HPP
+#define HASH_MAP_ENGINE_HPP
+
+#include "BucketedHashMap.hpp"
+#include "FlatHashMap.hpp"
+#include "UnrolledBucketedHashMap.hpp"
+
+/**
+ * @brief Storage engine tag for BucketedHashMap, which chains colliding keys in KVList buckets.
+ */
+struct ChainedEngine {
+    template <class K, class V>
+    using map = BucketedHashMap<K, V>;
+};
+
+/**
+ * @brief Storage engine tag for FlatHashMap, which stores entries flat and probes SIMD control groups.
+ */
+struct FlatEngine {
+    template <class K, class V>
+    using map = FlatHashMap<K, V>;
+};
+
+/**
+ * @brief Storage engine tag for UnrolledBucketedHashMap, which stores a few entries inline in each bucket.
+ */
+struct UnrolledEngine {
+    template <class K, class V>
+    using map = UnrolledBucketedHashMap<K, V>;
+};
+
+/**
+ * @brief Hash map whose storage engine is picked by a template parameter, so
+ * the same code can be built against either engine, e.g.
+ * EngineHashMap<std::string, int, FlatEngine>. All engines share insert, get,
+ * operator[], remove, containsKey, getSize, isEmpty, clear and show.
+ */
+template <class K, class V, class Engine = ChainedEngine>
+using EngineHashMap = typename Engine::template map<K, V>;
+
+#endif
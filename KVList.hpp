@@ -1,39 +1,94 @@
 #ifndef KV_LIST_HPP
 #define KV_LIST_HPP
 
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <utility>
 #include <vector>
 #include "MapNode.hpp"
+#include "NodePool.hpp"
+#include "BucketedHash.hpp"
+#include "ReorderPolicy.hpp"
+#include "ChainTree.hpp"
 
 template <class K, class V>
 /**
  * @brief KVList class, a class using a linked list to store key-value pairs
  * 
  * @param size
+ * @param fingerprint a 32 bit filter with the bit fingerprintBit() picks
+ * from the hash of each node set, so a lookup whose bit is clear misses
+ * without touching a node. It shares the word size used to take and keeps
+ * the list at 32 bytes. The list only clears, copies and moves it: an owner
+ * filtering its lookups sets bits with addFingerprint() and calls
+ * refingerprint() after an unlink, so lists of other owners pay nothing.
+ * Exact while the list is not treeified; removals from a treeified list may
+ * leave stale bits, which only cost a wasted walk.
  * @param *head
+ * @param *pool the pool nodes are drawn from, or nullptr to use new/delete
+ * @param tree a ChainTree over the nodes, kept exactly while the list is
+ * longer than kTreeifyThreshold, so even a bucket every key collides into is
+ * searched in O(log n). Lookups walk the first kTreeifyThreshold nodes before
+ * turning to the tree, which keeps short lists from ever touching it.
  */
 class KVList {
     private:
-        size_t size;
+        uint32_t size;
+        uint32_t fingerprint;
         MapNode<K, V> *head;
+        NodePool<K, V> *pool;
+        std::unique_ptr<ChainTree<K, V>> tree;
+        static const size_t kTreeifyThreshold = 8;
+        template <class... Args>
+        MapNode<K, V>* newNode(Args &&...);
+        void deleteNode(MapNode<K, V> *);
+        void linkFront(MapNode<K, V> *);
+        void treeifyIfLong();
+        void linkedLong(MapNode<K, V> *);
+        static uint32_t fingerprintBit(size_t);
+        template <class KK, class... Args>
+        std::pair<MapNode<K,V>*, bool> emplaceInTree(size_t, KK &&, Args &&...);
 
     public:
         KVList(); 
+        KVList(NodePool<K, V> *); 
         KVList(const KVList &); 
-        KVList(KVList &&); 
+        KVList(KVList &&) noexcept; 
         ~KVList(); 
-        V& get(const K) const;
-        bool has(const K) const;
+        template <class Q>
+        MapNode<K,V>* find(const Q &, size_t) const;
+        template <class Policy, class Q>
+        MapNode<K,V>* findAndPromote(const Q &, size_t);
+        V& get(const K &) const;
+        template <class Q>
+        V& get(const Q &, size_t) const;
+        bool has(const K &) const;
+        template <class Q>
+        bool has(const Q &, size_t) const;
         bool hasValue(const V) const;
-        int update(const K, const V);
-        V remove(const K); 
+        int update(const K &, const V &);
+        int update(const K &, const V &, size_t);
+        template <class KK, class... Args>
+        std::pair<MapNode<K,V>*, bool> tryEmplace(size_t, KK &&, Args &&...);
+        template <class KK, class VV>
+        std::pair<MapNode<K,V>*, bool> insertOrAssign(size_t, KK &&, VV &&);
+        V remove(const K &); 
+        V remove(const K &, size_t); 
+        MapNode<K,V>* unlink(const K &, size_t);
         void clear(); 
         int getSize() const; 
         MapNode<K,V>* begin() const;
+        MapNode<K,V>* release();
+        void push(MapNode<K,V> *);
         bool isEmpty() const;
+        bool isTreeified() const;
+        bool mayContain(size_t) const;
+        void addFingerprint(size_t);
+        void refingerprint();
         std::vector<K> getKeys() const;
         std::vector<V> getValues() const;
-        V& operator[](const K) const;
+        V& operator[](const K &) const;
         void show() const;
         template <class T, class U>
         friend std::ostream &operator<<(std::ostream &, KVList<T, U> &);
@@ -60,29 +115,47 @@ template <class K, class V>
  */
 KVList<K, V>::KVList() {
     this->size = 0;
+    this->fingerprint = 0;
     this->head = nullptr;
+    this->pool = nullptr;
 }
 
 template <class K, class V>
 /**
- * @brief Copy constructor for a KVList object.
+ * @brief Constructor for a KVList object drawing its nodes from a pool.
+ * 
+ * @param pool 
+ */
+KVList<K, V>::KVList(NodePool<K, V> *pool) {
+    this->size = 0;
+    this->fingerprint = 0;
+    this->head = nullptr;
+    this->pool = pool;
+}
+
+template <class K, class V>
+/**
+ * @brief Copy constructor for a KVList object. The copy draws from the same pool as other.
  * 
  * @param other, a const reference to a KVList object.
  */
 KVList<K, V>::KVList(const KVList &other) {
+    this->pool = other.pool;
     this->size = other.size;
+    this->fingerprint = other.fingerprint;
     if (other.begin()) {
-        this->head = new MapNode<K, V>(other.head->key, other.head->value);
+        this->head = this->newNode(other.head->hash, other.head->key, other.head->value);
         MapNode<K, V> *tmp = this->head;
         MapNode<K, V> *tmp2 = other.begin();
         while (tmp2->next) {
-            tmp->next = new MapNode<K, V>(tmp2->next->key, tmp2->next->value);
+            tmp->next = this->newNode(tmp2->next->hash, tmp2->next->key, tmp2->next->value);
             tmp = tmp->next;
             tmp2 = tmp2->next;
         }
     } else {
         this->head = nullptr;
     }
+    this->treeifyIfLong();
 }
 
 template <class K, class V>
@@ -91,11 +164,113 @@ template <class K, class V>
  * 
  * @param other&&, an rvalue reference to a KVList object.
  */
-KVList<K, V>::KVList(KVList &&other) {
+KVList<K, V>::KVList(KVList &&other) noexcept {
+    this->pool = other.pool;
     this->head = other.head;
     this->size = other.size;
+    this->fingerprint = other.fingerprint;
+    this->tree = std::move(other.tree);
     other.head = nullptr;
     other.size = 0;
+    other.fingerprint = 0;
+}
+
+template <class K, class V>
+template <class... Args>
+/**
+ * @brief Creates a node from the pool, or with new when the list has no pool.
+ * 
+ * @param args the MapNode constructor arguments
+ * @return MapNode<K,V>* 
+ */
+MapNode<K,V>* KVList<K,V>::newNode(Args &&...args) {
+    if (this->pool) {
+        return this->pool->create(std::forward<Args>(args)...);
+    }
+    return new MapNode<K, V>(std::forward<Args>(args)...);
+}
+
+template <class K, class V>
+/**
+ * @brief Destroys a node created by newNode.
+ * 
+ * @param mN 
+ */
+void KVList<K,V>::deleteNode(MapNode<K,V> *mN) {
+    if (this->pool) {
+        this->pool->destroy(mN);
+    } else {
+        delete mN;
+    }
+}
+
+template <class K, class V>
+/**
+ * @brief Links a node whose key is not in the list yet in as the new head.
+ * Lists already at kTreeifyThreshold nodes go on in linkedLong.
+ * 
+ * @param mN 
+ */
+void KVList<K,V>::linkFront(MapNode<K,V> *mN) {
+    mN->next = this->head;
+    this->head = mN;
+    if (this->size++ >= kTreeifyThreshold) {
+        this->linkedLong(mN);
+    }
+}
+
+template <class K, class V>
+/**
+ * @brief Adds a node just linked in at the head of a long list to its tree,
+ * building the tree if the list has just grown past kTreeifyThreshold.
+ * 
+ * @param mN 
+ */
+CHAIN_TREE_COLD void KVList<K,V>::linkedLong(MapNode<K,V> *mN) {
+    if (this->tree) {
+        this->tree->pushFront(mN, mN->next);
+    } else {
+        this->treeifyIfLong();
+    }
+}
+
+template <class K, class V>
+/**
+ * @brief Builds the tree once the list is longer than kTreeifyThreshold.
+ */
+void KVList<K,V>::treeifyIfLong() {
+    if (this->size > kTreeifyThreshold && !this->tree) {
+        this->tree = std::unique_ptr<ChainTree<K, V>>(new ChainTree<K, V>(this->head));
+    }
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the fingerprint bit of a hash: the top 5 bits of a multiply
+ * by a constant other than the one PowerOfTwoCapacity picks buckets with, so
+ * the keys sharing a bucket still spread over all 32 bits.
+ * 
+ * @param hash 
+ * @return uint32_t 
+ */
+inline uint32_t KVList<K,V>::fingerprintBit(size_t hash) {
+    return (uint32_t)1 << (((uint64_t)hash * 0xD6E8FEB86659FD93ULL) >> 59);
+}
+
+template <class K, class V>
+/**
+ * @brief Rebuilds the fingerprint from the nodes after one was unlinked.
+ * A treeified list keeps its bits rather than walk every node, until an
+ * unlink brings it back to kTreeifyThreshold nodes.
+ */
+void KVList<K,V>::refingerprint() {
+    if (this->tree) {
+        return;
+    }
+    this->fingerprint = 0;
+    for (MapNode<K, V> *tmp = this->head; tmp; tmp = tmp->next) {
+        this->fingerprint |= fingerprintBit(tmp->hash);
+    }
 }
 
 template <class K, class V>
@@ -105,50 +280,126 @@ template <class K, class V>
 KVList<K,V>::~KVList() {
     while (this->head) {
         MapNode<K, V> *tmp = this->head->next;
-        delete this->head;
+        this->deleteNode(this->head);
         this->head = tmp;
     }
 }
 
-template <class K,class V>
+template <class K, class V>
+template <class Q>
 /**
- * @brief KVList function to get a value given a key.
+ * @brief KVList function to find the node of a key. The cached hash of every
+ * node is compared first so that keys are only compared on a hash match.
+ * The key can be of any type comparable with K, e.g. a std::string_view
+ * looked up in a list of std::string keys, and is never copied.
  * 
  * @param key 
- * @return V& 
- * @throws std::invalid_argument if the key is not found.
+ * @param hash BucketedHash<K> of the key
+ * @return MapNode<K,V>* the node, or nullptr if the key is not found.
  */
-V& KVList<K,V>::get(const K key) const{
+MapNode<K,V>* KVList<K,V>::find(const Q &key, size_t hash) const{
     MapNode<K, V> *tmp = this->head;
+    size_t visited = 0;
     while (tmp)
     {
-        if (key == tmp->key) {
-            return tmp->value;
+        if (hash == tmp->hash && key == tmp->key) {
+            return tmp;
         }
         tmp = tmp->next;
+        if (++visited == kTreeifyThreshold && tmp) {
+            return this->tree->find(key, hash);
+        }
     }
-    
-    throw std::invalid_argument("Key not found");
+    return nullptr;
 }
 
 template <class K, class V>
+template <class Policy, class Q>
 /**
- * @brief KVList function to check if a key exists in the map.
+ * @brief KVList function to find the node of a key like find, then let the
+ * reorder policy move it towards the head of the list so that popular keys
+ * are found after fewer nodes. Nodes are only relinked, never moved, so
+ * pointers to nodes and values stay valid. Treeified lists are not reordered.
  * 
+ * @tparam Policy NoReorder, MoveToFront or Transpose
  * @param key 
- * @return true 
- * @return false 
+ * @param hash BucketedHash<K> of the key
+ * @return MapNode<K,V>* the node, or nullptr if the key is not found.
  */
-bool KVList<K,V>::has(const K key) const{
+MapNode<K,V>* KVList<K,V>::findAndPromote(const Q &key, size_t hash) {
+    if (this->tree) {
+        return this->tree->find(key, hash);
+    }
+    MapNode<K, V> *prevPrev = nullptr;
+    MapNode<K, V> *prev = nullptr;
     MapNode<K, V> *tmp = this->head;
     while (tmp)
     {
-        if (key == tmp->key) {
-            return true;
+        if (hash == tmp->hash && key == tmp->key) {
+            Policy::promote(this->head, prevPrev, prev, tmp);
+            return tmp;
         }
+        prevPrev = prev;
+        prev = tmp;
         tmp = tmp->next;
     }
-    return false;
+    return nullptr;
+}
+
+template <class K,class V>
+/**
+ * @brief KVList function to get a value given a key.
+ * 
+ * @param key 
+ * @return V& 
+ * @throws std::invalid_argument if the key is not found.
+ */
+V& KVList<K,V>::get(const K &key) const{
+    return this->get(key, BucketedHash<K>()(key));
+}
+
+template <class K,class V>
+template <class Q>
+/**
+ * @brief KVList function to get a value given a key and its hash.
+ * 
+ * @param key 
+ * @param hash 
+ * @return V& 
+ * @throws std::invalid_argument if the key is not found.
+ */
+V& KVList<K,V>::get(const Q &key, size_t hash) const{
+    MapNode<K, V> *tmp = this->find(key, hash);
+    if (tmp) {
+        return tmp->value;
+    }
+    throw std::invalid_argument("Key not found");
+}
+
+template <class K, class V>
+/**
+ * @brief KVList function to check if a key exists in the map.
+ * 
+ * @param key 
+ * @return true 
+ * @return false 
+ */
+bool KVList<K,V>::has(const K &key) const{
+    return this->has(key, BucketedHash<K>()(key));
+}
+
+template <class K, class V>
+template <class Q>
+/**
+ * @brief KVList function to check if a key exists in the map given its hash.
+ * 
+ * @param key 
+ * @param hash 
+ * @return true 
+ * @return false 
+ */
+bool KVList<K,V>::has(const Q &key, size_t hash) const{
+    return this->find(key, hash) != nullptr;
 }
 
 template <class K, class V>
@@ -179,59 +430,195 @@ template <class K, class V>
  * @param value 
  * @return MapNode<K,V>* 
  */
-int KVList<K,V>::update(const K key, const  V value){
+int KVList<K,V>::update(const K &key, const V &value){
+    return this->update(key, value, BucketedHash<K>()(key));
+}
+
+template <class K, class V>
+/**
+ * @brief KVList function to update a MapNode given a key and its hash.
+ * 
+ * @param key 
+ * @param value 
+ * @param hash 
+ * @return int 1 if a node was added, 0 if an existing value was overwritten
+ */
+int KVList<K,V>::update(const K &key, const V &value, size_t hash){
+    if (this->tree) {
+        MapNode<K, V> *tmp = this->tree->find(key, hash);
+        if (tmp) {
+            tmp->value = value;
+            return 0;
+        }
+        this->linkFront(this->newNode(hash, key, value));
+        return 1;
+    }
     if (this->head) {
         MapNode<K, V> *tmp = head;
         while (tmp) {
-            if (key == tmp->key) {
+            if (hash == tmp->hash && key == tmp->key) {
                 tmp->value = value;
                 return 0;
             } else if (tmp->next) {
                 tmp = tmp->next;
             } else
             {
-                MapNode<K,V> *n = new MapNode<K, V>(key, value);
+                MapNode<K,V> *n = this->newNode(hash, key, value);
                 tmp->next = n;
                 this->size++;
+                this->treeifyIfLong();
                 return 1;
             }
         }
     }
-    MapNode<K, V> *n = new MapNode<K, V>(key, value);
+    MapNode<K, V> *n = this->newNode(hash, key, value);
     this->head = n;
     this->size++;
     return 1;
 }
 
+template <class K, class V>
+template <class KK, class... Args>
+/**
+ * @brief KVList function to add a node for a key unless it is already
+ * present. The node is constructed in place from the forwarded key and
+ * value arguments, and nothing is constructed if the key exists.
+ * 
+ * @param hash 
+ * @param key 
+ * @param args the arguments of the value's constructor
+ * @return std::pair<MapNode<K,V>*, bool> the node of the key and whether it was added
+ */
+std::pair<MapNode<K,V>*, bool> KVList<K,V>::tryEmplace(size_t hash, KK &&key, Args &&...args){
+    MapNode<K, V> *tmp = this->head;
+    size_t visited = 0;
+    while (tmp) {
+        if (hash == tmp->hash && key == tmp->key) {
+            return std::pair<MapNode<K,V>*, bool>(tmp, false);
+        } else if (!tmp->next) {
+            break;
+        } else if (++visited == kTreeifyThreshold) {
+            return this->emplaceInTree(hash, std::forward<KK>(key), std::forward<Args>(args)...);
+        }
+        tmp = tmp->next;
+    }
+    MapNode<K, V> *n = this->newNode(std::piecewise_construct, hash, std::forward<KK>(key), std::forward<Args>(args)...);
+    if (tmp) {
+        tmp->next = n;
+    } else {
+        this->head = n;
+    }
+    this->size++;
+    this->treeifyIfLong();
+    return std::pair<MapNode<K,V>*, bool>(n, true);
+}
+
+template <class K, class V>
+template <class KK, class... Args>
+/**
+ * @brief tryEmplace for a treeified list: the key is looked up in the tree
+ * and a new node is linked in at the head.
+ * 
+ * @param hash 
+ * @param key 
+ * @param args the arguments of the value's constructor
+ * @return std::pair<MapNode<K,V>*, bool> the node of the key and whether it was added
+ */
+std::pair<MapNode<K,V>*, bool> KVList<K,V>::emplaceInTree(size_t hash, KK &&key, Args &&...args){
+    MapNode<K, V> *tmp = this->tree->find(key, hash);
+    if (tmp) {
+        return std::pair<MapNode<K,V>*, bool>(tmp, false);
+    }
+    MapNode<K, V> *n = this->newNode(std::piecewise_construct, hash, std::forward<KK>(key), std::forward<Args>(args)...);
+    this->linkFront(n);
+    return std::pair<MapNode<K,V>*, bool>(n, true);
+}
+
+template <class K, class V>
+template <class KK, class VV>
+/**
+ * @brief KVList function to add a node for a key, or to assign the value of
+ * the existing one. The value is forwarded, so rvalues are moved in.
+ * 
+ * @param hash 
+ * @param key 
+ * @param value 
+ * @return std::pair<MapNode<K,V>*, bool> the node of the key and whether it was added
+ */
+std::pair<MapNode<K,V>*, bool> KVList<K,V>::insertOrAssign(size_t hash, KK &&key, VV &&value){
+    MapNode<K, V> *tmp = this->find(key, hash);
+    if (tmp) {
+        tmp->value = std::forward<VV>(value);
+        return std::pair<MapNode<K,V>*, bool>(tmp, false);
+    }
+    return this->tryEmplace(hash, std::forward<KK>(key), std::forward<VV>(value));
+}
+
 template <class K, class V>
 /**
  * @brief KVList function to remove a MapNode given a key.
  * 
  * @param key 
- * @return MapNode<K,V>* 
+ * @return V 
  */
-V KVList<K,V>::remove(const K key) {
-    MapNode<K,V> *tmp = this->head;
-    if (tmp && tmp->next) {
-        if (tmp->key == key) {
-            this->head = tmp->next;
+V KVList<K,V>::remove(const K &key) {
+    return this->remove(key, BucketedHash<K>()(key));
+}
+
+template <class K, class V>
+/**
+ * @brief KVList function to remove a MapNode given a key and its hash.
+ * 
+ * @param key 
+ * @param hash 
+ * @return V 
+ */
+V KVList<K,V>::remove(const K &key, size_t hash) {
+    MapNode<K, V> *n = this->unlink(key, hash);
+    if (!n) {
+        throw std::invalid_argument("No key found.");
+    }
+    V res = std::move(n->value);
+    this->deleteNode(n);
+    return res;
+}
+
+template <class K, class V>
+/**
+ * @brief Unlinks the MapNode of a key from the list without destroying it,
+ * handing it over to the caller.
+ * 
+ * @param key 
+ * @param hash 
+ * @return MapNode<K,V>* the node, or nullptr if the key is not in the list
+ */
+MapNode<K,V>* KVList<K,V>::unlink(const K &key, size_t hash) {
+    if (this->tree) {
+        MapNode<K, V> *n = this->tree->unlink(key, hash, this->head);
+        if (n) {
             this->size--;
-            V res = tmp->value;
-            delete tmp;
-            return res;
+            if (this->size == kTreeifyThreshold) {
+                this->tree.reset();
+            }
         }
+        return n;
     }
-    while (tmp->next){
-        if (tmp->next->key == key) {
+    MapNode<K,V> *tmp = this->head;
+    if (tmp && tmp->hash == hash && tmp->key == key) {
+        this->head = tmp->next;
+        this->size--;
+        return tmp;
+    }
+    while (tmp && tmp->next){
+        if (tmp->next->hash == hash && tmp->next->key == key) {
             MapNode<K, V> *n = tmp->next;
             tmp->next = tmp->next->next;
             this->size--;
-            V res = tmp->value;
-            delete n;
-            return res;
+            return n;
         }
+        tmp = tmp->next;
     }
-    throw std::invalid_argument("No key found.");
+    return nullptr;
 }
 
 template <class K, class V>
@@ -241,10 +628,12 @@ template <class K, class V>
 void KVList<K,V>::clear() {
     while (this->head) {
         MapNode<K, V> *tmp = this->head->next;
-        delete this->head;
+        this->deleteNode(this->head);
         this->head = tmp;
     }
     this->size = 0;
+    this->fingerprint = 0;
+    this->tree.reset();
 }
 
 template <class K, class V>
@@ -267,6 +656,33 @@ MapNode<K,V>* KVList<K,V>::begin() const {
     return this->head;
 }
 
+template <class K, class V>
+/**
+ * @brief Detaches the whole chain from the list without freeing any node.
+ * The caller takes ownership of the returned nodes.
+ * 
+ * @return MapNode<K,V>* the former head of the list
+ */
+MapNode<K,V>* KVList<K,V>::release() {
+    MapNode<K, V> *res = this->head;
+    this->head = nullptr;
+    this->size = 0;
+    this->fingerprint = 0;
+    this->tree.reset();
+    return res;
+}
+
+template <class K, class V>
+/**
+ * @brief Links an existing node at the head of the list. The list takes
+ * ownership of the node; the caller must make sure its key is not already present.
+ * 
+ * @param mN 
+ */
+void KVList<K,V>::push(MapNode<K,V> *mN) {
+    this->linkFront(mN);
+}
+
 template <class K, class V>
 /**
  * @brief Returns true if the List is empty.
@@ -278,6 +694,40 @@ bool KVList<K,V>::isEmpty() const{
     return this->head == nullptr;
 }
 
+template <class K, class V>
+/**
+ * @brief Returns true if the list is currently indexed by a ChainTree.
+ * 
+ * @return true 
+ * @return false 
+ */
+bool KVList<K,V>::isTreeified() const{
+    return this->tree != nullptr;
+}
+
+template <class K, class V>
+/**
+ * @brief Checks the fingerprint for a hash. False means no node of the list
+ * has it; true may still be a miss.
+ * 
+ * @param hash 
+ * @return true 
+ * @return false 
+ */
+bool KVList<K,V>::mayContain(size_t hash) const{
+    return (this->fingerprint & fingerprintBit(hash)) != 0;
+}
+
+template <class K, class V>
+/**
+ * @brief Sets the fingerprint bit of a hash, once a node of that hash is linked in.
+ * 
+ * @param hash 
+ */
+void KVList<K,V>::addFingerprint(size_t hash) {
+    this->fingerprint |= fingerprintBit(hash);
+}
+
 template <class K, class V>
 /**
  * @brief Returns all keys in the list.
@@ -320,7 +770,7 @@ template <class K,class V>
  * @return V& 
  * @throws std::invalid_argument if the key is not found.
  */
-V& KVList<K,V>::operator[](const K key) const{
+V& KVList<K,V>::operator[](const K &key) const{
     return this->get(key);
 }
 
@@ -374,18 +824,20 @@ KVList<K,V>& KVList<K,V>::operator=(const KVList<K,V>& other) {
     if (this != &other) {
         this->clear();
         this->size = other.size;
+        this->fingerprint = other.fingerprint;
         if (other.begin()) {
-            this->head = new MapNode<K, V>(other.head->key, other.head->value);
+            this->head = this->newNode(other.head->hash, other.head->key, other.head->value);
             MapNode<K, V> *tmp = this->head;
             MapNode<K, V> *tmp2 = other.begin();
             while (tmp2->next) {
-                tmp->next = new MapNode<K, V>(tmp2->next->key, tmp2->next->value);
+                tmp->next = this->newNode(tmp2->next->hash, tmp2->next->key, tmp2->next->value);
                 tmp = tmp->next;
                 tmp2 = tmp2->next;
             }
         } else {
             this->head = nullptr;
         }
+        this->treeifyIfLong();
     }
     return *this;
 }
@@ -400,10 +852,14 @@ template <class K, class V>
 KVList<K,V>& KVList<K,V>::operator=(KVList<K,V>&& other) {
     if (this != &other) {
         this->clear();
+        this->pool = other.pool;
         this->head = other.head;
         this->size = other.size;
+        this->fingerprint = other.fingerprint;
+        this->tree = std::move(other.tree);
         other.head = nullptr;
         other.size = 0;
+        other.fingerprint = 0;
     }
     return *this;
 }
@@ -419,8 +875,8 @@ template <class K, class V>
 KVList<K,V>& KVList<K,V>::operator+=(const KVList<K,V>& other) {
     MapNode<K, V> *tmp = other.begin();
     while (tmp) {
-        if (!this->has(tmp->key)){
-            this->update(tmp->key, tmp->value);
+        if (!this->has(tmp->key, tmp->hash)){
+            this->update(tmp->key, tmp->value, tmp->hash);
         }
         tmp = tmp->next;
     }
@@ -453,7 +909,7 @@ template <class K, class V>
 KVList<K,V>& KVList<K,V>::operator-=(const KVList<K,V>& other) {
     MapNode<K, V> *tmp = other.begin();
     while (tmp) {
-        this->remove(tmp->key);
+        this->remove(tmp->key, tmp->hash);
         tmp = tmp->next;
     }
     return *this;
@@ -485,8 +941,8 @@ template <class K, class V>
 KVList<K,V>& KVList<K,V>::operator*=(const KVList<K,V>& other){
     MapNode<K, V> *tmp = this->begin();
     while (tmp) {
-        if (!other.has(tmp->key)) {
-            this->remove(tmp->key);
+        if (!other.has(tmp->key, tmp->hash)) {
+            this->remove(tmp->key, tmp->hash);
         }
         tmp = tmp->next;
     }
@@ -521,9 +977,9 @@ bool operator==(const KVList<K,V>& m1, const KVList<K,V>& m2) {
     }
     MapNode<K, V> *tmp = m1.begin();
     while (tmp) {
-        if (!m2.has(tmp->key)) {
+        if (!m2.has(tmp->key, tmp->hash)) {
             return false;
-        } else if (m2.get(tmp->key) != tmp->value) {
+        } else if (m2.get(tmp->key, tmp->hash) != tmp->value) {
             return false;
         }
         tmp = tmp->next;
@@ -1,9 +1,14 @@
 #ifndef MAP_NODE_HPP
 #define MAP_NODE_HPP
 
+#include <iostream>
+#include <utility>
+
 template <class K, class V>
 /**
  * @brief A node class that stores key-value pairs and implements an std::cout function.
+ * Key and value are constructed directly from the constructor arguments, so
+ * neither needs to be default constructible or copyable.
  * 
  * @author Jonathan Ung
  */
@@ -12,8 +17,12 @@ class MapNode{
         K key;
         V value;
         MapNode *next;
+        size_t hash;
         MapNode(K, V);
         MapNode(K, V, MapNode *);
+        MapNode(size_t, K, V);
+        template <class KK, class... Args>
+        MapNode(std::piecewise_construct_t, size_t, KK &&, Args &&...);
         ~MapNode() {}
         template <class T, class U>
         friend std::ostream &operator<<(std::ostream &, const MapNode<T,U> &);
@@ -26,10 +35,9 @@ template <class K, class V>
  * @param k 
  * @param v 
  */
-MapNode<K,V>::MapNode(K k, V v) {
-    this->key = k;
-    this->value = v;
+MapNode<K,V>::MapNode(K k, V v) : key(std::move(k)), value(std::move(v)) {
     this->next = nullptr;
+    this->hash = 0;
 }
 
 template <class K, class V>
@@ -40,10 +48,37 @@ template <class K, class V>
  * @param v 
  * @param mN 
  */
-MapNode<K,V>::MapNode(K k, V v, MapNode* mN) {
-    this->key = k;
-    this->value = v;
+MapNode<K,V>::MapNode(K k, V v, MapNode* mN) : key(std::move(k)), value(std::move(v)) {
     this->next = mN;
+    this->hash = 0;
+}
+
+template <class K, class V>
+/**
+ * @brief Construct a new Map Node< K, V>:: Map Node object caching the hash of its key
+ * 
+ * @param h 
+ * @param k 
+ * @param v 
+ */
+MapNode<K,V>::MapNode(size_t h, K k, V v) : key(std::move(k)), value(std::move(v)) {
+    this->next = nullptr;
+    this->hash = h;
+}
+
+template <class K, class V>
+template <class KK, class... Args>
+/**
+ * @brief Construct a new Map Node< K, V>:: Map Node object in place, the key
+ * from k and the value from the remaining arguments, with no intermediate copy
+ * 
+ * @param h 
+ * @param k 
+ * @param args 
+ */
+MapNode<K,V>::MapNode(std::piecewise_construct_t, size_t h, KK &&k, Args &&...args) : key(std::forward<KK>(k)), value(std::forward<Args>(args)...) {
+    this->next = nullptr;
+    this->hash = h;
 }
 
 template <class K, class V>
@@ -54,8 +89,8 @@ template <class K, class V>
  * @param mN 
  * @return std::ostream& 
  */
-std::ostream& operator<<(std::ostream& o, MapNode<K,V> mN) {
-    o << "{K: " << mN->key << ", V: " << mN->value << "}";
+std::ostream& operator<<(std::ostream& o, const MapNode<K,V> &mN) {
+    o << "{K: " << mN.key << ", V: " << mN.value << "}";
     return o;
 }
 
@@ -0,0 +1,253 @@
+#ifndef MAPPED_BUCKETED_HASH_MAP_HPP
+#define MAPPED_BUCKETED_HASH_MAP_HPP
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "BucketedHash.hpp"
+#include "BucketedHashMapSnapshot.hpp"
+#include "CapacityPolicy.hpp"
+
+template <class K, class V>
+/**
+ * @brief A read-only map over a snapshot file written by
+ * BucketedHashMap::saveSnapshot(). The file is mapped into memory and
+ * lookups hash the key with the seed of the snapshot, then compare it against
+ * the entries of its bucket where they lie in the mapped pages, so opening
+ * costs no deserialization and pages are only read in as they are touched.
+ * Values are returned as a SnapshotCodec view (const V&, or a
+ * std::string_view for strings) into the mapping, valid for the life of the
+ * map. POSIX only.
+ *
+ * @author Jonathan Ung
+ */
+class MappedBucketedHashMap {
+    private:
+        void *mapping;
+        size_t mappedBytes;
+        SnapshotHeader header;
+        const uint64_t *offsets;
+        const char *entries;
+        template <class Q>
+        const char *findEntry(const Q &) const;
+        void unmap();
+
+    public:
+        typedef typename SnapshotCodec<V>::View ValueView;
+        MappedBucketedHashMap(const std::string &, bool verify = true);
+        MappedBucketedHashMap(const MappedBucketedHashMap &) = delete;
+        MappedBucketedHashMap &operator=(const MappedBucketedHashMap &) = delete;
+        MappedBucketedHashMap(MappedBucketedHashMap &&) noexcept;
+        MappedBucketedHashMap &operator=(MappedBucketedHashMap &&) noexcept;
+        ~MappedBucketedHashMap();
+        template <class Q>
+        ValueView get(const Q &) const;
+        template <class Q>
+        bool containsKey(const Q &) const;
+        int getSize() const;
+        bool isEmpty() const;
+};
+
+template <class K, class V>
+/**
+ * @brief Maps a snapshot file and checks that it was written for K and V by
+ * this version of the format.
+ *
+ * @param path
+ * @param verify whether to also checksum the whole body, which reads every
+ * page of the file up front. Either way the bucket offsets are checked to
+ * be aligned, in order and within the body, one pass over the offsets, and
+ * lookups check each entry against the end of its bucket, so a corrupted
+ * file never makes the map read outside the mapping.
+ * @throws std::invalid_argument if the file cannot be mapped, is not a
+ * snapshot of K and V, is truncated, has bad offsets or fails its checksum.
+ */
+MappedBucketedHashMap<K,V>::MappedBucketedHashMap(const std::string &path, bool verify) : mapping(nullptr), mappedBytes(0), header(), offsets(nullptr), entries(nullptr) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::invalid_argument("Could not open snapshot " + path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SnapshotHeader)) {
+        ::close(fd);
+        throw std::invalid_argument("Not a snapshot: " + path);
+    }
+    this->mappedBytes = (size_t)st.st_size;
+    void *mapped = ::mmap(nullptr, this->mappedBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        throw std::invalid_argument("Could not map snapshot " + path);
+    }
+    this->mapping = mapped;
+    std::memcpy(&this->header, mapped, sizeof(SnapshotHeader));
+    const SnapshotHeader &h = this->header;
+    const char *body = (const char *)mapped + sizeof(SnapshotHeader);
+    size_t bodyBytes = this->mappedBytes - sizeof(SnapshotHeader);
+    bool valid = std::memcmp(h.magic, kSnapshotMagic, 8) == 0 && h.version == kSnapshotVersion
+        && h.keyKind == SnapshotCodec<K>::kind && h.keySize == SnapshotCodec<K>::width
+        && h.valueKind == SnapshotCodec<V>::kind && h.valueSize == SnapshotCodec<V>::width
+        && h.bodyBytes == bodyBytes && h.buckets != 0 && (h.buckets & (h.buckets - 1)) == 0
+        && h.buckets < bodyBytes / 8;
+    if (valid) {
+        this->offsets = (const uint64_t *)body;
+        this->entries = body + (h.buckets + 1) * 8;
+        uint64_t entryBytes = bodyBytes - (h.buckets + 1) * 8;
+        valid = this->offsets[0] == 0 && this->offsets[h.buckets] == entryBytes;
+        for (uint64_t b = 0; valid && b < h.buckets; b++) {
+            valid = this->offsets[b + 1] >= this->offsets[b] && this->offsets[b + 1] <= entryBytes && this->offsets[b + 1] % 8 == 0;
+        }
+    }
+    if (valid && verify) {
+        SnapshotChecksum checksum = SnapshotChecksum();
+        checksum.add(body, bodyBytes & ~(size_t)7);
+        valid = checksum.state == h.checksum;
+    }
+    if (!valid) {
+        this->unmap();
+        throw std::invalid_argument("Not a valid snapshot of this map type: " + path);
+    }
+}
+
+template <class K, class V>
+/**
+ * @brief Move constructor, taking over the mapping of other.
+ *
+ * @param other
+ */
+MappedBucketedHashMap<K,V>::MappedBucketedHashMap(MappedBucketedHashMap &&other) noexcept : mapping(other.mapping), mappedBytes(other.mappedBytes), header(other.header), offsets(other.offsets), entries(other.entries) {
+    other.mapping = nullptr;
+    other.mappedBytes = 0;
+}
+
+template <class K, class V>
+/**
+ * @brief Move assignment, unmapping this map first.
+ *
+ * @param other
+ * @return MappedBucketedHashMap<K,V>&
+ */
+MappedBucketedHashMap<K,V> &MappedBucketedHashMap<K,V>::operator=(MappedBucketedHashMap &&other) noexcept {
+    if (this != &other) {
+        this->unmap();
+        this->mapping = other.mapping;
+        this->mappedBytes = other.mappedBytes;
+        this->header = other.header;
+        this->offsets = other.offsets;
+        this->entries = other.entries;
+        other.mapping = nullptr;
+        other.mappedBytes = 0;
+    }
+    return *this;
+}
+
+template <class K, class V>
+/**
+ * @brief Destroy the MappedBucketedHashMap object, unmapping the file.
+ */
+MappedBucketedHashMap<K,V>::~MappedBucketedHashMap() {
+    this->unmap();
+}
+
+template <class K, class V>
+/**
+ * @brief Unmaps the file, if mapped.
+ */
+void MappedBucketedHashMap<K,V>::unmap() {
+    if (this->mapping) {
+        ::munmap(this->mapping, this->mappedBytes);
+        this->mapping = nullptr;
+    }
+}
+
+template <class K, class V>
+template <class Q>
+/**
+ * @brief Returns the value of an entry's key in the mapping, or nullptr.
+ * The stored hash is compared before the key.
+ *
+ * @param key
+ * @return const char* the start of the entry's value
+ * @throws std::invalid_argument if an entry runs past the end of its bucket.
+ */
+const char *MappedBucketedHashMap<K,V>::findEntry(const Q &key) const {
+    size_t hash = hashKey<K>(key, this->header.seed);
+    size_t b = PowerOfTwoCapacity::indexOf(hash, (size_t)this->header.buckets);
+    const char *tmp = this->entries + this->offsets[b];
+    const char *end = this->entries + this->offsets[b + 1];
+    while (tmp < end) {
+        if ((size_t)(end - tmp) < 8 || !SnapshotCodec<K>::fits(tmp + 8, (size_t)(end - tmp) - 8)) {
+            throw std::invalid_argument("Corrupted snapshot entry");
+        }
+        uint64_t stored;
+        std::memcpy(&stored, tmp, 8);
+        const char *keyAt = tmp + 8;
+        const char *valueAt = keyAt + SnapshotCodec<K>::skip(keyAt);
+        if (!SnapshotCodec<V>::fits(valueAt, (size_t)(end - valueAt))) {
+            throw std::invalid_argument("Corrupted snapshot entry");
+        }
+        if ((size_t)stored == hash && SnapshotCodec<K>::read(keyAt) == key) {
+            return valueAt;
+        }
+        tmp = valueAt + SnapshotCodec<V>::skip(valueAt);
+    }
+    return nullptr;
+}
+
+template <class K, class V>
+template <class Q>
+/**
+ * @brief Returns the value of a key, in place in the mapping.
+ *
+ * @param key
+ * @return ValueView
+ * @throws std::invalid_argument if the key is not in the snapshot or its
+ * bucket is corrupted.
+ */
+typename MappedBucketedHashMap<K,V>::ValueView MappedBucketedHashMap<K,V>::get(const Q &key) const {
+    const char *value = this->findEntry(key);
+    if (!value) {
+        throw std::invalid_argument("Key not found");
+    }
+    return SnapshotCodec<V>::read(value);
+}
+
+template <class K, class V>
+template <class Q>
+/**
+ * @brief Checks if a key is in the snapshot.
+ *
+ * @param key
+ * @return true
+ * @return false
+ * @throws std::invalid_argument if the bucket of the key is corrupted.
+ */
+bool MappedBucketedHashMap<K,V>::containsKey(const Q &key) const {
+    return this->findEntry(key) != nullptr;
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the number of entries.
+ *
+ * @return int
+ */
+int MappedBucketedHashMap<K,V>::getSize() const {
+    return (int)this->header.entries;
+}
+
+template <class K, class V>
+/**
+ * @brief Checks if the snapshot has no entries.
+ *
+ * @return true
+ * @return false
+ */
+bool MappedBucketedHashMap<K,V>::isEmpty() const {
+    return this->header.entries == 0;
+}
+
+#endif
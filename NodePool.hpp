@@ -0,0 +1,348 @@
+#ifndef NODE_POOL_HPP
+#define NODE_POOL_HPP
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include "MapNode.hpp"
+
+/**
+ * @brief A region of memory handed out by bumping a pointer through large
+ * blocks. Nothing is freed individually: release() (or the destructor) frees
+ * every block at once, so several short-lived maps can draw their node slabs
+ * from one arena and be thrown away together.
+ * Maps using an arena must be destroyed or cleared before the arena is released.
+ *
+ * @author Jonathan Ung
+ */
+class NodeArena {
+    private:
+        struct Block {
+            Block *next;
+        };
+        Block *blocks;
+        char *cursor;
+        char *end;
+        size_t blockSize;
+
+    public:
+        NodeArena();
+        NodeArena(size_t);
+        NodeArena(const NodeArena &) = delete;
+        NodeArena &operator=(const NodeArena &) = delete;
+        ~NodeArena();
+        void *allocate(size_t, size_t);
+        void release();
+};
+
+/**
+ * @brief Construct a new Node Arena object with 1 MiB blocks
+ *
+ */
+inline NodeArena::NodeArena() : NodeArena(1 << 20) {}
+
+/**
+ * @brief Construct a new Node Arena object
+ *
+ * @param blockSize the size in bytes of every block requested from the system
+ */
+inline NodeArena::NodeArena(size_t blockSize) {
+    this->blocks = nullptr;
+    this->cursor = nullptr;
+    this->end = nullptr;
+    this->blockSize = blockSize;
+}
+
+/**
+ * @brief Destructor for a NodeArena object, frees every block.
+ */
+inline NodeArena::~NodeArena() {
+    this->release();
+}
+
+/**
+ * @brief Returns bytes of memory aligned to align, taking a new block when the
+ * current one is exhausted.
+ *
+ * @param bytes
+ * @param align a power of two no larger than alignof(std::max_align_t)
+ * @return void*
+ */
+inline void *NodeArena::allocate(size_t bytes, size_t align) {
+    size_t pad = this->cursor ? (align - (size_t)this->cursor % align) % align : 0;
+    if (!this->cursor || pad + bytes > (size_t)(this->end - this->cursor)) {
+        size_t header = (sizeof(Block) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+        size_t size = header + bytes > this->blockSize ? header + bytes : this->blockSize;
+        Block *b = static_cast<Block *>(::operator new(size));
+        b->next = this->blocks;
+        this->blocks = b;
+        this->cursor = reinterpret_cast<char *>(b) + header;
+        this->end = reinterpret_cast<char *>(b) + size;
+        pad = 0;
+    }
+    void *res = this->cursor + pad;
+    this->cursor += pad + bytes;
+    return res;
+}
+
+/**
+ * @brief Frees every block of the arena at once.
+ *
+ */
+inline void NodeArena::release() {
+    while (this->blocks) {
+        Block *next = this->blocks->next;
+        ::operator delete(this->blocks);
+        this->blocks = next;
+    }
+    this->cursor = nullptr;
+    this->end = nullptr;
+}
+
+template <class K, class V>
+/**
+ * @brief A pool of MapNodes carved out of fixed-size slabs. Freed nodes are
+ * kept on an intrusive free list threaded through their own storage and are
+ * handed out again before any new slab is requested. Slabs come from the
+ * system, or from a NodeArena when one is given, and are only ever released
+ * all together by reset() or the destructor.
+ *
+ * @author Jonathan Ung
+ */
+class NodePool {
+    private:
+        struct FreeSlot {
+            FreeSlot *next;
+        };
+        struct Slab {
+            Slab *next;
+        };
+        static const size_t kSlabBytes = 16384;
+        Slab *slabs;
+        FreeSlot *freeList;
+        char *cursor;
+        size_t slabLeft;
+        NodeArena *arena;
+        size_t created;
+        size_t destroyed;
+        size_t slabBytes;
+        static size_t headerSize();
+        static size_t nodesPerSlab();
+        void *allocate();
+
+    public:
+        NodePool();
+        NodePool(NodeArena *);
+        NodePool(const NodePool &) = delete;
+        NodePool &operator=(const NodePool &) = delete;
+        ~NodePool();
+        template <class... Args>
+        MapNode<K,V> *create(Args &&...);
+        void destroy(MapNode<K,V> *);
+        void *allocateBulk(size_t);
+        void adopt(size_t);
+        void reset();
+        size_t getCreated() const;
+        size_t getDestroyed() const;
+        size_t getSlabBytes() const;
+};
+
+template <class K, class V>
+/**
+ * @brief Returns the size of a slab header, padded so the first node is aligned.
+ *
+ * @return size_t
+ */
+size_t NodePool<K,V>::headerSize() {
+    return (sizeof(Slab) + alignof(MapNode<K,V>) - 1) / alignof(MapNode<K,V>) * alignof(MapNode<K,V>);
+}
+
+template <class K, class V>
+/**
+ * @brief Returns how many nodes fit in one slab, at least 16.
+ *
+ * @return size_t
+ */
+size_t NodePool<K,V>::nodesPerSlab() {
+    size_t n = (kSlabBytes - headerSize()) / sizeof(MapNode<K,V>);
+    return n < 16 ? 16 : n;
+}
+
+template <class K, class V>
+/**
+ * @brief Construct a new Node Pool object which takes its slabs from the system
+ *
+ */
+NodePool<K,V>::NodePool() : NodePool(nullptr) {}
+
+template <class K, class V>
+/**
+ * @brief Construct a new Node Pool object
+ *
+ * @param arena the arena to take slabs from, or nullptr for the system allocator
+ */
+NodePool<K,V>::NodePool(NodeArena *arena) {
+    this->slabs = nullptr;
+    this->freeList = nullptr;
+    this->cursor = nullptr;
+    this->slabLeft = 0;
+    this->arena = arena;
+    this->created = 0;
+    this->destroyed = 0;
+    this->slabBytes = 0;
+}
+
+template <class K, class V>
+/**
+ * @brief Destructor for a NodePool object. Every node must already have been destroyed.
+ */
+NodePool<K,V>::~NodePool() {
+    this->reset();
+}
+
+template <class K, class V>
+/**
+ * @brief Returns raw storage for one node, from the free list if possible.
+ *
+ * @return void*
+ */
+void *NodePool<K,V>::allocate() {
+    if (this->freeList) {
+        FreeSlot *res = this->freeList;
+        this->freeList = res->next;
+        return res;
+    }
+    if (this->slabLeft == 0) {
+        size_t bytes = headerSize() + nodesPerSlab() * sizeof(MapNode<K,V>);
+        Slab *s = static_cast<Slab *>(this->arena ? this->arena->allocate(bytes, alignof(MapNode<K,V>)) : ::operator new(bytes));
+        s->next = this->slabs;
+        this->slabs = s;
+        this->slabBytes += bytes;
+        this->cursor = reinterpret_cast<char *>(s) + headerSize();
+        this->slabLeft = nodesPerSlab();
+    }
+    void *res = this->cursor;
+    this->cursor += sizeof(MapNode<K,V>);
+    this->slabLeft--;
+    return res;
+}
+
+template <class K, class V>
+template <class... Args>
+/**
+ * @brief Constructs a node in pool storage from the given constructor arguments.
+ *
+ * @param args
+ * @return MapNode<K,V>*
+ */
+MapNode<K,V> *NodePool<K,V>::create(Args &&...args) {
+    void *mem = this->allocate();
+    try {
+        MapNode<K,V> *res = new (mem) MapNode<K,V>(std::forward<Args>(args)...);
+        this->created++;
+        return res;
+    } catch (...) {
+        FreeSlot *slot = static_cast<FreeSlot *>(mem);
+        slot->next = this->freeList;
+        this->freeList = slot;
+        throw;
+    }
+}
+
+template <class K, class V>
+/**
+ * @brief Destroys a node and puts its storage on the free list.
+ *
+ * @param mN
+ */
+void NodePool<K,V>::destroy(MapNode<K,V> *mN) {
+    mN->~MapNode<K,V>();
+    this->destroyed++;
+    FreeSlot *slot = reinterpret_cast<FreeSlot *>(mN);
+    slot->next = this->freeList;
+    this->freeList = slot;
+}
+
+template <class K, class V>
+/**
+ * @brief Reserves one dedicated slab with room for n contiguous nodes, for
+ * callers building many nodes at once, possibly from several threads, with
+ * placement new. The storage is handed back like any other slab: nodes built
+ * in it are destroyed through destroy() and the slab goes with reset().
+ *
+ * @param n
+ * @return void* the storage of the first node
+ */
+void *NodePool<K,V>::allocateBulk(size_t n) {
+    size_t bytes = headerSize() + n * sizeof(MapNode<K,V>);
+    Slab *s = static_cast<Slab *>(this->arena ? this->arena->allocate(bytes, alignof(MapNode<K,V>)) : ::operator new(bytes));
+    s->next = this->slabs;
+    this->slabs = s;
+    this->slabBytes += bytes;
+    return reinterpret_cast<char *>(s) + headerSize();
+}
+
+template <class K, class V>
+/**
+ * @brief Counts n nodes the caller constructed itself in allocateBulk storage.
+ *
+ * @param n
+ */
+void NodePool<K,V>::adopt(size_t n) {
+    this->created += n;
+}
+
+template <class K, class V>
+/**
+ * @brief Drops every slab at once. Nodes still living in the pool are not
+ * destroyed, so this is only safe once they have been destroyed or when K and
+ * V are trivially destructible. Slabs taken from an arena are left to it.
+ *
+ */
+void NodePool<K,V>::reset() {
+    while (this->slabs) {
+        Slab *next = this->slabs->next;
+        if (!this->arena) {
+            ::operator delete(this->slabs);
+        }
+        this->slabs = next;
+    }
+    this->freeList = nullptr;
+    this->cursor = nullptr;
+    this->slabLeft = 0;
+    this->slabBytes = 0;
+    this->destroyed = this->created;
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the number of nodes ever constructed in the pool.
+ *
+ * @return size_t
+ */
+size_t NodePool<K,V>::getCreated() const {
+    return this->created;
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the number of nodes ever destroyed, counting those dropped
+ * with their slab by reset().
+ *
+ * @return size_t
+ */
+size_t NodePool<K,V>::getDestroyed() const {
+    return this->destroyed;
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the bytes of every slab currently held.
+ *
+ * @return size_t
+ */
+size_t NodePool<K,V>::getSlabBytes() const {
+    return this->slabBytes;
+}
+
+#endif
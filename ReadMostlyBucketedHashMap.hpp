@@ -0,0 +1,397 @@
+#ifndef READ_MOSTLY_BUCKETED_HASH_MAP_HPP
+#define READ_MOSTLY_BUCKETED_HASH_MAP_HPP
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include "BucketedHash.hpp"
+#include "CapacityPolicy.hpp"
+#include "EpochDomain.hpp"
+
+template <class K, class V, class Traits = BucketedHashMapTraits>
+/**
+ * @brief A chained hash map for read-mostly workloads whose readers take no
+ * lock at all. Writers are serialized by a mutex and publish changes with
+ * atomic pointer stores: nodes are immutable once linked, so assigning a key
+ * links a new node in place of the old one, and a reHash builds a copy of
+ * every node in a new bucket array before publishing it. Unlinked nodes and
+ * replaced bucket arrays are retired to the process-wide EpochDomain and only
+ * freed once no reader can still be traversing them.
+ * Readers cost one guard entry, an acquire load per pointer and no shared
+ * write, so they never bounce a lock's cache line between cores.
+ *
+ * @author Jonathan Ung
+ */
+class ReadMostlyBucketedHashMap {
+    private:
+        /**
+         * @brief An immutable entry; only next changes once it is linked.
+         */
+        struct Node {
+            const K key;
+            const V value;
+            const size_t hash;
+            std::atomic<Node *> next;
+            Node(const K &, const V &, size_t, Node *);
+        };
+        /**
+         * @brief A bucket array together with its size, so a reader always
+         * indexes the array it loaded.
+         */
+        struct Table {
+            size_t capacity;
+            std::unique_ptr<std::atomic<Node *>[]> buckets;
+            Table(size_t);
+        };
+        std::atomic<Table *> table;
+        std::atomic<size_t> size;
+        double loadFactorThreshold;
+        std::mutex writeLock;
+        size_t retiredSinceCollect;
+        static void deleteNode(void *);
+        static void deleteTable(void *);
+        template <class Q>
+        Node *findNode(const Table *, const Q &, size_t) const;
+        void retire(void *, void (*)(void *));
+        void grow();
+
+    public:
+        ReadMostlyBucketedHashMap();
+        ReadMostlyBucketedHashMap(int);
+        ReadMostlyBucketedHashMap(int, double);
+        ReadMostlyBucketedHashMap(const ReadMostlyBucketedHashMap &) = delete;
+        ReadMostlyBucketedHashMap &operator=(const ReadMostlyBucketedHashMap &) = delete;
+        ~ReadMostlyBucketedHashMap();
+        template <class Q>
+        bool contains(const Q &) const;
+        template <class Q>
+        bool get(const Q &, V &) const;
+        template <class Q, class F>
+        bool visit(const Q &, F) const;
+        bool insert(const K &, const V &);
+        V remove(const K &);
+        void clear();
+        void reHash();
+        int getSize() const;
+        bool isEmpty() const;
+};
+
+template <class K, class V, class Traits>
+/**
+ * @brief Construct a new Node object
+ *
+ * @param key
+ * @param value
+ * @param hash
+ * @param next
+ */
+ReadMostlyBucketedHashMap<K,V,Traits>::Node::Node(const K &key, const V &value, size_t hash, Node *next) : key(key), value(value), hash(hash), next(next) {}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Construct a new Table object of empty buckets
+ *
+ * @param capacity
+ */
+ReadMostlyBucketedHashMap<K,V,Traits>::Table::Table(size_t capacity) : capacity(capacity), buckets(new std::atomic<Node *>[capacity]) {
+    for (size_t i = 0; i < capacity; i++) {
+        this->buckets[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Deleter of a retired node.
+ *
+ * @param node
+ */
+void ReadMostlyBucketedHashMap<K,V,Traits>::deleteNode(void *node) {
+    delete static_cast<Node *>(node);
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Deleter of a retired table, which frees the nodes still linked into
+ * it along with it.
+ *
+ * @param table
+ */
+void ReadMostlyBucketedHashMap<K,V,Traits>::deleteTable(void *table) {
+    Table *t = static_cast<Table *>(table);
+    for (size_t i = 0; i < t->capacity; i++) {
+        Node *n = t->buckets[i].load(std::memory_order_relaxed);
+        while (n) {
+            Node *next = n->next.load(std::memory_order_relaxed);
+            delete n;
+            n = next;
+        }
+    }
+    delete t;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Construct a new Read Mostly Bucketed Hash Map object
+ *
+ */
+ReadMostlyBucketedHashMap<K,V,Traits>::ReadMostlyBucketedHashMap() : ReadMostlyBucketedHashMap(10, 1.0) {}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Construct a new Read Mostly Bucketed Hash Map object
+ *
+ * @param cap
+ */
+ReadMostlyBucketedHashMap<K,V,Traits>::ReadMostlyBucketedHashMap(int cap) : ReadMostlyBucketedHashMap(cap, 1.0) {}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Construct a new Read Mostly Bucketed Hash Map object
+ *
+ * @param cap
+ * @param lFT
+ */
+ReadMostlyBucketedHashMap<K,V,Traits>::ReadMostlyBucketedHashMap(int cap, double lFT) {
+    if (lFT < 0.1 || lFT > 1.0) {
+        throw std::invalid_argument("Load factor cannot be greater than 1.0 and cannot be less than 0.1!");
+    }
+    if (cap < 1) {
+        throw std::invalid_argument("Capacity must be larger than 0!");
+    }
+    this->table.store(new Table(Traits::CapacityPolicy::roundCapacity(cap)));
+    this->size.store(0);
+    this->loadFactorThreshold = lFT;
+    this->retiredSinceCollect = 0;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Destructor for a ReadMostlyBucketedHashMap object. No reader may
+ * still be using the map. Memory retired earlier is left to the domain.
+ */
+ReadMostlyBucketedHashMap<K,V,Traits>::~ReadMostlyBucketedHashMap() {
+    deleteTable(this->table.load());
+}
+
+template <class K, class V, class Traits>
+template <class Q>
+/**
+ * @brief Returns the node holding the key in the given table, or nullptr.
+ * Must run inside an EpochGuard or under the write lock.
+ *
+ * @param t
+ * @param key
+ * @param hash
+ * @return Node*
+ */
+typename ReadMostlyBucketedHashMap<K,V,Traits>::Node *ReadMostlyBucketedHashMap<K,V,Traits>::findNode(const Table *t, const Q &key, size_t hash) const {
+    Node *n = t->buckets[Traits::CapacityPolicy::indexOf(hash, t->capacity)].load(std::memory_order_acquire);
+    while (n) {
+        if (n->hash == hash && n->key == key) {
+            return n;
+        }
+        n = n->next.load(std::memory_order_acquire);
+    }
+    return nullptr;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Retires unlinked memory and, every 64 retirements, asks the domain
+ * to free what readers can no longer see. Called under the write lock.
+ *
+ * @param ptr
+ * @param deleter
+ */
+void ReadMostlyBucketedHashMap<K,V,Traits>::retire(void *ptr, void (*deleter)(void *)) {
+    EpochDomain::instance().retire(ptr, deleter);
+    if (++this->retiredSinceCollect >= 64) {
+        EpochDomain::instance().collect();
+        this->retiredSinceCollect = 0;
+    }
+}
+
+template <class K, class V, class Traits>
+template <class Q>
+/**
+ * @brief Returns whether or not the map contains a key equal to the passed in
+ * one, without taking any lock
+ *
+ * @param key
+ * @return true
+ * @return false
+ */
+bool ReadMostlyBucketedHashMap<K,V,Traits>::contains(const Q &key) const {
+    EpochGuard guard;
+    return this->findNode(this->table.load(std::memory_order_acquire), key, hashKey<K>(key)) != nullptr;
+}
+
+template <class K, class V, class Traits>
+template <class Q>
+/**
+ * @brief Copies the value paired to the key into out, without taking any lock
+ *
+ * @param key
+ * @param out left untouched if the key is not found
+ * @return true if the key was found
+ * @return false
+ */
+bool ReadMostlyBucketedHashMap<K,V,Traits>::get(const Q &key, V &out) const {
+    EpochGuard guard;
+    Node *n = this->findNode(this->table.load(std::memory_order_acquire), key, hashKey<K>(key));
+    if (!n) {
+        return false;
+    }
+    out = n->value;
+    return true;
+}
+
+template <class K, class V, class Traits>
+template <class Q, class F>
+/**
+ * @brief Calls fn(const V&) on the value paired to the key inside an epoch
+ * guard, so the value stays alive for the call even if a writer replaces it.
+ *
+ * @param key
+ * @param fn
+ * @return true if the key was found
+ * @return false
+ */
+bool ReadMostlyBucketedHashMap<K,V,Traits>::visit(const Q &key, F fn) const {
+    EpochGuard guard;
+    Node *n = this->findNode(this->table.load(std::memory_order_acquire), key, hashKey<K>(key));
+    if (!n) {
+        return false;
+    }
+    fn(n->value);
+    return true;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Inserts a key-value pair, or replaces the node of an existing key
+ * with one holding the new value. Readers see either the old or the new node.
+ *
+ * @param key
+ * @param value
+ * @return true if the key was not present yet
+ * @return false
+ */
+bool ReadMostlyBucketedHashMap<K,V,Traits>::insert(const K &key, const V &value) {
+    std::lock_guard<std::mutex> lock(this->writeLock);
+    size_t hash = BucketedHash<K>()(key);
+    Table *t = this->table.load(std::memory_order_relaxed);
+    std::atomic<Node *> *link = &t->buckets[Traits::CapacityPolicy::indexOf(hash, t->capacity)];
+    for (Node *n = link->load(std::memory_order_relaxed); n; n = link->load(std::memory_order_relaxed)) {
+        if (n->hash == hash && n->key == key) {
+            link->store(new Node(key, value, hash, n->next.load(std::memory_order_relaxed)), std::memory_order_release);
+            this->retire(n, deleteNode);
+            return false;
+        }
+        link = &n->next;
+    }
+    if ((double)(this->size.load(std::memory_order_relaxed) + 1) / (double)t->capacity > this->loadFactorThreshold) {
+        this->grow();
+        t = this->table.load(std::memory_order_relaxed);
+    }
+    std::atomic<Node *> &bucket = t->buckets[Traits::CapacityPolicy::indexOf(hash, t->capacity)];
+    bucket.store(new Node(key, value, hash, bucket.load(std::memory_order_relaxed)), std::memory_order_release);
+    this->size.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Unlinks the given key. The node is freed once no reader sees it.
+ *
+ * @param key
+ * @return V the removed value
+ * @throws std::invalid_argument if the key is not found.
+ */
+V ReadMostlyBucketedHashMap<K,V,Traits>::remove(const K &key) {
+    std::lock_guard<std::mutex> lock(this->writeLock);
+    size_t hash = BucketedHash<K>()(key);
+    Table *t = this->table.load(std::memory_order_relaxed);
+    std::atomic<Node *> *link = &t->buckets[Traits::CapacityPolicy::indexOf(hash, t->capacity)];
+    for (Node *n = link->load(std::memory_order_relaxed); n; n = link->load(std::memory_order_relaxed)) {
+        if (n->hash == hash && n->key == key) {
+            V res = n->value;
+            link->store(n->next.load(std::memory_order_relaxed), std::memory_order_release);
+            this->size.fetch_sub(1, std::memory_order_relaxed);
+            this->retire(n, deleteNode);
+            return res;
+        }
+        link = &n->next;
+    }
+    throw std::invalid_argument("No key found.");
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Publishes a new table of twice the buckets holding a copy of every
+ * node. Nodes are copied rather than relinked because readers may still be
+ * walking the old chains. Called under the write lock.
+ *
+ */
+void ReadMostlyBucketedHashMap<K,V,Traits>::grow() {
+    Table *old = this->table.load(std::memory_order_relaxed);
+    Table *t = new Table(Traits::CapacityPolicy::grow(old->capacity));
+    for (size_t i = 0; i < old->capacity; i++) {
+        for (Node *n = old->buckets[i].load(std::memory_order_relaxed); n; n = n->next.load(std::memory_order_relaxed)) {
+            std::atomic<Node *> &bucket = t->buckets[Traits::CapacityPolicy::indexOf(n->hash, t->capacity)];
+            bucket.store(new Node(n->key, n->value, n->hash, bucket.load(std::memory_order_relaxed)), std::memory_order_relaxed);
+        }
+    }
+    this->table.store(t, std::memory_order_release);
+    this->retire(old, deleteTable);
+    EpochDomain::instance().collect();
+    this->retiredSinceCollect = 0;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Grows the map now rather than on the insert crossing the load factor
+ * threshold.
+ *
+ */
+void ReadMostlyBucketedHashMap<K,V,Traits>::reHash() {
+    std::lock_guard<std::mutex> lock(this->writeLock);
+    this->grow();
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Publishes an empty table of the same capacity and retires the old one.
+ *
+ */
+void ReadMostlyBucketedHashMap<K,V,Traits>::clear() {
+    std::lock_guard<std::mutex> lock(this->writeLock);
+    Table *old = this->table.load(std::memory_order_relaxed);
+    this->table.store(new Table(old->capacity), std::memory_order_release);
+    this->size.store(0, std::memory_order_relaxed);
+    this->retire(old, deleteTable);
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief returns the size of the map
+ *
+ * @return int
+ */
+int ReadMostlyBucketedHashMap<K,V,Traits>::getSize() const {
+    return (int)this->size.load(std::memory_order_relaxed);
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Returns whether or not the map is empty.
+ *
+ * @return true
+ * @return false
+ */
+bool ReadMostlyBucketedHashMap<K,V,Traits>::isEmpty() const {
+    return this->getSize() == 0;
+}
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef REORDER_POLICY_HPP
+#define REORDER_POLICY_HPP
+
+#include "MapNode.hpp"
+
+/**
+ * @brief Reorder policy leaving every chain in insertion order, the default.
+ * Lookups never write to the map.
+ *
+ * @author Jonathan Ung
+ */
+struct NoReorder {
+    static const bool enabled = false;
+    template <class K, class V>
+    static void promote(MapNode<K, V> *&, MapNode<K, V> *, MapNode<K, V> *, MapNode<K, V> *);
+};
+
+template <class K, class V>
+/**
+ * @brief Does nothing.
+ *
+ * @param head
+ * @param prevPrev
+ * @param prev
+ * @param node
+ */
+inline void NoReorder::promote(MapNode<K, V> *&, MapNode<K, V> *, MapNode<K, V> *, MapNode<K, V> *) {}
+
+/**
+ * @brief Reorder policy moving a node found by a lookup to the head of its
+ * chain. Hot keys reach the front after one hit, which suits a popularity
+ * that shifts over time, but a single lookup of a cold key also pushes every
+ * hot key back by one.
+ *
+ * @author Jonathan Ung
+ */
+struct MoveToFront {
+    static const bool enabled = true;
+    template <class K, class V>
+    static void promote(MapNode<K, V> *&, MapNode<K, V> *, MapNode<K, V> *, MapNode<K, V> *);
+};
+
+template <class K, class V>
+/**
+ * @brief Unlinks node from behind prev and links it in as the new head.
+ *
+ * @param head the head of the chain
+ * @param prevPrev the node before prev, or nullptr
+ * @param prev the node before node, or nullptr if node is the head
+ * @param node the node found
+ */
+inline void MoveToFront::promote(MapNode<K, V> *&head, MapNode<K, V> *, MapNode<K, V> *prev, MapNode<K, V> *node) {
+    if (!prev) {
+        return;
+    }
+    prev->next = node->next;
+    node->next = head;
+    head = node;
+}
+
+/**
+ * @brief Reorder policy swapping a node found by a lookup with the node in
+ * front of it. A key needs many hits to reach the front, so the order
+ * converges on the popularity of a stable (e.g. Zipfian) distribution and is
+ * barely disturbed by the odd lookup of a cold key.
+ *
+ * @author Jonathan Ung
+ */
+struct Transpose {
+    static const bool enabled = true;
+    template <class K, class V>
+    static void promote(MapNode<K, V> *&, MapNode<K, V> *, MapNode<K, V> *, MapNode<K, V> *);
+};
+
+template <class K, class V>
+/**
+ * @brief Swaps node with prev by relinking, so both keep their addresses.
+ *
+ * @param head the head of the chain
+ * @param prevPrev the node before prev, or nullptr if prev is the head
+ * @param prev the node before node, or nullptr if node is the head
+ * @param node the node found
+ */
+inline void Transpose::promote(MapNode<K, V> *&head, MapNode<K, V> *prevPrev, MapNode<K, V> *prev, MapNode<K, V> *node) {
+    if (!prev) {
+        return;
+    }
+    prev->next = node->next;
+    node->next = prev;
+    if (prevPrev) {
+        prevPrev->next = node;
+    } else {
+        head = node;
+    }
+}
+
+#endif
@@ -0,0 +1,372 @@
+#ifndef SHARDED_BUCKETED_HASH_MAP_HPP
+#define SHARDED_BUCKETED_HASH_MAP_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include "BucketedHashMap.hpp"
+
+template <class K, class V, class Traits = BucketedHashMapTraits>
+/**
+ * @brief A thread safe hash map made of independent BucketedHashMap shards,
+ * each behind its own reader/writer lock and each resizing on its own. A key
+ * always lives in the same shard, so operations on different shards never
+ * contend and readers of one shard only wait for its writers.
+ * Shards never use incremental reHash and may not reorder their chains, so
+ * lookups under a read lock never write to the shard.
+ * Every shard shares the seed of the map, so a key is hashed once: the top
+ * bits of the hash pick the shard and the whole hash is handed to it.
+ * Values are handed out by copy (or to a callback run under the shard's lock)
+ * since a reference could dangle as soon as the lock is released.
+ *
+ * @author Jonathan Ung
+ */
+class ShardedBucketedHashMap {
+    static_assert(!Traits::ReorderPolicy::enabled, "lookups under a shared lock cannot reorder chains");
+    private:
+        /**
+         * @brief One shard, padded to a cache line of its own so the locks of
+         * neighbouring shards do not share a line.
+         */
+        struct alignas(64) Shard {
+            mutable std::shared_mutex lock;
+            BucketedHashMap<K, V, Traits> map;
+            std::atomic<size_t> size;
+        };
+        std::unique_ptr<Shard[]> shards;
+        size_t shardCount;
+        uint64_t seed;
+        template <class Q>
+        size_t hashOf(const Q &) const;
+        Shard &shardOf(size_t) const;
+
+    public:
+        ShardedBucketedHashMap();
+        ShardedBucketedHashMap(size_t);
+        ShardedBucketedHashMap(size_t, int, double);
+        ShardedBucketedHashMap(const ShardedBucketedHashMap &) = delete;
+        ShardedBucketedHashMap &operator=(const ShardedBucketedHashMap &) = delete;
+        template <class Q>
+        bool contains(const Q &) const;
+        template <class Q>
+        bool get(const Q &, V &) const;
+        template <class Q, class F>
+        bool visit(const Q &, F) const;
+        template <class Q, class F>
+        bool update(const Q &, F);
+        bool insert(const K &, const V &);
+        template <class KK, class... Args>
+        bool tryEmplace(KK &&, Args &&...);
+        template <class KK, class VV>
+        bool insertOrAssign(KK &&, VV &&);
+        V remove(const K &);
+        void clear();
+        int getSize() const;
+        bool isEmpty() const;
+        size_t getShardCount() const;
+        uint64_t getSeed() const;
+        template <class F>
+        void forEach(F) const;
+};
+
+template <class K, class V, class Traits>
+template <class Q>
+/**
+ * @brief Hashes a key under the seed shared by every shard, so the hash is
+ * the one the shard's map would compute itself.
+ *
+ * @param key
+ * @return size_t
+ */
+size_t ShardedBucketedHashMap<K,V,Traits>::hashOf(const Q &key) const {
+    return hashKey<K>(key, this->seed);
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Returns the shard of a hash, picked by its top log2(shardCount)
+ * bits. The seeded hash is already well mixed, and the bucket index within
+ * the shard depends on all of its bits, so the keys of one shard still spread
+ * over all of its buckets.
+ *
+ * @param hash
+ * @return Shard&
+ */
+typename ShardedBucketedHashMap<K,V,Traits>::Shard &ShardedBucketedHashMap<K,V,Traits>::shardOf(size_t hash) const {
+    return this->shards[(size_t)(((uint64_t)hash >> PowerOfTwoCapacity::leadingZeros(this->shardCount)) >> 1)];
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Construct a new Sharded Bucketed Hash Map object with 64 shards
+ *
+ */
+ShardedBucketedHashMap<K,V,Traits>::ShardedBucketedHashMap() : ShardedBucketedHashMap(64) {}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Construct a new Sharded Bucketed Hash Map object
+ *
+ * @param shards the number of shards, rounded up to a power of two
+ */
+ShardedBucketedHashMap<K,V,Traits>::ShardedBucketedHashMap(size_t shards) : ShardedBucketedHashMap(shards, 10, 1.0) {}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Construct a new Sharded Bucketed Hash Map object
+ *
+ * @param shards the number of shards, rounded up to a power of two
+ * @param cap the initial capacity of every shard
+ * @param lFT the load factor threshold of every shard
+ */
+ShardedBucketedHashMap<K,V,Traits>::ShardedBucketedHashMap(size_t shards, int cap, double lFT) {
+    if (shards < 1) {
+        throw std::invalid_argument("Shard count must be larger than 0!");
+    }
+    this->shardCount = PowerOfTwoCapacity::roundCapacity(shards);
+    this->seed = randomHashSeed();
+    this->shards = std::unique_ptr<Shard[]>(new Shard[this->shardCount]);
+    for (size_t i = 0; i < this->shardCount; i++) {
+        this->shards[i].map = BucketedHashMap<K, V, Traits>(cap, lFT);
+        this->shards[i].map.setSeed(this->seed);
+        this->shards[i].size.store(0, std::memory_order_relaxed);
+    }
+}
+
+template <class K, class V, class Traits>
+template <class Q>
+/**
+ * @brief Returns whether or not the map contains a key equal to the passed in one
+ *
+ * @param key
+ * @return true
+ * @return false
+ */
+bool ShardedBucketedHashMap<K,V,Traits>::contains(const Q &key) const {
+    size_t hash = this->hashOf(key);
+    Shard &s = this->shardOf(hash);
+    std::shared_lock<std::shared_mutex> guard(s.lock);
+    return s.map.containsHashed(key, hash);
+}
+
+template <class K, class V, class Traits>
+template <class Q>
+/**
+ * @brief Copies the value paired to the key into out
+ *
+ * @param key
+ * @param out left untouched if the key is not found
+ * @return true if the key was found
+ * @return false
+ */
+bool ShardedBucketedHashMap<K,V,Traits>::get(const Q &key, V &out) const {
+    size_t hash = this->hashOf(key);
+    Shard &s = this->shardOf(hash);
+    std::shared_lock<std::shared_mutex> guard(s.lock);
+    V *res = s.map.findHashed(key, hash);
+    if (!res) {
+        return false;
+    }
+    out = *res;
+    return true;
+}
+
+template <class K, class V, class Traits>
+template <class Q, class F>
+/**
+ * @brief Calls fn(const V&) on the value paired to the key while holding the
+ * shard's read lock, for values too large to copy out.
+ *
+ * @param key
+ * @param fn must not call back into the map
+ * @return true if the key was found
+ * @return false
+ */
+bool ShardedBucketedHashMap<K,V,Traits>::visit(const Q &key, F fn) const {
+    size_t hash = this->hashOf(key);
+    Shard &s = this->shardOf(hash);
+    std::shared_lock<std::shared_mutex> guard(s.lock);
+    V *res = s.map.findHashed(key, hash);
+    if (!res) {
+        return false;
+    }
+    fn(static_cast<const V &>(*res));
+    return true;
+}
+
+template <class K, class V, class Traits>
+template <class Q, class F>
+/**
+ * @brief Calls fn(V&) on the value paired to the key while holding the
+ * shard's write lock, so read-modify-write updates are atomic.
+ *
+ * @param key
+ * @param fn must not call back into the map
+ * @return true if the key was found
+ * @return false
+ */
+bool ShardedBucketedHashMap<K,V,Traits>::update(const Q &key, F fn) {
+    size_t hash = this->hashOf(key);
+    Shard &s = this->shardOf(hash);
+    std::unique_lock<std::shared_mutex> guard(s.lock);
+    V *res = s.map.findHashed(key, hash);
+    if (!res) {
+        return false;
+    }
+    fn(*res);
+    return true;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief inserts a key-value pair into the map
+ *
+ * @param key
+ * @param value
+ * @return true if the key was not present yet
+ * @return false
+ */
+bool ShardedBucketedHashMap<K,V,Traits>::insert(const K &key, const V &value) {
+    return this->insertOrAssign(key, value);
+}
+
+template <class K, class V, class Traits>
+template <class KK, class... Args>
+/**
+ * @brief Inserts the key with a value constructed in place from the arguments
+ * if the key is not present yet.
+ *
+ * @param key
+ * @param args the arguments of the value's constructor
+ * @return true if the key was inserted
+ * @return false
+ */
+bool ShardedBucketedHashMap<K,V,Traits>::tryEmplace(KK &&key, Args &&...args) {
+    size_t hash = this->hashOf(key);
+    Shard &s = this->shardOf(hash);
+    std::unique_lock<std::shared_mutex> guard(s.lock);
+    bool res = s.map.tryEmplaceHashed(hash, std::forward<KK>(key), std::forward<Args>(args)...).second;
+    s.size.fetch_add(res, std::memory_order_relaxed);
+    return res;
+}
+
+template <class K, class V, class Traits>
+template <class KK, class VV>
+/**
+ * @brief Inserts the key-value pair, or assigns the value to the existing key.
+ *
+ * @param key
+ * @param value
+ * @return true if the key was inserted
+ * @return false
+ */
+bool ShardedBucketedHashMap<K,V,Traits>::insertOrAssign(KK &&key, VV &&value) {
+    size_t hash = this->hashOf(key);
+    Shard &s = this->shardOf(hash);
+    std::unique_lock<std::shared_mutex> guard(s.lock);
+    bool res = s.map.insertOrAssignHashed(hash, std::forward<KK>(key), std::forward<VV>(value)).second;
+    s.size.fetch_add(res, std::memory_order_relaxed);
+    return res;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief removes the given key from the map
+ *
+ * @param key
+ * @return V the removed value
+ * @throws std::invalid_argument if the key is not found.
+ */
+V ShardedBucketedHashMap<K,V,Traits>::remove(const K &key) {
+    size_t hash = this->hashOf(key);
+    Shard &s = this->shardOf(hash);
+    std::unique_lock<std::shared_mutex> guard(s.lock);
+    V res = s.map.removeHashed(key, hash);
+    s.size.fetch_sub(1, std::memory_order_relaxed);
+    return res;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Clears every shard, one at a time. Inserts racing with clear() may
+ * survive it.
+ *
+ */
+void ShardedBucketedHashMap<K,V,Traits>::clear() {
+    for (size_t i = 0; i < this->shardCount; i++) {
+        std::unique_lock<std::shared_mutex> guard(this->shards[i].lock);
+        this->shards[i].map.clear();
+        this->shards[i].size.store(0, std::memory_order_relaxed);
+    }
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Returns the size of the map, summed from the shards' counters
+ * without taking any lock. Under concurrent writes it is a snapshot that may
+ * already be stale.
+ *
+ * @return int
+ */
+int ShardedBucketedHashMap<K,V,Traits>::getSize() const {
+    size_t res = 0;
+    for (size_t i = 0; i < this->shardCount; i++) {
+        res += this->shards[i].size.load(std::memory_order_relaxed);
+    }
+    return (int)res;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Returns whether or not the map is empty, see getSize().
+ *
+ * @return true
+ * @return false
+ */
+bool ShardedBucketedHashMap<K,V,Traits>::isEmpty() const {
+    return this->getSize() == 0;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Returns the number of shards
+ *
+ * @return size_t
+ */
+size_t ShardedBucketedHashMap<K,V,Traits>::getShardCount() const {
+    return this->shardCount;
+}
+
+template <class K, class V, class Traits>
+/**
+ * @brief Returns the seed drawn at construction, shared by every shard.
+ *
+ * @return uint64_t
+ */
+uint64_t ShardedBucketedHashMap<K,V,Traits>::getSeed() const {
+    return this->seed;
+}
+
+template <class K, class V, class Traits>
+template <class F>
+/**
+ * @brief Calls fn(const K&, const V&) on every entry, holding the read lock of
+ * one shard at a time, so it sees each shard consistently but not the whole
+ * map at a single instant.
+ *
+ * @param fn must not call back into the map
+ */
+void ShardedBucketedHashMap<K,V,Traits>::forEach(F fn) const {
+    for (size_t i = 0; i < this->shardCount; i++) {
+        std::shared_lock<std::shared_mutex> guard(this->shards[i].lock);
+        const BucketedHashMap<K, V, Traits> &map = this->shards[i].map;
+        for (typename BucketedHashMap<K, V, Traits>::const_iterator it = map.begin(); it != map.end(); ++it) {
+            fn(static_cast<const K &>(it->key), static_cast<const V &>(it->value));
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,228 @@
+#ifndef STATIC_BUCKETED_HASH_MAP_HPP
+#define STATIC_BUCKETED_HASH_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+template <class K, class = void>
+/**
+ * @brief The constexpr hash of a StaticBucketedHashMap key: 64 bit FNV-1a
+ * over the characters of a std::string_view. The keys of a static table are
+ * fixed at compile time, so unlike BucketedHashMap it needs no seed.
+ *
+ * @author Jonathan Ung
+ */
+struct StaticHash {
+    static_assert(std::is_same<K, std::string_view>::value, "static maps hold std::string_view or integral keys");
+    constexpr uint64_t operator()(std::string_view key) const {
+        uint64_t res = 0xCBF29CE484222325ULL;
+        for (size_t i = 0; i < key.size(); i++) {
+            res ^= (uint64_t)(unsigned char)key[i];
+            res *= 0x100000001B3ULL;
+        }
+        return res;
+    }
+};
+
+template <class K>
+/**
+ * @brief Integral keys go through the splitmix64 finalizer.
+ */
+struct StaticHash<K, typename std::enable_if<std::is_integral<K>::value || std::is_enum<K>::value>::type> {
+    constexpr uint64_t operator()(K key) const {
+        uint64_t x = (uint64_t)key;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+};
+
+template <class K, class V, size_t N>
+/**
+ * @brief A fixed hash map of N entries whose whole layout is computed at
+ * compile time, for lookup tables such as opcode or header names. Declared
+ * static constexpr it is a constant in read-only data (.rodata, or
+ * .data.rel.ro for string_view keys in position independent code): no
+ * static initializer, no heap allocation and nothing to do before main.
+ * The buckets are chained like a BucketedHashMap, but each chain is a run of
+ * the entry arrays: a power of two bucket count of at least N, chosen by the
+ * top bits of a Fibonacci multiply as in PowerOfTwoCapacity, and an offset
+ * per bucket. A lookup hashes the key, then compares the cached hashes and
+ * keys of its run, about 1.5 entries on average.
+ * K is std::string_view (which must refer to literals or other static
+ * storage) or an integral type; V must be a literal type that is default
+ * constructible.
+ *
+ * @author Jonathan Ung
+ */
+class StaticBucketedHashMap {
+    static_assert(N > 0, "a static map holds at least one entry");
+
+    private:
+        static constexpr size_t roundCapacity() {
+            size_t res = 1;
+            while (res < N) {
+                res *= 2;
+            }
+            return res;
+        }
+        static constexpr unsigned int shift() {
+            unsigned int res = 64;
+            for (size_t cap = roundCapacity(); cap > 1; cap /= 2) {
+                res--;
+            }
+            return res;
+        }
+        static constexpr size_t kBuckets = roundCapacity();
+        static constexpr unsigned int kShift = shift();
+        K keys[N] = {};
+        V values[N] = {};
+        uint64_t hashes[N] = {};
+        uint32_t offsets[kBuckets + 1] = {};
+        static constexpr size_t indexOf(uint64_t);
+        constexpr size_t find(K) const;
+
+    public:
+        constexpr StaticBucketedHashMap(const std::pair<K, V> (&)[N]);
+        constexpr const V &get(K) const;
+        constexpr bool containsKey(K) const;
+        constexpr int getSize() const;
+        constexpr bool isEmpty() const;
+        constexpr int getCapacity() const;
+};
+
+template <class K, class V, size_t N>
+/**
+ * @brief Places the entries bucket by bucket with a counting sort.
+ *
+ * @param entries the key/value pairs, e.g. {{"add", 1}, {"sub", 2}}
+ * @throws std::invalid_argument if a key appears twice, which fails the
+ * build when the map is constexpr.
+ */
+constexpr StaticBucketedHashMap<K,V,N>::StaticBucketedHashMap(const std::pair<K, V> (&entries)[N]) {
+    for (size_t i = 0; i < N; i++) {
+        this->offsets[indexOf(StaticHash<K>()(entries[i].first)) + 1]++;
+    }
+    for (size_t b = 0; b < kBuckets; b++) {
+        this->offsets[b + 1] += this->offsets[b];
+    }
+    uint32_t fill[kBuckets] = {};
+    for (size_t i = 0; i < N; i++) {
+        uint64_t hash = StaticHash<K>()(entries[i].first);
+        size_t b = indexOf(hash);
+        for (size_t j = this->offsets[b]; j < this->offsets[b] + fill[b]; j++) {
+            if (this->hashes[j] == hash && this->keys[j] == entries[i].first) {
+                throw std::invalid_argument("Duplicate key in static map");
+            }
+        }
+        size_t slot = this->offsets[b] + fill[b]++;
+        this->keys[slot] = entries[i].first;
+        this->values[slot] = entries[i].second;
+        this->hashes[slot] = hash;
+    }
+}
+
+template <class K, class V, size_t N>
+/**
+ * @brief Returns the bucket of a hash, its top bits after a Fibonacci multiply.
+ *
+ * @param hash
+ * @return size_t
+ */
+constexpr size_t StaticBucketedHashMap<K,V,N>::indexOf(uint64_t hash) {
+    return (size_t)(((hash * 0x9E3779B97F4A7C15ULL) >> (kShift - 1)) >> 1);
+}
+
+template <class K, class V, size_t N>
+/**
+ * @brief Returns the slot of a key, or N.
+ *
+ * @param key
+ * @return size_t
+ */
+constexpr size_t StaticBucketedHashMap<K,V,N>::find(K key) const {
+    uint64_t hash = StaticHash<K>()(key);
+    size_t b = indexOf(hash);
+    for (size_t i = this->offsets[b]; i < this->offsets[b + 1]; i++) {
+        if (this->hashes[i] == hash && this->keys[i] == key) {
+            return i;
+        }
+    }
+    return N;
+}
+
+template <class K, class V, size_t N>
+/**
+ * @brief Returns the value of a key.
+ *
+ * @param key
+ * @return const V&
+ * @throws std::invalid_argument if the key is not in the map.
+ */
+constexpr const V &StaticBucketedHashMap<K,V,N>::get(K key) const {
+    size_t slot = this->find(key);
+    if (slot == N) {
+        throw std::invalid_argument("Key not found");
+    }
+    return this->values[slot];
+}
+
+template <class K, class V, size_t N>
+/**
+ * @brief Checks if a key is in the map.
+ *
+ * @param key
+ * @return true
+ * @return false
+ */
+constexpr bool StaticBucketedHashMap<K,V,N>::containsKey(K key) const {
+    return this->find(key) != N;
+}
+
+template <class K, class V, size_t N>
+/**
+ * @brief Returns the number of entries, N.
+ *
+ * @return int
+ */
+constexpr int StaticBucketedHashMap<K,V,N>::getSize() const {
+    return (int)N;
+}
+
+template <class K, class V, size_t N>
+/**
+ * @brief Always false, a static map holds at least one entry.
+ *
+ * @return false
+ */
+constexpr bool StaticBucketedHashMap<K,V,N>::isEmpty() const {
+    return false;
+}
+
+template <class K, class V, size_t N>
+/**
+ * @brief Returns the number of buckets.
+ *
+ * @return int
+ */
+constexpr int StaticBucketedHashMap<K,V,N>::getCapacity() const {
+    return (int)kBuckets;
+}
+
+template <class K, class V, size_t N>
+/**
+ * @brief Builds a StaticBucketedHashMap, deducing N from the entries:
+ * static constexpr auto opcodes = makeStaticBucketedHashMap<std::string_view, int>({{"add", 1}, {"sub", 2}});
+ *
+ * @param entries
+ * @return StaticBucketedHashMap<K,V,N>
+ */
+constexpr StaticBucketedHashMap<K,V,N> makeStaticBucketedHashMap(const std::pair<K, V> (&entries)[N]) {
+    return StaticBucketedHashMap<K, V, N>(entries);
+}
+
+#endif
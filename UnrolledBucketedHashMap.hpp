@@ -0,0 +1,567 @@
+#ifndef UNROLLED_BUCKETED_HASH_MAP_HPP
+#define UNROLLED_BUCKETED_HASH_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "BucketedHash.hpp"
+#include "CapacityPolicy.hpp"
+
+template <class K, class V>
+/**
+ * @brief A chained hash map whose buckets are unrolled: each bucket stores up
+ * to a few entries inline, sized so the whole bucket spans one or two cache
+ * lines, and only spills into chained overflow blocks of several entries
+ * each. Every entry has a 32-bit tag of its hash next to the bucket's count,
+ * so a lookup in a short chain touches the one bucket line and compares keys
+ * only on a tag match. Entries are kept dense: a remove moves the bucket's
+ * last entry into the hole, so values do not have stable addresses.
+ * It exposes the same interface as BucketedHashMap so the engines can be
+ * swapped, see HashMapEngine.hpp.
+ *
+ * @author Jonathan Ung
+ */
+class UnrolledBucketedHashMap {
+    private:
+        struct Entry {
+            K key;
+            V value;
+        };
+        template <size_t N>
+        struct Slots {
+            uint32_t count;
+            uint32_t tags[N];
+            typename std::aligned_storage<sizeof(Entry), alignof(Entry)>::type storage[N];
+            Entry *entry(size_t i) const { return reinterpret_cast<Entry *>(const_cast<typename std::aligned_storage<sizeof(Entry), alignof(Entry)>::type *>(&this->storage[i])); }
+        };
+        /**
+         * @brief The number of inline entries: 4, 2 or 1, the most whose
+         * bucket still fits in two cache lines.
+         */
+        static const size_t kInlineSlots = 16 + 4 * (sizeof(Entry) + 4) <= 128 ? 4 : 16 + 2 * (sizeof(Entry) + 4) <= 128 ? 2 : 1;
+        static const size_t kBlockSlots = 8;
+        struct Block : Slots<kBlockSlots> {
+            Block *next;
+        };
+        struct alignas(64) Bucket : Slots<kInlineSlots> {
+            Block *overflow;
+        };
+        size_t size;
+        size_t capacity;
+        double loadFactorThreshold;
+        Bucket *buckets;
+        static size_t hashOf(const K &);
+        static uint32_t tagOf(size_t);
+        Bucket &bucketOf(size_t) const;
+        Entry *find(const K &, size_t) const;
+        void link(size_t, K &&, V &&);
+        void allocate(size_t);
+        void destroy();
+        void resize(size_t);
+
+    public:
+        UnrolledBucketedHashMap();
+        UnrolledBucketedHashMap(int);
+        UnrolledBucketedHashMap(int, double);
+        UnrolledBucketedHashMap(const UnrolledBucketedHashMap &);
+        UnrolledBucketedHashMap(UnrolledBucketedHashMap &&);
+        ~UnrolledBucketedHashMap();
+        UnrolledBucketedHashMap<K,V>& operator=(const UnrolledBucketedHashMap<K,V>&);
+        UnrolledBucketedHashMap<K,V>& operator=(UnrolledBucketedHashMap<K,V>&&);
+        void clear();
+        bool containsKey(const K &) const;
+        V& get(const K &) const;
+        V& operator[](const K &) const;
+        bool isEmpty() const;
+        void insert(const K, const V);
+        V remove(const K &);
+        int getSize() const;
+        int getCapacity() const;
+        static size_t getInlineSlots();
+        void show() const;
+};
+
+template <class K, class V>
+/**
+ * @brief Hashes a key and spreads its bits, since std::hash is the identity
+ * for integers and both the bucket index and the tag need well mixed bits.
+ *
+ * @param key
+ * @return size_t
+ */
+size_t UnrolledBucketedHashMap<K,V>::hashOf(const K &key) {
+    uint64_t h = (uint64_t)BucketedHash<K>()(key);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (size_t)h;
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the tag of a hash, its low 32 bits; the bucket index comes
+ * from the top bits.
+ *
+ * @param hash
+ * @return uint32_t
+ */
+uint32_t UnrolledBucketedHashMap<K,V>::tagOf(size_t hash) {
+    return (uint32_t)hash;
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the bucket of a hash.
+ *
+ * @param hash
+ * @return Bucket&
+ */
+typename UnrolledBucketedHashMap<K,V>::Bucket &UnrolledBucketedHashMap<K,V>::bucketOf(size_t hash) const {
+    return this->buckets[PowerOfTwoCapacity::indexOf(hash, this->capacity)];
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the entry holding the key, or nullptr, scanning the inline
+ * entries and then the overflow blocks.
+ *
+ * @param key
+ * @param hash
+ * @return Entry*
+ */
+typename UnrolledBucketedHashMap<K,V>::Entry *UnrolledBucketedHashMap<K,V>::find(const K &key, size_t hash) const {
+    Bucket &b = this->bucketOf(hash);
+    uint32_t tag = tagOf(hash);
+    for (uint32_t i = 0; i < b.count; i++) {
+        if (b.tags[i] == tag && b.entry(i)->key == key) {
+            return b.entry(i);
+        }
+    }
+    for (Block *blk = b.overflow; blk; blk = blk->next) {
+        for (uint32_t i = 0; i < blk->count; i++) {
+            if (blk->tags[i] == tag && blk->entry(i)->key == key) {
+                return blk->entry(i);
+            }
+        }
+    }
+    return nullptr;
+}
+
+template <class K, class V>
+/**
+ * @brief Adds an entry for a key known to be absent: inline while there is
+ * room, else in the first overflow block, which is the only one that can
+ * have room, else in a new first block.
+ *
+ * @param hash
+ * @param key
+ * @param value
+ */
+void UnrolledBucketedHashMap<K,V>::link(size_t hash, K &&key, V &&value) {
+    Bucket &b = this->bucketOf(hash);
+    if (b.count < kInlineSlots) {
+        new (b.entry(b.count)) Entry{std::move(key), std::move(value)};
+        b.tags[b.count++] = tagOf(hash);
+        return;
+    }
+    if (!b.overflow || b.overflow->count == kBlockSlots) {
+        Block *blk = new Block();
+        blk->count = 0;
+        blk->next = b.overflow;
+        b.overflow = blk;
+    }
+    Block *blk = b.overflow;
+    new (blk->entry(blk->count)) Entry{std::move(key), std::move(value)};
+    blk->tags[blk->count++] = tagOf(hash);
+}
+
+template <class K, class V>
+/**
+ * @brief Allocates the given number of empty buckets.
+ *
+ * @param cap a power of two
+ */
+void UnrolledBucketedHashMap<K,V>::allocate(size_t cap) {
+    this->capacity = cap;
+    this->buckets = new Bucket[cap];
+    for (size_t i = 0; i < cap; i++) {
+        this->buckets[i].count = 0;
+        this->buckets[i].overflow = nullptr;
+    }
+    this->size = 0;
+}
+
+template <class K, class V>
+/**
+ * @brief Destroys every stored entry and frees the overflow blocks and buckets.
+ *
+ */
+void UnrolledBucketedHashMap<K,V>::destroy() {
+    if (!this->buckets) {
+        return;
+    }
+    this->clear();
+    delete[] this->buckets;
+    this->buckets = nullptr;
+}
+
+template <class K, class V>
+/**
+ * @brief Moves every entry into a new table of the given number of buckets.
+ *
+ * @param cap a power of two
+ */
+void UnrolledBucketedHashMap<K,V>::resize(size_t cap) {
+    Bucket *old = this->buckets;
+    size_t oldCapacity = this->capacity;
+    size_t oldSize = this->size;
+    this->allocate(cap);
+    for (size_t i = 0; i < oldCapacity; i++) {
+        Bucket &b = old[i];
+        for (uint32_t j = 0; j < b.count; j++) {
+            Entry *e = b.entry(j);
+            this->link(hashOf(e->key), std::move(e->key), std::move(e->value));
+            e->~Entry();
+        }
+        Block *blk = b.overflow;
+        while (blk) {
+            for (uint32_t j = 0; j < blk->count; j++) {
+                Entry *e = blk->entry(j);
+                this->link(hashOf(e->key), std::move(e->key), std::move(e->value));
+                e->~Entry();
+            }
+            Block *next = blk->next;
+            delete blk;
+            blk = next;
+        }
+    }
+    this->size = oldSize;
+    delete[] old;
+}
+
+template <class K, class V>
+/**
+ * @brief Construct a new Unrolled Bucketed Hash Map< K, V>:: Unrolled Bucketed Hash Map object
+ *
+ */
+UnrolledBucketedHashMap<K,V>::UnrolledBucketedHashMap() : UnrolledBucketedHashMap(10, 1.0) {}
+
+template <class K, class V>
+/**
+ * @brief Construct a new Unrolled Bucketed Hash Map< K, V>:: Unrolled Bucketed Hash Map object
+ *
+ * @param cap
+ */
+UnrolledBucketedHashMap<K,V>::UnrolledBucketedHashMap(int cap) : UnrolledBucketedHashMap(cap, 1.0) {}
+
+template <class K, class V>
+/**
+ * @brief Construct a new Unrolled Bucketed Hash Map< K, V>:: Unrolled Bucketed Hash Map object
+ *
+ * @param cap
+ * @param lFT the average number of entries per bucket that triggers a resize
+ */
+UnrolledBucketedHashMap<K,V>::UnrolledBucketedHashMap(int cap, double lFT) {
+    if (lFT < 0.1 || lFT > (double)kInlineSlots) {
+        throw std::invalid_argument("Load factor cannot be greater than the inline slots of a bucket and cannot be less than 0.1!");
+    }
+    if (cap < 1) {
+        throw std::invalid_argument("Capacity must be larger than 0!");
+    }
+    this->loadFactorThreshold = lFT;
+    this->allocate(PowerOfTwoCapacity::roundCapacity(cap));
+}
+
+template <class K, class V>
+/**
+ * @brief Copy constructor for an UnrolledBucketedHashMap object.
+ *
+ * @param other
+ */
+UnrolledBucketedHashMap<K,V>::UnrolledBucketedHashMap(const UnrolledBucketedHashMap &other) {
+    this->loadFactorThreshold = other.loadFactorThreshold;
+    this->allocate(other.capacity);
+    for (size_t i = 0; i < other.capacity; i++) {
+        Bucket &b = other.buckets[i];
+        for (uint32_t j = 0; j < b.count; j++) {
+            this->insert(b.entry(j)->key, b.entry(j)->value);
+        }
+        for (Block *blk = b.overflow; blk; blk = blk->next) {
+            for (uint32_t j = 0; j < blk->count; j++) {
+                this->insert(blk->entry(j)->key, blk->entry(j)->value);
+            }
+        }
+    }
+}
+
+template <class K, class V>
+/**
+ * @brief Move constructor for an UnrolledBucketedHashMap object.
+ *
+ * @param other
+ */
+UnrolledBucketedHashMap<K,V>::UnrolledBucketedHashMap(UnrolledBucketedHashMap &&other) {
+    this->size = other.size;
+    this->capacity = other.capacity;
+    this->loadFactorThreshold = other.loadFactorThreshold;
+    this->buckets = other.buckets;
+    other.allocate(1);
+}
+
+template <class K, class V>
+/**
+ * @brief Destructor for an UnrolledBucketedHashMap object.
+ */
+UnrolledBucketedHashMap<K,V>::~UnrolledBucketedHashMap() {
+    this->destroy();
+}
+
+template <class K, class V>
+/**
+ * @brief Copies a map using an overloaded assignment operator.
+ *
+ * @param other
+ * @return UnrolledBucketedHashMap<K,V>&
+ */
+UnrolledBucketedHashMap<K,V>& UnrolledBucketedHashMap<K,V>::operator=(const UnrolledBucketedHashMap<K,V>& other) {
+    if (this != &other) {
+        UnrolledBucketedHashMap<K,V> tmp = other;
+        *this = std::move(tmp);
+    }
+    return *this;
+}
+
+template <class K, class V>
+/**
+ * @brief Moves a map using an overloaded assignment operator.
+ *
+ * @param other
+ * @return UnrolledBucketedHashMap<K,V>&
+ */
+UnrolledBucketedHashMap<K,V>& UnrolledBucketedHashMap<K,V>::operator=(UnrolledBucketedHashMap<K,V>&& other) {
+    if (this != &other) {
+        std::swap(this->size, other.size);
+        std::swap(this->capacity, other.capacity);
+        std::swap(this->loadFactorThreshold, other.loadFactorThreshold);
+        std::swap(this->buckets, other.buckets);
+    }
+    return *this;
+}
+
+template <class K, class V>
+/**
+ * @brief clears the map, keeping its buckets
+ *
+ */
+void UnrolledBucketedHashMap<K,V>::clear() {
+    for (size_t i = 0; i < this->capacity; i++) {
+        Bucket &b = this->buckets[i];
+        for (uint32_t j = 0; j < b.count; j++) {
+            b.entry(j)->~Entry();
+        }
+        b.count = 0;
+        Block *blk = b.overflow;
+        while (blk) {
+            for (uint32_t j = 0; j < blk->count; j++) {
+                blk->entry(j)->~Entry();
+            }
+            Block *next = blk->next;
+            delete blk;
+            blk = next;
+        }
+        b.overflow = nullptr;
+    }
+    this->size = 0;
+}
+
+template <class K, class V>
+/**
+ * @brief Returns whether or not the map contains the passed in key
+ *
+ * @param key
+ * @return true
+ * @return false
+ */
+bool UnrolledBucketedHashMap<K,V>::containsKey(const K &key) const {
+    return this->find(key, hashOf(key)) != nullptr;
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the reference to the value paired to the given key, valid
+ * until the next insert or remove
+ *
+ * @param key
+ * @return V&
+ * @throws std::invalid_argument if the key is not found.
+ */
+V& UnrolledBucketedHashMap<K,V>::get(const K &key) const {
+    Entry *e = this->find(key, hashOf(key));
+    if (!e) {
+        throw std::invalid_argument("Key not found");
+    }
+    return e->value;
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the reference to the value paired to the given key
+ *
+ * @param key
+ * @return V&
+ */
+V& UnrolledBucketedHashMap<K,V>::operator[](const K &key) const {
+    return this->get(key);
+}
+
+template <class K, class V>
+/**
+ * @brief Returns whether or not the map is empty.
+ *
+ * @return true
+ * @return false
+ */
+bool UnrolledBucketedHashMap<K,V>::isEmpty() const {
+    return this->size == 0;
+}
+
+template <class K, class V>
+/**
+ * @brief inserts a key-value pair into the map, overwriting the value of an
+ * existing key. The bucket count doubles once the average bucket would hold
+ * more than loadFactorThreshold entries.
+ *
+ * @param key
+ * @param value
+ */
+void UnrolledBucketedHashMap<K,V>::insert(const K key, const V value) {
+    size_t hash = hashOf(key);
+    Entry *e = this->find(key, hash);
+    if (e) {
+        e->value = value;
+        return;
+    }
+    if ((double)(this->size + 1) / (double)this->capacity > this->loadFactorThreshold) {
+        this->resize(this->capacity * 2);
+    }
+    this->link(hash, K(key), V(value));
+    this->size++;
+}
+
+template <class K, class V>
+/**
+ * @brief removes the given key and value from the map. The last entry of the
+ * bucket is moved into the freed slot, and an overflow block left empty is
+ * freed.
+ *
+ * @param key
+ * @return V
+ * @throws std::invalid_argument if the key is not found.
+ */
+V UnrolledBucketedHashMap<K,V>::remove(const K &key) {
+    size_t hash = hashOf(key);
+    Entry *e = this->find(key, hash);
+    if (!e) {
+        throw std::invalid_argument("No key found.");
+    }
+    Bucket &b = this->bucketOf(hash);
+    Entry *last;
+    uint32_t lastTag;
+    if (b.overflow) {
+        Block *blk = b.overflow;
+        last = blk->entry(blk->count - 1);
+        lastTag = blk->tags[blk->count - 1];
+    } else {
+        last = b.entry(b.count - 1);
+        lastTag = b.tags[b.count - 1];
+    }
+    V res = std::move(e->value);
+    if (e != last) {
+        e->key = std::move(last->key);
+        e->value = std::move(last->value);
+        uint32_t *tag = nullptr;
+        for (uint32_t i = 0; i < b.count && !tag; i++) {
+            if (b.entry(i) == e) {
+                tag = &b.tags[i];
+            }
+        }
+        for (Block *blk = b.overflow; blk && !tag; blk = blk->next) {
+            for (uint32_t i = 0; i < blk->count && !tag; i++) {
+                if (blk->entry(i) == e) {
+                    tag = &blk->tags[i];
+                }
+            }
+        }
+        *tag = lastTag;
+    }
+    last->~Entry();
+    if (b.overflow) {
+        Block *blk = b.overflow;
+        if (--blk->count == 0) {
+            b.overflow = blk->next;
+            delete blk;
+        }
+    } else {
+        b.count--;
+    }
+    this->size--;
+    return res;
+}
+
+template <class K, class V>
+/**
+ * @brief returns the size of the map
+ *
+ * @return int
+ */
+int UnrolledBucketedHashMap<K,V>::getSize() const {
+    return this->size;
+}
+
+template <class K, class V>
+/**
+ * @brief returns the number of buckets of the map
+ *
+ * @return int
+ */
+int UnrolledBucketedHashMap<K,V>::getCapacity() const {
+    return this->capacity;
+}
+
+template <class K, class V>
+/**
+ * @brief returns how many entries a bucket stores inline
+ *
+ * @return size_t
+ */
+size_t UnrolledBucketedHashMap<K,V>::getInlineSlots() {
+    return kInlineSlots;
+}
+
+template <class K, class V>
+/**
+ * @brief prints the map
+ *
+ */
+void UnrolledBucketedHashMap<K,V>::show() const {
+    std::cout << "Unrolled Bucketed Hash Map Entries: [ " << std::endl;
+    size_t printed = 0;
+    for (size_t i = 0; i < this->capacity; i++) {
+        Bucket &b = this->buckets[i];
+        for (uint32_t j = 0; j < b.count; j++) {
+            std::cout << "    " << "{K: " << b.entry(j)->key << ", V: " << b.entry(j)->value << "}" << (++printed < this->size ? "," : "") << std::endl;
+        }
+        for (Block *blk = b.overflow; blk; blk = blk->next) {
+            for (uint32_t j = 0; j < blk->count; j++) {
+                std::cout << "    " << "{K: " << blk->entry(j)->key << ", V: " << blk->entry(j)->value << "}" << (++printed < this->size ? "," : "") << std::endl;
+            }
+        }
+    }
+    std::cout << "]" << std::endl;
+}
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef VALUE_INDEX_HPP
+#define VALUE_INDEX_HPP
+
+#include <unordered_map>
+#include <vector>
+#include "BucketedHash.hpp"
+#include "MapNode.hpp"
+
+template <class K, class V>
+/**
+ * @brief A reverse index from each value of a BucketedHashMap to the nodes
+ * holding it, kept by the map when Traits::indexValues is on so that
+ * containsValue() and keysForValue() cost a hash lookup instead of a walk
+ * over every node. Nodes keep their address across a reHash, so only writes
+ * touch the index.
+ * Each distinct value costs a node of the std::unordered_map (the value, a
+ * std::vector, a cached hash and a next pointer) plus its bucket slot, i.e.
+ * about sizeof(V) + 64 bytes with allocator overhead, and each entry a
+ * pointer in that vector, 8 to 16 bytes with the vector's spare capacity,
+ * plus its slot, about 48 bytes in a second unordered_map.
+ * The slot records the value a node was indexed under and its position in
+ * that value's vector, so a removal swaps the node out in O(1), however many
+ * keys share its value, and never rereads the value of the node.
+ *
+ * @author Jonathan Ung
+ */
+class ValueIndex {
+    private:
+        typedef std::unordered_map<V, std::vector<const MapNode<K, V> *>, BucketedHash<V>> Holders;
+        /**
+         * @brief Where a node is indexed: the entry of its value, whose
+         * address survives rehashes of the unordered_map, and its position
+         * in that entry's vector.
+         */
+        struct Slot {
+            typename Holders::value_type *entry;
+            size_t index;
+        };
+        Holders nodes;
+        std::unordered_map<const MapNode<K, V> *, Slot> slots;
+
+    public:
+        void add(const MapNode<K, V> *);
+        void remove(const MapNode<K, V> *);
+        void clear();
+        bool contains(const V &) const;
+        std::vector<K> keysFor(const V &) const;
+        size_t getValueCount() const;
+};
+
+template <class K, class V>
+/**
+ * @brief Indexes a node under its current value.
+ *
+ * @param node
+ */
+void ValueIndex<K,V>::add(const MapNode<K, V> *node) {
+    typename Holders::value_type &entry = *this->nodes.try_emplace(node->value).first;
+    this->slots[node] = Slot{&entry, entry.second.size()};
+    entry.second.push_back(node);
+}
+
+template <class K, class V>
+/**
+ * @brief Drops a node from the index, moving the last node holding the
+ * same value into its slot. The node is found under the value it was added
+ * with, so this is safe even if its value has changed since; the node must
+ * not have been destroyed yet.
+ *
+ * @param node
+ */
+void ValueIndex<K,V>::remove(const MapNode<K, V> *node) {
+    typename std::unordered_map<const MapNode<K, V> *, Slot>::iterator slot = this->slots.find(node);
+    if (slot == this->slots.end()) {
+        return;
+    }
+    typename Holders::value_type *entry = slot->second.entry;
+    std::vector<const MapNode<K, V> *> &holders = entry->second;
+    size_t i = slot->second.index;
+    this->slots.erase(slot);
+    const MapNode<K, V> *last = holders.back();
+    holders[i] = last;
+    holders.pop_back();
+    if (last != node) {
+        this->slots[last].index = i;
+    }
+    if (holders.empty()) {
+        this->nodes.erase(this->nodes.find(entry->first));
+    }
+}
+
+template <class K, class V>
+/**
+ * @brief Empties the index.
+ */
+void ValueIndex<K,V>::clear() {
+    this->nodes.clear();
+    this->slots.clear();
+}
+
+template <class K, class V>
+/**
+ * @brief Checks if any node holds a value.
+ *
+ * @param value
+ * @return true
+ * @return false
+ */
+bool ValueIndex<K,V>::contains(const V &value) const {
+    return this->nodes.find(value) != this->nodes.end();
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the keys of every node holding a value, in no particular order.
+ *
+ * @param value
+ * @return std::vector<K>
+ */
+std::vector<K> ValueIndex<K,V>::keysFor(const V &value) const {
+    std::vector<K> res = std::vector<K>();
+    typename Holders::const_iterator it = this->nodes.find(value);
+    if (it != this->nodes.end()) {
+        for (size_t i = 0; i < it->second.size(); i++) {
+            res.push_back(it->second[i]->key);
+        }
+    }
+    return res;
+}
+
+template <class K, class V>
+/**
+ * @brief Returns the number of distinct values indexed.
+ *
+ * @return size_t
+ */
+size_t ValueIndex<K,V>::getValueCount() const {
+    return this->nodes.size();
+}
+
+/**
+ * @brief Stand-in for ValueIndex when Traits::indexValues is off: every
+ * update is a no-op the compiler drops.
+ *
+ * @author Jonathan Ung
+ */
+struct NoValueIndex {
+    template <class N>
+    void add(const N *) {}
+    template <class N>
+    void remove(const N *) {}
+    void clear() {}
+};
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef ZIPF_DISTRIBUTION_HPP
+#define ZIPF_DISTRIBUTION_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <random>
+
+/**
+ * @brief Zipf distributed ranks in [1, n] drawn by rejection-inversion
+ * (Hörmann and Derflinger), which needs O(1) memory whatever n is, unlike a
+ * table of the cumulative distribution.
+ *
+ * @author Jonathan Ung
+ */
+class ZipfDistribution {
+    private:
+        double n;
+        double s;
+        double hIntegralX1;
+        double hIntegralN;
+        double threshold;
+        static double helper1(double);
+        static double helper2(double);
+        double h(double) const;
+        double hIntegral(double) const;
+        double hIntegralInverse(double) const;
+
+    public:
+        ZipfDistribution(size_t, double);
+        template <class G>
+        size_t operator()(G &);
+};
+
+/**
+ * @brief Returns log1p(x) / x, accurate near 0.
+ *
+ * @param x
+ * @return double
+ */
+inline double ZipfDistribution::helper1(double x) {
+    return std::fabs(x) > 1e-8 ? std::log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+}
+
+/**
+ * @brief Returns expm1(x) / x, accurate near 0.
+ *
+ * @param x
+ * @return double
+ */
+inline double ZipfDistribution::helper2(double x) {
+    return std::fabs(x) > 1e-8 ? std::expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+}
+
+/**
+ * @brief Returns the unnormalized density x^-s.
+ *
+ * @param x
+ * @return double
+ */
+inline double ZipfDistribution::h(double x) const {
+    return std::exp(-this->s * std::log(x));
+}
+
+/**
+ * @brief Returns the integral of h from 1 to x.
+ *
+ * @param x
+ * @return double
+ */
+inline double ZipfDistribution::hIntegral(double x) const {
+    double logX = std::log(x);
+    return helper2((1.0 - this->s) * logX) * logX;
+}
+
+/**
+ * @brief Returns the inverse of hIntegral.
+ *
+ * @param x
+ * @return double
+ */
+inline double ZipfDistribution::hIntegralInverse(double x) const {
+    double t = x * (1.0 - this->s);
+    if (t < -1.0) {
+        t = -1.0;
+    }
+    return std::exp(helper1(t) * x);
+}
+
+/**
+ * @brief Construct a new Zipf Distribution object
+ *
+ * @param n the number of ranks
+ * @param s the skew, 0 being uniform
+ */
+inline ZipfDistribution::ZipfDistribution(size_t n, double s) {
+    this->n = (double)n;
+    this->s = s;
+    this->hIntegralX1 = this->hIntegral(1.5) - 1.0;
+    this->hIntegralN = this->hIntegral(this->n + 0.5);
+    this->threshold = 2.0 - this->hIntegralInverse(this->hIntegral(2.5) - this->h(2.0));
+}
+
+template <class G>
+/**
+ * @brief Draws a rank, 1 being the most frequent.
+ *
+ * @param rng
+ * @return size_t
+ */
+size_t ZipfDistribution::operator()(G &rng) {
+    std::uniform_real_distribution<double> uniform = std::uniform_real_distribution<double>(0.0, 1.0);
+    while (true) {
+        double u = this->hIntegralN + uniform(rng) * (this->hIntegralX1 - this->hIntegralN);
+        double x = this->hIntegralInverse(u);
+        double k = std::floor(x + 0.5);
+        if (k < 1.0) {
+            k = 1.0;
+        } else if (k > this->n) {
+            k = this->n;
+        }
+        if (k - x <= this->threshold || u >= this->hIntegral(k + 0.5) - this->h(k)) {
+            return (size_t)k;
+        }
+    }
+}
+
+#endif